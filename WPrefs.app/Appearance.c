@@ -202,6 +202,9 @@ typedef struct _Panel {
 	Pixmap previewBack;
 
 	char *fprefix;
+
+	WMArray *previewQueue;	/* texture list items waiting for a preview */
+	WMHandlerID previewIdle;
 } _Panel;
 
 typedef struct {
@@ -215,6 +218,8 @@ typedef struct {
 	char selectedFor;
 	unsigned current:1;
 	unsigned ispixmap:1;
+	unsigned queued:1;		/* waiting in the preview queue */
+	unsigned tried:1;		/* preview already loaded or rendered once */
 } TextureListItem;
 
 enum {
@@ -233,6 +238,8 @@ static void changeColorPage(WMWidget * w, void *data);
 
 static void OpenExtractPanelFor(_Panel *panel);
 
+static Pixmap loadRImage(WMScreen *scr, const char *path);
+
 static void changedTabItem(struct WMTabViewDelegate *self, WMTabView * tabView, WMTabViewItem * item);
 
 static WMTabViewDelegate tabviewDelegate = {
@@ -997,7 +1004,8 @@ static void okEditTexture(void *data)
 	wfree(titem->texture);
 	titem->texture = str;
 
-	XFreePixmap(WMScreenDisplay(WMWidgetScreen(panel->texLs)), titem->preview);
+	if (titem->preview)
+		XFreePixmap(WMScreenDisplay(WMWidgetScreen(panel->texLs)), titem->preview);
 	titem->preview = renderTexture(WMWidgetScreen(panel->texLs), titem->prop,
 				       TEXPREV_WIDTH, TEXPREV_HEIGHT, titem->path, 0);
 
@@ -1078,6 +1086,11 @@ static void deleteTexture(WMWidget * w, void *data)
 		titem2->selectedFor |= 1 << section;
 	}
 
+	if (titem->queued)
+		WMRemoveFromArray(panel->previewQueue, titem);
+	if (titem->preview)
+		XFreePixmap(WMScreenDisplay(WMWidgetScreen(panel->texLs)), titem->preview);
+
 	wfree(titem->title);
 	wfree(titem->texture);
 	WMReleasePropList(titem->prop);
@@ -1246,6 +1259,97 @@ static void textureDoubleClick(WMWidget * w, void *data)
 		updatePreviewBox(panel, 1 << section);
 }
 
+/*
+ * The previews of the texture list are only made once their row gets
+ * painted, one at a time from an idle handler so that the panel shows up
+ * and stays responsive meanwhile. The previews of textures that do not use
+ * an image file are kept on disk, named after their description, and are
+ * loaded from there the next time.
+ */
+static char *previewCachePath(_Panel *panel, TextureListItem *titem)
+{
+	char *type, buf[32];
+	unsigned long long hash = 14695981039346656037ULL;
+	const char *p;
+
+	if (!panel->fprefix)
+		return NULL;
+
+	type = WMGetFromPLString(WMGetFromPLArray(titem->prop, 0));
+	if (!type || strcasecmp(&type[1], "pixmap") == 0 ||
+	    (strlen(type) > 2 && strcasecmp(&type[2], "gradient") == 0 && toupper(type[0]) == 'T'))
+		return NULL;
+
+	/* FNV-1a */
+	for (p = titem->texture; *p; p++)
+		hash = (hash ^ (unsigned char) *p) * 1099511628211ULL;
+
+	snprintf(buf, sizeof(buf), "preview-%016llx.cache", hash);
+
+	return wstrconcat(panel->fprefix, buf);
+}
+
+static Pixmap makeTexturePreview(_Panel *panel, TextureListItem *titem)
+{
+	WMScreen *scr = WMWidgetScreen(panel->texLs);
+	Pixmap pixmap = None;
+	char *cache;
+
+	if (titem->path)
+		pixmap = loadRImage(scr, titem->path);
+
+	if (pixmap)
+		return pixmap;
+
+	cache = previewCachePath(panel, titem);
+	if (cache) {
+		if (access(cache, R_OK) == 0)
+			pixmap = loadRImage(scr, cache);
+		if (!pixmap)
+			pixmap = renderTexture(scr, titem->prop, TEXPREV_WIDTH, TEXPREV_HEIGHT, cache, 0);
+		wfree(cache);
+	} else {
+		pixmap = renderTexture(scr, titem->prop, TEXPREV_WIDTH, TEXPREV_HEIGHT, NULL, 0);
+	}
+
+	return pixmap;
+}
+
+static void renderQueuedPreview(void *data)
+{
+	_Panel *panel = (_Panel *) data;
+	TextureListItem *titem;
+
+	panel->previewIdle = NULL;
+	if (WMGetArrayItemCount(panel->previewQueue) == 0)
+		return;
+
+	titem = WMGetFromArray(panel->previewQueue, 0);
+	WMDeleteFromArray(panel->previewQueue, 0);
+	titem->queued = 0;
+	titem->tried = 1;
+
+	if (!titem->preview)
+		titem->preview = makeTexturePreview(panel, titem);
+
+	if (WMGetArrayItemCount(panel->previewQueue) > 0)
+		panel->previewIdle = WMAddIdleHandler(renderQueuedPreview, panel);
+
+	WMRedisplayWidget(panel->texLs);
+}
+
+static void queueTexturePreview(_Panel *panel, TextureListItem *titem)
+{
+	if (titem->queued)
+		return;
+
+	titem->queued = 1;
+	WMAddToArray(panel->previewQueue, titem);
+
+	if (!panel->previewIdle)
+		panel->previewIdle = WMAddIdleHandler(renderQueuedPreview, panel);
+}
+
 static void paintListItem(WMList * lPtr, int index, Drawable d, char *text, int state, WMRect * rect)
 {
 	_Panel *panel = (_Panel *) WMGetHangedData(lPtr);
@@ -1278,6 +1382,8 @@ static void paintListItem(WMList * lPtr, int index, Drawable d, char *text, int
 	if (titem->preview)
 		XCopyArea(dpy, titem->preview, d, WMColorGC(black), 0, 0,
 			  TEXPREV_WIDTH, TEXPREV_HEIGHT, x + 5, y + 5);
+	else if (!titem->tried)
+		queueTexturePreview(panel, titem);
 
 	if ((1 << WMGetPopUpButtonSelectedItem(panel->secP)) & titem->selectedFor)
 		WMDrawPixmap(panel->onLed, d, x + TEXPREV_WIDTH + 10, y + 6);
@@ -1343,7 +1449,6 @@ static void fillTextureList(WMList * lPtr)
 	WMPropList *texture;
 	WMUserDefaults *udb = WMGetStandardUserDefaults();
 	TextureListItem *titem;
-	WMScreen *scr = WMWidgetScreen(lPtr);
 	int i;
 
 	textureList = WMGetUDObjectForKey(udb, "TextureList");
@@ -1363,10 +1468,7 @@ static void fillTextureList(WMList * lPtr)
 		titem->selectedFor = 0;
 		titem->path = wstrdup(WMGetFromPLString(WMGetFromPLArray(texture, 2)));
 
-		titem->preview = loadRImage(scr, titem->path);
-		if (!titem->preview) {
-			titem->preview = renderTexture(scr, titem->prop, TEXPREV_WIDTH, TEXPREV_HEIGHT, NULL, 0);
-		}
+		/* the preview is loaded when the row is first painted */
 		item = WMAddListItem(lPtr, "");
 		item->clientData = titem;
 	}
@@ -1836,6 +1938,8 @@ static void createPanel(Panel * p)
 		}
 	}
 
+	panel->previewQueue = WMCreateArray(8);
+
 	panel->smallFont = WMSystemFontOfSize(scr, 10);
 	panel->normalFont = WMSystemFontOfSize(scr, 12);
 	panel->boldFont = WMBoldSystemFontOfSize(scr, 12);
@@ -2104,8 +2208,7 @@ static void setupTextureFor(WMList *list, const char *key, const char *defValue,
 
 	titem->ispixmap = isPixmap(titem->prop);
 
-	titem->preview = renderTexture(WMWidgetScreen(list), titem->prop, TEXPREV_WIDTH, TEXPREV_HEIGHT, NULL, 0);
-
+	/* the preview is rendered when the row is first painted */
 	item = WMAddListItem(list, "");
 	item->clientData = titem;
 }
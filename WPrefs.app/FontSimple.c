@@ -10,6 +10,11 @@
 
 #include "WPrefs.h"
 #include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD
+#include <fcntl.h>
+#include <pthread.h>
+#endif
 #include <fontconfig/fontconfig.h>
 #include <math.h>
 
@@ -40,6 +45,9 @@
 
 #define SAMPLE_TEXT "The Lazy Fox Jumped Ipsum Foobar 1234 - 56789"
 
+/* families added to the list at a time while it gets filled */
+#define FAMILY_BATCH	256
+
 typedef struct {
 	int weight;
 	int width;
@@ -48,7 +56,7 @@ typedef struct {
 
 typedef struct {
 	char *name;
-	int stylen;
+	int stylen;			/* -1 until the styles are looked up */
 	FontStyle *styles;
 } FontFamily;
 
@@ -77,6 +85,18 @@ typedef struct _Panel {
 	WMTextField *sampleT;
 
 	FontList *fonts;
+
+	/* font families enumeration, see lookup_available_fonts() */
+#ifdef HAVE_PTHREAD
+	pthread_t lookupThread;
+	int lookupPipe[2];
+	WMHandlerID lookupHandler;
+#endif
+	char *lookupCache;
+	WMHandlerID populateIdle;
+	int populated;			/* families added to familyL so far */
+
+	WMHandlerID sampleIdle;
 } _Panel;
 
 #define ICON_FILE	"fonts"
@@ -162,7 +182,7 @@ static int compare_family(const void *a, const void *b)
 {
 	FontFamily *fa = (FontFamily *) a;
 	FontFamily *fb = (FontFamily *) b;
-	return strcmp(fa->name, fb->name);
+	return strcasecmp(fa->name, fb->name);
 }
 
 static int compare_styles(const void *a, const void *b)
@@ -180,96 +200,378 @@ static int compare_styles(const void *a, const void *b)
 	return (sa->width - sb->width);
 }
 
-static void lookup_available_fonts(_Panel * panel)
+/*
+ * Listing every font with its style freezes the panel on systems with
+ * thousands of fonts, so only the family names are listed, by a thread,
+ * and the styles of a family are looked up when it gets selected. The
+ * names are also kept in a cache file along with the modification time
+ * of the fontconfig cache and font directories, and are read from there
+ * as long as those do not change. The list is then filled a batch at a
+ * time from an idle handler.
+ */
+static char *font_cache_key(void)
 {
-	FcPattern *pat = FcPatternCreate();
-	FcObjectSet *os;
-	FcFontSet *fonts;
-	FontFamily *family;
+	const char *dirs[2] = { "cache", "font" };
+	FcStrList *list;
+	FcChar8 *dir;
+	struct stat st;
+	long long newest = 0;
+	int i, count = 0;
+	char buf[64];
+
+	for (i = 0; i < wlengthof(dirs); i++) {
+		if (i == 0)
+			list = FcConfigGetCacheDirs(NULL);
+		else
+			list = FcConfigGetFontDirs(NULL);
+		if (!list)
+			continue;
 
-	os = FcObjectSetBuild(FC_FAMILY, FC_WEIGHT, FC_WIDTH, FC_SLANT, NULL);
+		while ((dir = FcStrListNext(list)) != NULL) {
+			char *path = wexpandpath((char *) dir);
 
-	fonts = FcFontList(0, pat, os);
+			if (stat(path, &st) == 0) {
+				if (st.st_mtime > newest)
+					newest = st.st_mtime;
+				count++;
+			}
+			wfree(path);
+		}
+		FcStrListDone(list);
+	}
 
-	if (fonts) {
-		int i;
+	snprintf(buf, sizeof(buf), "%d %lld", count, newest);
 
-		panel->fonts = wmalloc(sizeof(FontList));
-		panel->fonts->familyn = 0;
-		panel->fonts->families = wmalloc(sizeof(FontFamily) * fonts->nfont);
+	return wstrdup(buf);
+}
 
-		for (i = 0; i < fonts->nfont; i++) {
-			char *name;
-			int weight, slant, width;
-			int j, found;
+static FontList *read_font_cache(const char *path, const char *key)
+{
+	FontList *fonts = NULL;
+	char line[1024], *ptr;
+	FILE *file;
+	int size = 0;
+
+	file = fopen(path, "r");
+	if (!file)
+		return NULL;
+
+	if (!fgets(line, sizeof(line), file))
+		goto out;
+
+	ptr = strchr(line, '\n');
+	if (ptr)
+		*ptr = 0;
+	if (strcmp(line, key) != 0)
+		goto out;
+
+	fonts = wmalloc(sizeof(FontList));
+	while (fgets(line, sizeof(line), file)) {
+		ptr = strchr(line, '\n');
+		if (ptr)
+			*ptr = 0;
+		if (!line[0])
+			continue;
+
+		if (fonts->familyn == size) {
+			size = size ? size * 2 : 256;
+			fonts->families = wrealloc(fonts->families, sizeof(FontFamily) * size);
+		}
+		fonts->families[fonts->familyn].name = wstrdup(line);
+		fonts->families[fonts->familyn].stylen = -1;
+		fonts->families[fonts->familyn].styles = NULL;
+		fonts->familyn++;
+	}
 
-			if (FcPatternGetString(fonts->fonts[i], FC_FAMILY, 0, (FcChar8 **) & name) !=
-			    FcResultMatch)
-				continue;
+ out:
+	fclose(file);
 
-			if (FcPatternGetInteger(fonts->fonts[i], FC_WEIGHT, 0, &weight) != FcResultMatch)
-				weight = FC_WEIGHT_MEDIUM;
+	return fonts;
+}
 
-			if (FcPatternGetInteger(fonts->fonts[i], FC_WIDTH, 0, &width) != FcResultMatch)
-				width = FC_WIDTH_NORMAL;
+static void write_font_cache(const char *path, const char *key, FontList *fonts)
+{
+	FILE *file;
+	int i;
 
-			if (FcPatternGetInteger(fonts->fonts[i], FC_SLANT, 0, &slant) != FcResultMatch)
-				slant = FC_SLANT_ROMAN;
+	file = fopen(path, "w");
+	if (!file) {
+		werror("%s", path);
+		return;
+	}
 
-			found = -1;
-			for (j = 0; j < panel->fonts->familyn && found < 0; j++)
-				if (strcasecmp(panel->fonts->families[j].name, name) == 0)
-					found = j;
+	fprintf(file, "%s\n", key);
+	for (i = 0; i < fonts->familyn; i++)
+		fprintf(file, "%s\n", fonts->families[i].name);
 
-			if (found < 0) {
-				panel->fonts->families[panel->fonts->familyn++].name = wstrdup(name);
-				family = panel->fonts->families + panel->fonts->familyn - 1;
-				family->stylen = 0;
-				family->styles = NULL;
-			} else
-				family = panel->fonts->families + found;
+	if (fclose(file) < 0)
+		werror("%s", path);
+}
 
-			family->stylen++;
-			family->styles = wrealloc(family->styles, sizeof(FontStyle) * family->stylen);
-			family->styles[family->stylen - 1].weight = weight;
-			family->styles[family->stylen - 1].slant = slant;
-			family->styles[family->stylen - 1].width = width;
-		}
-		qsort(panel->fonts->families, panel->fonts->familyn, sizeof(FontFamily), compare_family);
+static FontList *list_font_families(void)
+{
+	FcPattern *pat = FcPatternCreate();
+	FcObjectSet *os;
+	FcFontSet *set;
+	FontList *fonts;
+	int i;
+
+	fonts = wmalloc(sizeof(FontList));
+
+	os = FcObjectSetBuild(FC_FAMILY, NULL);
+	set = FcFontList(0, pat, os);
+	if (set) {
+		fonts->families = wmalloc(sizeof(FontFamily) * (set->nfont + 1));
 
-		for (i = 0; i < panel->fonts->familyn; i++) {
-			qsort(panel->fonts->families[i].styles, panel->fonts->families[i].stylen,
-			      sizeof(FontStyle), compare_styles);
+		for (i = 0; i < set->nfont; i++) {
+			char *name;
+
+			if (FcPatternGetString(set->fonts[i], FC_FAMILY, 0, (FcChar8 **) & name) !=
+			    FcResultMatch)
+				continue;
+
+			fonts->families[fonts->familyn].name = wstrdup(name);
+			fonts->families[fonts->familyn].stylen = -1;
+			fonts->families[fonts->familyn].styles = NULL;
+			fonts->familyn++;
 		}
+		FcFontSetDestroy(set);
 
-		FcFontSetDestroy(fonts);
+		qsort(fonts->families, fonts->familyn, sizeof(FontFamily), compare_family);
+
+		/* the same family can be listed under other secondary names */
+		if (fonts->familyn > 0) {
+			int j = 0;
+
+			for (i = 1; i < fonts->familyn; i++) {
+				if (strcasecmp(fonts->families[j].name, fonts->families[i].name) == 0)
+					wfree(fonts->families[i].name);
+				else
+					fonts->families[++j] = fonts->families[i];
+			}
+			fonts->familyn = j + 1;
+		}
 	}
 	if (os)
 		FcObjectSetDestroy(os);
 	if (pat)
 		FcPatternDestroy(pat);
 
-	panel->fonts->families[panel->fonts->familyn++].name = wstrdup("sans serif");
-	family = panel->fonts->families + panel->fonts->familyn - 1;
-	family->styles = wmalloc(sizeof(FontStyle) * 2);
-	family->stylen = 2;
-	family->styles[0].weight = FC_WEIGHT_MEDIUM;
-	family->styles[0].slant = FC_SLANT_ROMAN;
-	family->styles[0].width = FC_WIDTH_NORMAL;
-	family->styles[1].weight = FC_WEIGHT_BOLD;
-	family->styles[1].slant = FC_SLANT_ROMAN;
-	family->styles[1].width = FC_WIDTH_NORMAL;
-
-	panel->fonts->families[panel->fonts->familyn++].name = wstrdup("serif");
-	family = panel->fonts->families + panel->fonts->familyn - 1;
-	family->styles = wmalloc(sizeof(FontStyle) * 2);
-	family->stylen = 2;
-	family->styles[0].weight = FC_WEIGHT_MEDIUM;
-	family->styles[0].slant = FC_SLANT_ROMAN;
-	family->styles[0].width = FC_WIDTH_NORMAL;
-	family->styles[1].weight = FC_WEIGHT_BOLD;
-	family->styles[1].slant = FC_SLANT_ROMAN;
-	family->styles[1].width = FC_WIDTH_NORMAL;
+	return fonts;
+}
+
+static void lookup_fonts(_Panel *panel)
+{
+	FontList *fonts = NULL;
+	char *key;
+
+	key = font_cache_key();
+	if (panel->lookupCache)
+		fonts = read_font_cache(panel->lookupCache, key);
+
+	if (!fonts) {
+		fonts = list_font_families();
+		if (panel->lookupCache)
+			write_font_cache(panel->lookupCache, key, fonts);
+	}
+	wfree(key);
+
+	panel->fonts = fonts;
+}
+
+#ifdef HAVE_PTHREAD
+static void *lookup_fonts_thread(void *data)
+{
+	_Panel *panel = (_Panel *) data;
+
+	lookup_fonts(panel);
+
+	/* wake up the main loop */
+	if (write(panel->lookupPipe[1], "", 1) < 0)
+		werror(_("could not notify the end of the font lookup"));
+
+	return NULL;
+}
+#endif
+
+static void add_generic_family(FontList *fonts, const char *name)
+{
+	fonts->families = wrealloc(fonts->families, sizeof(FontFamily) * (fonts->familyn + 1));
+	fonts->families[fonts->familyn].name = wstrdup(name);
+	fonts->families[fonts->familyn].stylen = -1;
+	fonts->families[fonts->familyn].styles = NULL;
+	fonts->familyn++;
+}
+
+static void selectedOption(WMWidget * w, void *data);
+
+static void populate_families(void *data)
+{
+	_Panel *panel = (_Panel *) data;
+	WMListItem *item;
+	int end;
+
+	panel->populateIdle = NULL;
+
+	end = panel->populated + FAMILY_BATCH;
+	if (end > panel->fonts->familyn)
+		end = panel->fonts->familyn;
+
+	for (; panel->populated < end; panel->populated++) {
+		item = WMAddListItem(panel->familyL, panel->fonts->families[panel->populated].name);
+		item->clientData = panel->fonts->families + panel->populated;
+	}
+
+	if (panel->populated < panel->fonts->familyn) {
+		panel->populateIdle = WMAddIdleHandler(populate_families, panel);
+		return;
+	}
+
+	/* the family of the font being edited can be selected now */
+	selectedOption(panel->optionP, panel);
+}
+
+static void lookup_done(_Panel *panel)
+{
+	add_generic_family(panel->fonts, "sans serif");
+	add_generic_family(panel->fonts, "serif");
+
+	panel->populated = 0;
+	populate_families(panel);
+}
+
+#ifdef HAVE_PTHREAD
+static void lookup_finished(int fd, int mask, void *data)
+{
+	_Panel *panel = (_Panel *) data;
+	char c;
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) mask;
+
+	if (read(fd, &c, 1) < 0)
+		return;
+
+	WMDeleteInputHandler(panel->lookupHandler);
+	panel->lookupHandler = NULL;
+
+	pthread_join(panel->lookupThread, NULL);
+	close(panel->lookupPipe[0]);
+	close(panel->lookupPipe[1]);
+	panel->lookupPipe[0] = panel->lookupPipe[1] = -1;
+
+	lookup_done(panel);
+}
+#endif
+
+static char *font_cache_path(void)
+{
+	char *path;
+
+	path = wstrconcat(wuserdatapath(), "/" PACKAGE_TARNAME);
+	if (access(path, F_OK) != 0 && mkdir(path, 0755) < 0) {
+		wfree(path);
+		return NULL;
+	}
+
+	path = wstrappend(path, "/WPrefs");
+	if (access(path, F_OK) != 0 && mkdir(path, 0755) < 0) {
+		wfree(path);
+		return NULL;
+	}
+
+	return wstrappend(path, "/font-families.cache");
+}
+
+static void lookup_available_fonts(_Panel * panel)
+{
+	panel->lookupCache = font_cache_path();
+
+#ifdef HAVE_PTHREAD
+	panel->lookupPipe[0] = panel->lookupPipe[1] = -1;
+
+	if (pipe(panel->lookupPipe) == 0) {
+		fcntl(panel->lookupPipe[0], F_SETFD, FD_CLOEXEC);
+		fcntl(panel->lookupPipe[1], F_SETFD, FD_CLOEXEC);
+
+		panel->lookupHandler = WMAddInputHandler(panel->lookupPipe[0], WIReadMask,
+							 lookup_finished, panel);
+
+		if (pthread_create(&panel->lookupThread, NULL, lookup_fonts_thread, panel) == 0)
+			return;
+
+		WMDeleteInputHandler(panel->lookupHandler);
+		panel->lookupHandler = NULL;
+		close(panel->lookupPipe[0]);
+		close(panel->lookupPipe[1]);
+		panel->lookupPipe[0] = panel->lookupPipe[1] = -1;
+	}
+#endif
+
+	/* no thread, do it here */
+	lookup_fonts(panel);
+	lookup_done(panel);
+}
+
+static void lookup_family_styles(FontFamily *family)
+{
+	FcPattern *pat;
+	FcObjectSet *os;
+	FcFontSet *set;
+	int i;
+
+	family->stylen = 0;
+
+	pat = FcPatternCreate();
+	FcPatternAddString(pat, FC_FAMILY, (FcChar8 *) family->name);
+	os = FcObjectSetBuild(FC_FAMILY, FC_WEIGHT, FC_WIDTH, FC_SLANT, NULL);
+
+	set = FcFontList(0, pat, os);
+	if (set) {
+		family->styles = wmalloc(sizeof(FontStyle) * (set->nfont + 1));
+
+		for (i = 0; i < set->nfont; i++) {
+			FontStyle *style = family->styles + family->stylen;
+
+			if (FcPatternGetInteger(set->fonts[i], FC_WEIGHT, 0, &style->weight) != FcResultMatch)
+				style->weight = FC_WEIGHT_MEDIUM;
+
+			if (FcPatternGetInteger(set->fonts[i], FC_WIDTH, 0, &style->width) != FcResultMatch)
+				style->width = FC_WIDTH_NORMAL;
+
+			if (FcPatternGetInteger(set->fonts[i], FC_SLANT, 0, &style->slant) != FcResultMatch)
+				style->slant = FC_SLANT_ROMAN;
+
+			family->stylen++;
+		}
+		FcFontSetDestroy(set);
+
+		qsort(family->styles, family->stylen, sizeof(FontStyle), compare_styles);
+
+		/* fonts of the family that only differ by other properties */
+		if (family->stylen > 0) {
+			int j = 0;
+
+			for (i = 1; i < family->stylen; i++)
+				if (compare_styles(family->styles + j, family->styles + i) != 0)
+					family->styles[++j] = family->styles[i];
+			family->stylen = j + 1;
+		}
+	}
+	FcObjectSetDestroy(os);
+	FcPatternDestroy(pat);
+
+	/* generic families like "sans serif" are not listed */
+	if (family->stylen == 0) {
+		family->styles = wrealloc(family->styles, sizeof(FontStyle) * 2);
+		family->stylen = 2;
+		family->styles[0].weight = FC_WEIGHT_MEDIUM;
+		family->styles[0].slant = FC_SLANT_ROMAN;
+		family->styles[0].width = FC_WIDTH_NORMAL;
+		family->styles[1].weight = FC_WEIGHT_BOLD;
+		family->styles[1].slant = FC_SLANT_ROMAN;
+		family->styles[1].width = FC_WIDTH_NORMAL;
+	}
 }
 
 static char *getSelectedFont(_Panel * panel, FcChar8 * curfont)
@@ -315,12 +617,15 @@ static char *getSelectedFont(_Panel * panel, FcChar8 * curfont)
 	return name;
 }
 
-static void updateSampleFont(_Panel * panel)
+static void renderSampleFont(void *data)
 {
+	_Panel *panel = (_Panel *) data;
 	WMMenuItem *item = WMGetPopUpButtonMenuItem(panel->optionP,
 						    WMGetPopUpButtonSelectedItem(panel->optionP));
 	char *fn = WMGetMenuItemRepresentedObject(item);
 
+	panel->sampleIdle = NULL;
+
 	if (fn) {
 		WMFont *font = WMCreateFont(WMWidgetScreen(panel->box), fn);
 		if (font) {
@@ -330,6 +635,13 @@ static void updateSampleFont(_Panel * panel)
 	}
 }
 
+/* Only the last font selected when going through the lists is loaded */
+static void updateSampleFont(_Panel * panel)
+{
+	if (!panel->sampleIdle)
+		panel->sampleIdle = WMAddIdleHandler(renderSampleFont, panel);
+}
+
 static void selectedFamily(WMWidget * w, void *data)
 {
 	_Panel *panel = (_Panel *) data;
@@ -350,6 +662,9 @@ static void selectedFamily(WMWidget * w, void *data)
 		FontFamily *family = (FontFamily *) item->clientData;
 		int i, oldi = 0, oldscore = 0;
 
+		if (family->stylen < 0)
+			lookup_family_styles(family);
+
 		WMClearList(panel->styleL);
 		for (i = 0; i < family->stylen; i++) {
 			int j;
@@ -462,7 +777,7 @@ static void selectedOption(WMWidget * w, void *data)
 				name = "sans serif";
 
 			found = 0;
-			/* select family */
+			/* select family, once the list is filled */
 			for (i = 0; i < WMGetListNumberOfRows(panel->familyL); i++) {
 				WMListItem *item = WMGetListItem(panel->familyL, i);
 				FontFamily *family = (FontFamily *) item->clientData;
@@ -625,8 +940,6 @@ static void createPanel(Panel * p)
 	WMBox *hbox, *vbox;
 	int i;
 
-	lookup_available_fonts(panel);
-
 	panel->box = WMCreateBox(panel->parent);
 	WMSetViewExpandsToParent(WMWidgetView(panel->box), 5, 2, 5, 5);
 	WMSetBoxHorizontal(panel->box, False);
@@ -670,15 +983,6 @@ static void createPanel(Panel * p)
 	/* family */
 	panel->familyL = WMCreateList(vbox);
 	WMAddBoxSubview(vbox, WMWidgetView(panel->familyL), True, True, 0, 0, 0);
-	if (panel->fonts) {
-		WMListItem *item;
-		for (i = 0; i < panel->fonts->familyn; i++) {
-			item = WMAddListItem(panel->familyL, panel->fonts->families[i].name);
-			item->clientData = panel->fonts->families + i;
-		}
-	} else
-		WMAddListItem(panel->familyL, "sans serif");
-
 	WMSetListAction(panel->familyL, selectedFamily, panel);
 
 	vbox = WMCreateBox(hbox);
@@ -717,6 +1021,9 @@ static void createPanel(Panel * p)
 	WMRealizeWidget(panel->box);
 
 	showData(panel);
+
+	/* fills the family list, and selects the family of the font afterwards */
+	lookup_available_fonts(panel);
 }
 
 Panel *InitFontSimple(WMWidget *parent)
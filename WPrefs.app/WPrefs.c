@@ -12,6 +12,8 @@
 
 #include "WPrefs.h"
 #include <assert.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #ifdef HAVE_STDNORETURN
 #include <stdnoreturn.h>
@@ -586,13 +588,108 @@ WMWindow *GetWindow(void)
 	return WPrefs.win;
 }
 
+/*
+ * What "wmaker --version" and "wmaker --global_defaults_path" print only
+ * changes along with the binary, so it is kept in a cache file with the
+ * location, size and modification time of the binary rather than running
+ * wmaker twice every time WPrefs starts.
+ */
+static char *wmakerInfoCachePath(void)
+{
+	char *path;
+
+	path = wstrconcat(wuserdatapath(), "/" PACKAGE_TARNAME);
+	if (access(path, F_OK) != 0)
+		mkdir(path, 0755);
+
+	path = wstrappend(path, "/WPrefs");
+	if (access(path, F_OK) != 0)
+		mkdir(path, 0755);
+
+	return wstrappend(path, "/wmaker-info.cache");
+}
+
+static char *wmakerInfoKey(const char *wmaker)
+{
+	struct stat st;
+	char *path, *key;
+	char buf[64];
+
+	path = wfindfile(getenv("PATH"), wmaker);
+	if (!path)
+		return NULL;
+
+	if (stat(path, &st) != 0) {
+		wfree(path);
+		return NULL;
+	}
+
+	snprintf(buf, sizeof(buf), " %lld %lld", (long long) st.st_size, (long long) st.st_mtime);
+	key = wstrappend(path, buf);
+
+	return key;
+}
+
+static Bool readWMakerInfo(const char *key, char *version, int vsize, char *gpath, int gsize)
+{
+	char *cache, line[1100];
+	FILE *file;
+	Bool ok = False;
+	char *ptr;
+
+	cache = wmakerInfoCachePath();
+	file = fopen(cache, "r");
+	wfree(cache);
+	if (!file)
+		return False;
+
+	if (fgets(line, sizeof(line), file)) {
+		ptr = strchr(line, '\n');
+		if (ptr)
+			*ptr = 0;
+
+		if (strcmp(line, key) == 0 && fgets(version, vsize, file) && fgets(gpath, gsize, file)) {
+			ptr = strchr(gpath, '\n');
+			if (ptr)
+				*ptr = 0;
+			ok = True;
+		}
+	}
+	fclose(file);
+
+	return ok;
+}
+
+static void writeWMakerInfo(const char *key, const char *version, const char *gpath)
+{
+	char *cache;
+	FILE *file;
+
+	cache = wmakerInfoCachePath();
+	file = fopen(cache, "w");
+	if (!file) {
+		werror("%s", cache);
+		wfree(cache);
+		return;
+	}
+
+	fprintf(file, "%s\n%s%s%s\n", key, version, strchr(version, '\n') ? "" : "\n", gpath);
+	if (fclose(file) < 0)
+		werror("%s", cache);
+
+	wfree(cache);
+}
+
 static void loadConfigurations(WMScreen * scr, WMWindow * mainw)
 {
 	WMPropList *db, *gdb;
 	char *path;
 	FILE *file;
 	char buffer[1024];
+	char gpath[1000];
 	char mbuf[1069]; /* Size of buffer and extra characters for the sprintfs */
+	char *cacheKey;
+	Bool cached;
 	int v1, v2, v3;
 
 	path = wdefaultspathfordomain("WindowMaker");
@@ -614,14 +711,18 @@ static void loadConfigurations(WMScreen * scr, WMWindow * mainw)
 	path = getenv("WMAKER_BIN_NAME");
 	if (!path)
 		path = "wmaker";
-	{
+
+	cacheKey = wmakerInfoKey(path);
+	cached = cacheKey && readWMakerInfo(cacheKey, buffer, sizeof(buffer), gpath, sizeof(gpath));
+
+	if (!cached) {
 		char *command;
 
 		command = wstrconcat(path, " --version");
 		file = popen(command, "r");
 		wfree(command);
 	}
-	if (!file || !fgets(buffer, 1023, file)) {
+	if (!cached && (!file || !fgets(buffer, 1023, file))) {
 		werror(_("could not extract version information from Window Maker"));
 		wfatal(_("Make sure wmaker is in your search path."));
 
@@ -631,7 +732,7 @@ static void loadConfigurations(WMScreen * scr, WMWindow * mainw)
 				_("OK"), NULL, NULL);
 		exit(1);
 	}
-	if (file)
+	if (!cached && file)
 		pclose(file);
 
 	if (sscanf(buffer, "Window Maker %i.%i.%i", &v1, &v2, &v3) != 3
@@ -658,26 +759,34 @@ static void loadConfigurations(WMScreen * scr, WMWindow * mainw)
 		WMRunAlertPanel(scr, mainw, _("Warning"), mbuf, _("OK"), NULL, NULL);
 	}
 
-	{
+	if (!cached) {
 		char *command;
 
 		command = wstrconcat(path, " --global_defaults_path");
 		file = popen(command, "r");
 		wfree(command);
-	}
-	if (!file || !fgets(buffer, 1023, file)) {
-		werror(_("could not run \"%s --global_defaults_path\"."), path);
-		exit(1);
-	} else {
-		char *ptr;
-		ptr = strchr(buffer, '\n');
-		if (ptr)
-			*ptr = 0;
-		strcat(buffer, "/WindowMaker");
+
+		if (!file || !fgets(gpath, sizeof(gpath), file)) {
+			werror(_("could not run \"%s --global_defaults_path\"."), path);
+			exit(1);
+		} else {
+			char *ptr;
+			ptr = strchr(gpath, '\n');
+			if (ptr)
+				*ptr = 0;
+		}
+
+		if (file)
+			pclose(file);
+
+		if (cacheKey)
+			writeWMakerInfo(cacheKey, buffer, gpath);
 	}
 
-	if (file)
-		pclose(file);
+	if (cacheKey)
+		wfree(cacheKey);
+
+	snprintf(buffer, sizeof(buffer), "%s/WindowMaker", gpath);
 
 	gdb = WMReadPropListFromFile(buffer);
 
@@ -75,6 +75,107 @@ AC_DEFUN_ONCE([WM_XEXT_CHECK_XSHM],
 ]) dnl AC_DEFUN
 
 
+# WM_XEXT_CHECK_XSYNC
+# -------------------
+#
+# Check for the X Synchronization extension, used to pace opaque resizes
+# with the clients that support the _NET_WM_SYNC_REQUEST protocol
+# The check depends on variable 'enable_xsync' being either:
+#   yes  - detect, fail if not found
+#   no   - do not detect, disable support
+#   auto - detect, disable if not found
+#
+# When found, append appropriate stuff in XLIBS, and append info to
+# the variable 'supported_xext'
+# When not found, append info to variable 'unsupported'
+AC_DEFUN_ONCE([WM_XEXT_CHECK_XSYNC],
+[WM_LIB_CHECK([XSync], [-lXext], [XSyncQueryExtension], [$XLIBS],
+    [wm_save_CFLAGS="$CFLAGS"
+     AC_COMPILE_IFELSE([AC_LANG_PROGRAM([dnl
+@%:@include <X11/Xlib.h>
+@%:@include <X11/extensions/sync.h>
+], [dnl
+  XSyncAlarmAttributes attr;
+  int event_base, error_base;
+
+  XSyncQueryExtension(NULL, &event_base, &error_base);
+  XSyncCreateAlarm(NULL, XSyncCACounter, &attr);])],
+        [],
+        [AC_MSG_ERROR([found $CACHEVAR but cannot compile using XSync header])])
+     CFLAGS="$wm_save_CFLAGS"],
+    [supported_xext], [XLIBS], [enable_xsync], [-])dnl
+]) dnl AC_DEFUN
+
+
+# WM_XEXT_CHECK_XFIXES
+# --------------------
+#
+# Check for the X Fixes extension, for the pointer barriers of hot corners
+# The check depends on variable 'enable_barriers' being either:
+#   yes  - detect, fail if not found
+#   no   - do not detect, disable support
+#   auto - detect, disable if not found
+#
+# When found, append appropriate stuff in BARRIER_LIBS, which configure
+# adds to XLIBS only when the barriers are enabled, and append info to
+# the variable 'supported_xext'
+# When not found, append info to variable 'unsupported'
+AC_DEFUN_ONCE([WM_XEXT_CHECK_XFIXES],
+[WM_LIB_CHECK([XFixes], [-lXfixes], [XFixesCreatePointerBarrier], [$XLIBS],
+    [wm_save_CFLAGS="$CFLAGS"
+     AS_IF([wm_fn_lib_try_compile "X11/extensions/Xfixes.h" "Window win;" "XFixesCreatePointerBarrier(NULL, win, 0, 0, 0, 0, BarrierPositiveX, 0, NULL)" ""],
+        [],
+        [AC_MSG_ERROR([found $CACHEVAR but cannot compile using XFixes header])])
+     CFLAGS="$wm_save_CFLAGS"],
+    [supported_xext], [BARRIER_LIBS], [enable_barriers], [-])dnl
+]) dnl AC_DEFUN
+
+
+# WM_XEXT_CHECK_XINPUT2
+# ---------------------
+#
+# Check for the X Input 2.3 extension, which reports the pointer barrier hits
+# The check depends on variable 'enable_barriers' like WM_XEXT_CHECK_XFIXES,
+# which is expected to be called first so it is 'no' if XFixes was not found
+#
+# When found, append appropriate stuff in BARRIER_LIBS, like
+# WM_XEXT_CHECK_XFIXES, and append info to the variable 'supported_xext'
+# When not found, append info to variable 'unsupported'
+AC_DEFUN_ONCE([WM_XEXT_CHECK_XINPUT2],
+[WM_LIB_CHECK([XInput2], [-lXi], [XISelectEvents], [$XLIBS],
+    [wm_save_CFLAGS="$CFLAGS"
+     AS_IF([wm_fn_lib_try_compile "X11/extensions/XInput2.h" "XIBarrierEvent ev;" "ev.evtype = XI_BarrierHit" ""],
+        [],
+        [AC_MSG_ERROR([found $CACHEVAR but cannot compile using XInput 2.3 header])])
+     CFLAGS="$wm_save_CFLAGS"],
+    [supported_xext], [BARRIER_LIBS], [enable_barriers], [-])dnl
+]) dnl AC_DEFUN
+
+
+# WM_XEXT_CHECK_XRENDER
+# ---------------------
+#
+# Check for the X Render extension, to draw the window decorations on the
+# server side
+# The check depends on variable 'enable_xrender' being either:
+#   yes  - detect, fail if not found
+#   no   - do not detect, disable support
+#   auto - detect, disable if not found
+#
+# When found, append appropriate stuff in XLIBS, and append info to
+# the variable 'supported_xext'
+# When not found, append info to variable 'unsupported'
+AC_DEFUN_ONCE([WM_XEXT_CHECK_XRENDER],
+[WM_LIB_CHECK([XRender], [-lXrender], [XRenderCreateLinearGradient], [$XLIBS],
+    [wm_save_CFLAGS="$CFLAGS"
+     AS_IF([wm_fn_lib_try_compile "X11/extensions/Xrender.h" "XLinearGradient line;" "XRenderCreateLinearGradient(NULL, &line, NULL, NULL, 0)" ""],
+        [],
+        [AC_MSG_ERROR([found $CACHEVAR but cannot compile using XRender header])])
+     CFLAGS="$wm_save_CFLAGS"],
+    [supported_xext], [XLIBS], [enable_xrender], [-])dnl
+]) dnl AC_DEFUN
+
+
 # WM_XEXT_CHECK_XMU
 # -----------------
 #
@@ -751,6 +751,8 @@ extern struct wmaker_global_variables {
 			Atom colormap_windows;
 			Atom colormap_notify;
 			Atom ignore_focus_events;
+			Atom sync_request;
+			Atom sync_request_counter;
 		} wm;
 
 		/* GNUStep related */
@@ -799,6 +801,20 @@ extern struct wmaker_global_variables {
 		} shape;
 #endif
 
+#ifdef USE_XSYNC
+		struct {
+			Bool supported;
+			int event_base;
+		} sync;
+#endif
+
+#ifdef USE_POINTER_BARRIERS
+		struct {
+			Bool supported;
+			int xi_opcode;	/* barrier events come as XInput2 events */
+		} barrier;
+#endif
+
 #ifdef KEEP_XKB_LOCK_STATUS
 		struct {
 			Bool supported;
@@ -865,4 +881,6 @@ extern const char WMNWorkspaceNameChanged[];
 
 extern const char WMNResetStacking[];
 
+#include "stats.h"
+
 #endif
@@ -40,10 +40,12 @@
 #include "misc.h"
 #include "event.h"
 #include "animations.h"
+#include "rootmenu.h"
 
 static void find_Maximus_geometry(WWindow *wwin, WArea usableArea, int *new_x, int *new_y,
 				  unsigned int *new_width, unsigned int *new_height);
 static void save_old_geometry(WWindow *wwin, int directions);
+static void hideApplication(WApplication *wapp, Bool arrange);
 /******* Local Variables *******/
 
 static int compareTimes(Time t1, Time t2)
@@ -103,6 +105,8 @@ void wSetFocusTo(virtual_screen *vscr, WWindow *wwin)
 		if (old_focused)
 			wWindowUnfocus(old_focused);
 
+		updateKeygrabsFocus(vscr, NULL);
+
 		if ((oapp) && wPreferences.highlight_active_app)
 			wApplicationDeactivate(oapp);
 
@@ -163,6 +167,7 @@ void wSetFocusTo(virtual_screen *vscr, WWindow *wwin)
 		focused->next = wwin;
 		wwin->next = NULL;
 		vscr->window.focused = wwin;
+		wApplicationWindowFocused(wwin);
 
 		if (oapp && oapp != napp) {
 			destroy_app_menu(napp);
@@ -1363,10 +1368,12 @@ static void hideWindow(WIcon *icon, int icon_x, int icon_y, WWindow *wwin, int a
 	wWindowUnmap(wwin);
 
 	wClientSetState(wwin, IconicState, icon->icon_win);
-	flushExpose();
 
-	if (animate)
+	/* The other windows are unmapped in one go, and flushed by the caller */
+	if (animate) {
+		flushExpose();
 		animation_hide(wwin, icon_x, icon_y);
+	}
 
 	wwin->flags.skip_next_animation = 0;
 	WMPostNotificationName(WMNChangedState, wwin, "hide");
@@ -1409,6 +1416,7 @@ void wHideOtherApplications(WWindow *awin)
 {
 	WWindow *wwin;
 	WApplication *tapp;
+	Bool arrange = False;
 
 	if (!awin)
 		return;
@@ -1427,10 +1435,12 @@ void wHideOtherApplications(WWindow *awin)
 					wIconifyWindow(wwin);
 				}
 			} else if (wwin->main_window != None && awin->main_window != wwin->main_window) {
-				tapp = wApplicationOf(wwin->main_window);
+				tapp = wwin->app;
 				if (tapp) {
+					/* the icons are arranged once, after all the applications */
 					tapp->flags.skip_next_animation = 1;
-					wHideApplication(tapp);
+					hideApplication(tapp, False);
+					arrange = True;
 				} else {
 					if (!WFLAGP(wwin, no_miniaturizable)) {
 						wwin->flags.skip_next_animation = 1;
@@ -1441,12 +1451,15 @@ void wHideOtherApplications(WWindow *awin)
 		}
 		wwin = wwin->prev;
 	}
+
+	if (arrange && wPreferences.auto_arrange_icons)
+		wArrangeIcons(awin->vscr, True);
 }
 
-void wHideApplication(WApplication *wapp)
+static void hideApplication(WApplication *wapp, Bool arrange)
 {
 	virtual_screen *vscr;
-	WWindow *wlist;
+	WWindow *wlist, *prev;
 	int hadfocus, animate;
 
 	if (!wapp) {
@@ -1461,30 +1474,35 @@ void wHideApplication(WApplication *wapp)
 
 	vscr = wapp->main_window_desc->vscr;
 	hadfocus = 0;
-	wlist = vscr->window.focused;
-	if (!wlist)
+	if (!wapp->windows)
 		return;
 
-	if (wlist->main_window == wapp->main_window)
-		wapp->last_focused = wlist;
+	if (vscr->window.focused && vscr->window.focused->app == wapp)
+		wapp->last_focused = vscr->window.focused;
 	else
 		wapp->last_focused = NULL;
 
 	animate = !wapp->flags.skip_next_animation;
 
+	/* most recently focused first, as in the focus list */
+	wlist = wapp->windows;
+	while (wlist->app_next)
+		wlist = wlist->app_next;
+
 	while (wlist) {
-		if (wlist->main_window == wapp->main_window) {
-			if (wlist->flags.focused)
-				hadfocus = 1;
-			if (wapp->app_icon) {
-				hideWindow(wapp->app_icon->icon, wapp->app_icon->x_pos,
-					   wapp->app_icon->y_pos, wlist, animate);
-				animate = False;
-			}
+		prev = wlist->app_prev;
+		if (wlist->flags.focused)
+			hadfocus = 1;
+		if (wapp->app_icon) {
+			hideWindow(wapp->app_icon->icon, wapp->app_icon->x_pos,
+				   wapp->app_icon->y_pos, wlist, animate);
+			animate = False;
 		}
-		wlist = wlist->prev;
+		wlist = prev;
 	}
 
+	flushExpose();
+
 	wapp->flags.skip_next_animation = 0;
 
 	if (hadfocus) {
@@ -1506,7 +1524,7 @@ void wHideApplication(WApplication *wapp)
 
 	wapp->flags.hidden = 1;
 
-	if (wPreferences.auto_arrange_icons)
+	if (arrange && wPreferences.auto_arrange_icons)
 		wArrangeIcons(vscr, True);
 
 #ifdef HIDDENDOT
@@ -1517,6 +1535,11 @@ void wHideApplication(WApplication *wapp)
 #endif
 }
 
+void wHideApplication(WApplication *wapp)
+{
+	hideApplication(wapp, True);
+}
+
 static void unhideWindow(int icon_x, int icon_y, WWindow *wwin, int animate, int bringToCurrentWS)
 {
 	if (bringToCurrentWS)
@@ -1545,87 +1568,95 @@ static void unhideWindow(int icon_x, int icon_y, WWindow *wwin, int animate, int
 void wUnhideApplication(WApplication *wapp, Bool miniwindows, Bool bringToCurrentWS)
 {
 	virtual_screen *vscr;
-	WWindow *wlist, *next;
+	WWindow *wlist, **windows;
 	WWindow *focused = NULL;
-	int animate;
+	int animate, count, i;
 
 	if (!wapp)
 		return;
 
 	vscr = wapp->main_window_desc->vscr;
-	wlist = vscr->window.focused;
+	wlist = wapp->windows;
 	if (!wlist)
 		return;
 
-	/* goto beginning of list */
-	while (wlist->prev)
-		wlist = wlist->prev;
-
 	animate = !wapp->flags.skip_next_animation;
 
-	while (wlist) {
-		next = wlist->next;
-
-		if (wlist->main_window == wapp->main_window) {
-			if (wlist->flags.focused)
-				focused = wlist;
-			else if (!focused || !focused->flags.focused)
-				focused = wlist;
-
-			if (wlist->flags.miniaturized) {
-				if ((bringToCurrentWS || wPreferences.sticky_icons ||
-				     wlist->frame->workspace == vscr->workspace.current) && wlist->miniwindow->icon) {
-					if (!wlist->miniwindow->icon->mapped) {
-						WCoord *coord;
-
-						coord = PlaceIcon(vscr, wGetHeadForWindow(wlist));
-						if (wlist->miniwindow->icon_x != coord->x ||
-							wlist->miniwindow->icon_y != coord->y)
-							XMoveWindow(dpy, wlist->miniwindow->icon->core->window, coord->x, coord->y);
-
-						wlist->miniwindow->icon_x = coord->x;
-						wlist->miniwindow->icon_y = coord->y;
-						miniwindow_map(wlist);
-						wfree(coord);
-					}
+	/*
+	 * Least recently focused first, so the last focused ends on top. The
+	 * windows focused while unhiding move to the end of the list, so it is
+	 * walked from a copy.
+	 */
+	for (count = 0; wlist; wlist = wlist->app_next)
+		count++;
 
-					wRaiseFrame(wlist->miniwindow->icon->vscr, wlist->miniwindow->icon->core);
-				}
+	windows = wmalloc(count * sizeof(WWindow *));
+	for (i = 0, wlist = wapp->windows; wlist; wlist = wlist->app_next)
+		windows[i++] = wlist;
 
-				if (bringToCurrentWS)
-					wWindowChangeWorkspace(wlist, vscr->workspace.current);
+	for (i = 0; i < count; i++) {
+		wlist = windows[i];
+		if (wlist->app != wapp)
+			continue;
+
+		if (wlist->flags.focused)
+			focused = wlist;
+		else if (!focused || !focused->flags.focused)
+			focused = wlist;
+
+		if (wlist->flags.miniaturized) {
+			if ((bringToCurrentWS || wPreferences.sticky_icons ||
+			     wlist->frame->workspace == vscr->workspace.current) && wlist->miniwindow->icon) {
+				if (!wlist->miniwindow->icon->mapped) {
+					WCoord *coord;
+
+					coord = PlaceIcon(vscr, wGetHeadForWindow(wlist));
+					if (wlist->miniwindow->icon_x != coord->x ||
+						wlist->miniwindow->icon_y != coord->y)
+						XMoveWindow(dpy, wlist->miniwindow->icon->core->window, coord->x, coord->y);
+
+					wlist->miniwindow->icon_x = coord->x;
+					wlist->miniwindow->icon_y = coord->y;
+					miniwindow_map(wlist);
+					wfree(coord);
+				}
 
-				wlist->flags.hidden = 0;
-				if (miniwindows && wlist->frame->workspace == vscr->workspace.current)
-					wDeiconifyWindow(wlist);
+				wRaiseFrame(wlist->miniwindow->icon->vscr, wlist->miniwindow->icon->core);
+			}
 
-				WMPostNotificationName(WMNChangedState, wlist, "hide");
-			} else if (wlist->flags.shaded) {
-				if (bringToCurrentWS)
-					wWindowChangeWorkspace(wlist, vscr->workspace.current);
+			if (bringToCurrentWS)
+				wWindowChangeWorkspace(wlist, vscr->workspace.current);
 
-				wlist->flags.hidden = 0;
-				wRaiseFrame(wlist->frame->vscr, wlist->frame->core);
-				if (wlist->frame->workspace == vscr->workspace.current) {
-					XMapWindow(dpy, wlist->frame->core->window);
-					if (miniwindows)
-						wUnshadeWindow(wlist);
-				}
+			wlist->flags.hidden = 0;
+			if (miniwindows && wlist->frame->workspace == vscr->workspace.current)
+				wDeiconifyWindow(wlist);
 
-				WMPostNotificationName(WMNChangedState, wlist, "hide");
-			} else if (wlist->flags.hidden) {
-				unhideWindow(wapp->app_icon->x_pos,
-					     wapp->app_icon->y_pos, wlist, animate, bringToCurrentWS);
-				animate = False;
-			} else {
-				if (bringToCurrentWS && wlist->frame->workspace != vscr->workspace.current)
-					wWindowChangeWorkspace(wlist, vscr->workspace.current);
+			WMPostNotificationName(WMNChangedState, wlist, "hide");
+		} else if (wlist->flags.shaded) {
+			if (bringToCurrentWS)
+				wWindowChangeWorkspace(wlist, vscr->workspace.current);
 
-				wRaiseFrame(wlist->frame->vscr, wlist->frame->core);
+			wlist->flags.hidden = 0;
+			wRaiseFrame(wlist->frame->vscr, wlist->frame->core);
+			if (wlist->frame->workspace == vscr->workspace.current) {
+				XMapWindow(dpy, wlist->frame->core->window);
+				if (miniwindows)
+					wUnshadeWindow(wlist);
 			}
+
+			WMPostNotificationName(WMNChangedState, wlist, "hide");
+		} else if (wlist->flags.hidden) {
+			unhideWindow(wapp->app_icon->x_pos,
+				     wapp->app_icon->y_pos, wlist, animate, bringToCurrentWS);
+			animate = False;
+		} else {
+			if (bringToCurrentWS && wlist->frame->workspace != vscr->workspace.current)
+				wWindowChangeWorkspace(wlist, vscr->workspace.current);
+
+			wRaiseFrame(wlist->frame->vscr, wlist->frame->core);
 		}
-		wlist = next;
 	}
+	wfree(windows);
 
 	wapp->flags.skip_next_animation = 0;
 	wapp->flags.hidden = 0;
@@ -1692,12 +1723,20 @@ void wRefreshDesktop(virtual_screen *vscr)
 	XFlush(dpy);
 }
 
+/*
+ * Put the application icons, then the miniwindows, in the next free slots
+ * of the icon yard of the head they belong to. Only the icons that end up
+ * in another slot are moved, all in the same, single animation.
+ */
 void wArrangeIcons(virtual_screen *vscr, Bool arrangeAll)
 {
 	WWindow *wwin;
 	WAppIcon *aicon;
+	WWindowMove *moves;
+	WAppIcon **moved_aicons;
+	int count, aicon_count, i;
 
-	int head;
+	int head = 0;
 	const int heads = wXineramaHeads(vscr->screen_ptr);
 
 	struct HeadVars {
@@ -1777,6 +1816,17 @@ void wArrangeIcons(virtual_screen *vscr, Bool arrangeAll)
 	? vars[head].yo + vars[head].ys*(vars[head].pi*isize) \
 	: vars[head].yo + vars[head].ys*(vars[head].si*isize))
 
+	/* at most one move per icon */
+	count = 0;
+	for (aicon = w_global.app_icon_list; aicon; aicon = aicon->next)
+		count++;
+	for (wwin = vscr->window.focused; wwin; wwin = wwin->prev)
+		count++;
+
+	moves = wmalloc(sizeof(WWindowMove) * count);
+	moved_aicons = wmalloc(sizeof(WAppIcon *) * count);
+	count = aicon_count = 0;
+
 	/* arrange application icons */
 	aicon = w_global.app_icon_list;
 	/* reverse them to avoid unnecessarily sliding of icons */
@@ -1788,12 +1838,19 @@ void wArrangeIcons(virtual_screen *vscr, Bool arrangeAll)
 			/* CHECK: can icon be NULL here ? */
 			/* The intention here is to place the AppIcon on the head that
 			 * contains most of the applications _main_ window. */
-			head = wGetHeadForWindow(aicon->icon->owner);
-
-			if (aicon->x_pos != X || aicon->y_pos != Y)
-				animation_slide_window(aicon->icon->core->window, aicon->x_pos, aicon->y_pos, X, Y);
+			if (heads > 1)
+				head = wGetHeadForWindow(aicon->icon->owner);
+
+			if (aicon->x_pos != X || aicon->y_pos != Y) {
+				moves[count].win = aicon->icon->core->window;
+				moves[count].from_x = aicon->x_pos;
+				moves[count].from_y = aicon->y_pos;
+				moves[count].to_x = X;
+				moves[count].to_y = Y;
+				count++;
+				moved_aicons[aicon_count++] = aicon;
+			}
 
-			wAppIconMove(aicon, X, Y);
 			vars[head].pi++;
 			if (vars[head].pi >= vars[head].pf) {
 				vars[head].pi = 0;
@@ -1814,11 +1871,18 @@ void wArrangeIcons(virtual_screen *vscr, Bool arrangeAll)
 		    (wwin->frame->workspace == vscr->workspace.current ||
 		     IS_OMNIPRESENT(wwin) || wPreferences.sticky_icons)) {
 
-			head = wGetHeadForWindow(wwin);
+			if (heads > 1)
+				head = wGetHeadForWindow(wwin);
 
 			if (arrangeAll || !wwin->flags.icon_moved) {
-				if (wwin->miniwindow->icon_x != X || wwin->miniwindow->icon_y != Y)
-					move_window(wwin->miniwindow->icon->core->window, wwin->miniwindow->icon_x, wwin->miniwindow->icon_y, X, Y);
+				if (wwin->miniwindow->icon_x != X || wwin->miniwindow->icon_y != Y) {
+					moves[count].win = wwin->miniwindow->icon->core->window;
+					moves[count].from_x = wwin->miniwindow->icon_x;
+					moves[count].from_y = wwin->miniwindow->icon_y;
+					moves[count].to_x = X;
+					moves[count].to_y = Y;
+					count++;
+				}
 
 				wwin->miniwindow->icon_x = X;
 				wwin->miniwindow->icon_y = Y;
@@ -1836,6 +1900,16 @@ void wArrangeIcons(virtual_screen *vscr, Bool arrangeAll)
 		wwin = wwin->next;
 	}
 
+	move_windows(moves, count);
+
+	/* the windows are already there */
+	for (i = 0; i < aicon_count; i++) {
+		moved_aicons[i]->x_pos = moves[i].to_x;
+		moved_aicons[i]->y_pos = moves[i].to_y;
+	}
+
+	wfree(moved_aicons);
+	wfree(moves);
 	wfree(vars);
 }
 
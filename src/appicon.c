@@ -267,7 +267,7 @@ void removeAppIconFor(WApplication *wapp)
 		wapp->app_icon->attracted = 0;
 		wapp->app_icon->icon->shadowed = 0;
 		wapp->app_icon->main_window = None;
-		wapp->app_icon->pid = 0;
+		wDockSetLaunchPid(wapp->app_icon, 0);
 		wapp->app_icon->icon->owner = NULL;
 		wapp->app_icon->icon->icon_win = None;
 
@@ -311,6 +311,7 @@ static WAppIcon *dock_icon_create_core(virtual_screen *vscr, char *command, char
 		btn->wm_instance = wstrdup(wm_instance);
 
 	set_icon_image_from_database(btn->icon, btn->wm_instance, btn->wm_class, btn->command);
+	wDockIndexIcon(btn);
 
 	return btn;
 }
@@ -402,6 +403,7 @@ WAppIcon *create_appicon(virtual_screen *vscr, char *command, char *wm_class, ch
 
 void wAppIconDestroy(WAppIcon *aicon)
 {
+	wDockUnindexIcon(aicon);
 	RemoveFromStackList(aicon->icon->vscr, aicon->icon->core);
 	wIconDestroy(aicon->icon);
 	if (aicon->command)
@@ -1316,54 +1318,9 @@ static void wApplicationSaveIconPathFor(const char *iconPath, const char *wm_ins
 		UpdateDomainFile(w_global.domain.window_attr);
 }
 
-static WAppIcon *findDockIconFor(WDock *dock, Window main_window)
-{
-	WAppIcon *aicon = NULL;
-
-	aicon = wDockFindIconForWindow(dock, main_window);
-	if (!aicon) {
-		wDockTrackWindowLaunch(dock, main_window);
-		aicon = wDockFindIconForWindow(dock, main_window);
-	}
-	return aicon;
-}
-
 static void create_appicon_from_dock(WWindow *wwin, WApplication *wapp)
 {
-	virtual_screen *vscr = wwin->vscr;
-	Window main_window = wapp->main_window;
-	wapp->app_icon = NULL;
-
-	if (vscr->last_dock)
-		wapp->app_icon = findDockIconFor(vscr->last_dock, main_window);
-
-	/* check main dock if we did not find it in last dock */
-	if (!wapp->app_icon && vscr->dock.dock)
-		wapp->app_icon = findDockIconFor(vscr->dock.dock, main_window);
-
-	/* check clips */
-	if (!wapp->app_icon) {
-		int i;
-		for (i = 0; i < vscr->workspace.count; i++) {
-			WDock *dock = vscr->workspace.array[i]->clip;
-
-			if (dock)
-				wapp->app_icon = findDockIconFor(dock, main_window);
-
-			if (wapp->app_icon)
-				break;
-		}
-	}
-
-	/* Finally check drawers */
-	if (!wapp->app_icon) {
-		WDrawerChain *dc;
-		for (dc = vscr->drawer.drawers; dc != NULL; dc = dc->next) {
-			wapp->app_icon = findDockIconFor(dc->adrawer, main_window);
-			if (wapp->app_icon)
-				break;
-		}
-	}
+	wapp->app_icon = wDockFindLaunchedIcon(wwin->vscr, wapp->main_window);
 }
 
 /* Add the appicon to the appiconlist */
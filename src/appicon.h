@@ -34,7 +34,10 @@ typedef struct WAppIcon {
 					 * something is pasted */
 	char *wm_class;
 	char *wm_instance;
-	pid_t pid;			 /* for apps launched from the dock */
+	pid_t pid;			 /* for apps launched from the dock,
+					  * set with wDockSetLaunchPid() */
+	struct WAppIcon *class_next;	 /* launch tracking index chains */
+	struct WAppIcon *pid_next;
 	Window main_window;
 	struct WDock *dock;		 /* In which dock is docked. */
 	struct AppSettingsPanel *panel;  /* Settings Panel */
@@ -78,6 +78,9 @@ WApplication *wApplicationCreate(WWindow *wwin)
 	int foo;
 	unsigned int bar;
 
+	if (wwin->app && wwin->app->main_window != main_window)
+		wApplicationRemoveWindow(wwin);
+
 	if (main_window == None || main_window == scr->root_win)
 		return NULL;
 
@@ -92,6 +95,13 @@ WApplication *wApplicationCreate(WWindow *wwin)
 		    wapp->app_icon->relaunching && wapp->main_window_desc->fake_group)
 			wDockFinishLaunch(wapp->app_icon);
 
+		/* the leader may have just been pointed to itself */
+		leader = wWindowFor(main_window);
+		if (leader && leader->main_window == main_window)
+			wApplicationAddWindow(wapp, leader);
+
+		wApplicationAddWindow(wapp, wwin);
+
 		return wapp;
 	}
 
@@ -112,10 +122,15 @@ WApplication *wApplicationCreate(WWindow *wwin)
 
 	wapp->main_window_desc->fake_group = wwin->fake_group;
 	wapp->main_window_desc->miniwindow->net_icon_image = RRetainImage(wwin->miniwindow->net_icon_image);
+	wapp->main_window_desc->miniwindow->net_icon_hash = wwin->miniwindow->net_icon_hash;
 
 	leader = wWindowFor(main_window);
-	if (leader)
+	if (leader) {
 		leader->main_window = main_window;
+		wApplicationAddWindow(wapp, leader);
+	}
+
+	wApplicationAddWindow(wapp, wwin);
 
 	/* Set application wide attributes from the leader */
 	wapp->flags.hidden = WFLAGP(wapp->main_window_desc, start_hidden);
@@ -151,6 +166,9 @@ void wApplicationDestroy(WApplication *wapp)
 		return;
 	}
 
+	while (wapp->windows)
+		wApplicationRemoveWindow(wapp->windows);
+
 	if (wapp->next)
 		wapp->next->prev = wapp->prev;
 	if (wapp->prev)
@@ -176,6 +194,100 @@ void wApplicationDestroy(WApplication *wapp)
 	wfree(wapp);
 }
 
+/*
+ * The windows of an application, transients included, are kept in a list
+ * of their own, in the same order as the focus list. Hiding and unhiding
+ * the application then only go through its own windows.
+ */
+void wApplicationAddWindow(WApplication *wapp, WWindow *wwin)
+{
+	WWindow *next, *last;
+
+	if (wwin->app == wapp)
+		return;
+
+	wApplicationRemoveWindow(wwin);
+	wwin->app = wapp;
+
+	/* Windows being managed are not in the focus list yet, and are
+	 * added at its beginning later on */
+	if (!wwin->prev && !wwin->next) {
+		next = wapp->windows;
+	} else {
+		next = wwin->next;
+		while (next && next->app != wapp)
+			next = next->next;
+	}
+
+	if (next) {
+		wwin->app_prev = next->app_prev;
+		wwin->app_next = next;
+		if (next->app_prev)
+			next->app_prev->app_next = wwin;
+		else
+			wapp->windows = wwin;
+
+		next->app_prev = wwin;
+	} else if (wapp->windows) {
+		last = wapp->windows;
+		while (last->app_next)
+			last = last->app_next;
+
+		last->app_next = wwin;
+		wwin->app_prev = last;
+	} else {
+		wapp->windows = wwin;
+	}
+}
+
+void wApplicationRemoveWindow(WWindow *wwin)
+{
+	WApplication *wapp = wwin->app;
+
+	if (!wapp)
+		return;
+
+	if (wwin->app_prev)
+		wwin->app_prev->app_next = wwin->app_next;
+	else
+		wapp->windows = wwin->app_next;
+
+	if (wwin->app_next)
+		wwin->app_next->app_prev = wwin->app_prev;
+
+	if (wapp->last_focused == wwin)
+		wapp->last_focused = NULL;
+
+	wwin->app = NULL;
+	wwin->app_prev = NULL;
+	wwin->app_next = NULL;
+}
+
+/* The window went to the end of the focus list */
+void wApplicationWindowFocused(WWindow *wwin)
+{
+	WApplication *wapp = wwin->app;
+	WWindow *last;
+
+	if (!wapp || !wwin->app_next)
+		return;
+
+	last = wwin->app_next;
+	while (last->app_next)
+		last = last->app_next;
+
+	if (wwin->app_prev)
+		wwin->app_prev->app_next = wwin->app_next;
+	else
+		wapp->windows = wwin->app_next;
+
+	wwin->app_next->app_prev = wwin->app_prev;
+
+	last->app_next = wwin;
+	wwin->app_prev = last;
+	wwin->app_next = NULL;
+}
+
 void wApplicationActivate(WApplication *wapp)
 {
 	if (wapp->app_icon) {
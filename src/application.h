@@ -23,6 +23,8 @@ typedef struct WApplication {
     WMenu *user_menu;		       /* user menu */
     struct WAppIcon *app_icon;
     int refcount;
+    struct WWindow *windows;	       /* windows of the application, the
+                                        * least recently focused first */
     struct WWindow *last_focused;      /* focused window before hide */
     int last_workspace;		       /* last workspace used to work on the
                                         * app */
@@ -40,6 +42,10 @@ WApplication *wApplicationCreate(struct WWindow *wwin);
 WApplication *wApplicationOf(Window window);
 void wApplicationDestroy(WApplication *wapp);
 
+void wApplicationAddWindow(WApplication *wapp, struct WWindow *wwin);
+void wApplicationRemoveWindow(struct WWindow *wwin);
+void wApplicationWindowFocused(struct WWindow *wwin);
+
 void wAppBounce(WApplication *);
 void wAppBounceWhileUrgent(WApplication *);
 void wApplicationActivate(WApplication *);
@@ -406,6 +406,7 @@ void wClientCheckProperty(WWindow *wwin, XPropertyEvent *event)
 			/* 5 - destroy application */
 		case 5:
 			wApplicationDestroy(wApplicationOf(wwin->main_window));
+			wApplicationRemoveWindow(wwin);
 			wwin->main_window = None;
 			wwin->group_id = None;
 			break;
@@ -554,6 +555,8 @@ void wClientCheckProperty(WWindow *wwin, XPropertyEvent *event)
 
 							if (foo->main_window)
 								wApplicationCreate(foo);
+							else
+								wApplicationRemoveWindow(foo);
 						}
 						foo = foo->prev;
 					}
@@ -58,6 +58,8 @@
 #include "misc.h"
 #include "winmenu.h"
 #include "miniwindow.h"
+#include "rootmenu.h"
+#include "event.h"
 
 typedef struct _WDefaultEntry  WDefaultEntry;
 typedef int (WDECallbackConvert) (WDefaultEntry *entry, WMPropList *plvalue, void *addr);
@@ -238,6 +240,7 @@ static WDECallbackUpdate setClipTitleColorCollapsed;
 static WDECallbackUpdate setMenuStyle;
 static WDECallbackUpdate setSwPOptions;
 static WDECallbackUpdate updateUsableArea;
+static WDECallbackUpdate updateHotCorners;
 static WDECallbackUpdate setModifierKeyLabels;
 static WDECallbackUpdate setHotCornerActions;
 static WDECallbackUpdate setCursor_root;
@@ -285,6 +288,7 @@ static WDECallbackUpdate setCursor_text;
 #define REFRESH_USABLE_AREA	(1<<15)
 #define REFRESH_ARRANGE_ICONS	(1<<16)
 #define REFRESH_STICKY_ICONS	(1<<17)
+#define REFRESH_HOT_CORNERS	(1<<18)
 
 #define REFRESH_FRAME_BORDER REFRESH_MENU_FONT|REFRESH_WINDOW_FONT
 
@@ -769,13 +773,13 @@ WDefaultEntry optionList[] = {
 	{"WrapMenus", "NO", NULL,
 	    &wPreferences.wrap_menus, getBool, NULL, NULL, NULL, 1},
 	{"ScrollableMenus", "YES", NULL,
-	    &wPreferences.scrollable_menus, getBool, NULL, NULL, NULL, 1},
+	    &wPreferences.scrollable_menus, getBool, updateHotCorners, NULL, NULL, 1},
 	{"HotCorners", "NO", NULL,
-	    &wPreferences.hot_corners, getBool, NULL, NULL, NULL, 1},
+	    &wPreferences.hot_corners, getBool, updateHotCorners, NULL, NULL, 1},
 	{"HotCornerDelay", "250", (void *) &wPreferences.hot_corner_delay,
 	    &wPreferences.hot_corner_delay, getInt, NULL, NULL, NULL, 1},
 	{"HotCornerEdge", "2", (void *) &wPreferences.hot_corner_edge,
-	    &wPreferences.hot_corner_edge, getInt, NULL, NULL, NULL, 1},
+	    &wPreferences.hot_corner_edge, getInt, updateHotCorners, NULL, NULL, 1},
 	{"HotCornerActions", "(\"None\", \"None\", \"None\", \"None\")", NULL,
 	    &wPreferences.hotcorneractions, getPropList, setHotCornerActions, NULL, NULL, 1},
 	{"MenuScrollSpeed", "fast", seSpeeds,
@@ -1703,6 +1707,9 @@ static void refresh_defaults(virtual_screen *vscr, unsigned int needs_refresh)
 {
 	int foo = 0;
 
+	/* render the new decorations of all the frames at once */
+	wFrameWindowBeginBatch();
+
 	if (needs_refresh & REFRESH_MENU_TITLE_TEXTURE)
 		foo |= WTextureSettings;
 	if (needs_refresh & REFRESH_MENU_TITLE_FONT)
@@ -1749,6 +1756,8 @@ static void refresh_defaults(virtual_screen *vscr, unsigned int needs_refresh)
 	if (needs_refresh & REFRESH_ICON_TILE)
 		WMPostNotificationName(WNIconTileSettingsChanged, NULL, NULL);
 
+	wFrameWindowEndBatch();
+
 	if (needs_refresh & REFRESH_WORKSPACE_MENU) {
 		if (vscr->workspace.menu) {
 			wWorkspaceMenuUpdate(vscr, vscr->workspace.menu);
@@ -1767,6 +1776,9 @@ static void refresh_defaults(virtual_screen *vscr, unsigned int needs_refresh)
 	if (needs_refresh & REFRESH_USABLE_AREA && !(needs_refresh & REFRESH_ARRANGE_ICONS))
 		wScreenUpdateUsableArea(vscr);
 
+	if (needs_refresh & REFRESH_HOT_CORNERS)
+		wHotCornersUpdate(vscr->screen_ptr);
+
 	if (needs_refresh & REFRESH_STICKY_ICONS && vscr->workspace.array) {
 		wWorkspaceForceChange(vscr, vscr->workspace.current);
 		wArrangeIcons(vscr, False);
@@ -3544,19 +3556,11 @@ static void set_keygrab(SHBinding *shortcut, char *value)
  */
 static void wkbd_set_keygrab(virtual_screen *vscr, int idx, const char *value)
 {
-	WWindow *wwin;
-
 	set_keygrab(&wKeyBindings[idx], (char *)value);
 	wKeyBindings[idx].type = RSM_WKBD;
 	wKeyBindings[idx].wkbd_idx = idx;
 
-	wwin = vscr->window.focused;
-	while (wwin != NULL) {
-		XUngrabKey(dpy, AnyKey, AnyModifier, wwin->frame->core->window);
-		if (!WFLAGP(wwin, no_bind_keys))
-			wWindowSetKeyGrabs(wwin);
-		wwin = wwin->prev;
-	}
+	rebindKeygrabs(vscr);
 }
 
 static int setKeyGrab_rootmenu(virtual_screen *vscr)
@@ -4151,6 +4155,14 @@ static int updateUsableArea(virtual_screen *vscr)
 	return REFRESH_USABLE_AREA;
 }
 
+static int updateHotCorners(virtual_screen *vscr)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) vscr;
+
+	return REFRESH_HOT_CORNERS;
+}
+
 static int setWorkspaceMapBackground(virtual_screen *vscr)
 {
 	WTexture *texture = get_texture_from_defstruct(vscr, wPreferences.texture.workspacemapback);
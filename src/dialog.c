@@ -24,6 +24,10 @@
 #include <limits.h>
 #include <errno.h>
 
+#ifdef HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
+
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
 #endif
@@ -58,6 +62,8 @@ static void SaveHistory(WMArray *history, const char *filename);
 static void toggleSaveSession(WMWidget *w, void *data);
 static char *HistoryFileName(const char *name);
 static WMArray *GenerateVariants(const char *complete);
+static void PathIndexUpdate(void);
+static void PathIndexPrime(void *data);
 static WMArray *LoadHistory(const char *filename, int max);
 static WMPoint getCenter(virtual_screen *vscr, int width, int height);
 
@@ -235,6 +241,7 @@ static void ScanFiles(const char *dir, const char *prefix,
 	if (!d)
 		return;
 
+	/* the names in a single directory are unique, no need to look for duplicates */
 	while ((de = readdir(d)) != NULL) {
 		if (strlen(de->d_name) > prefixlen &&
 		    !strncmp(prefix, de->d_name, prefixlen) &&
@@ -244,9 +251,7 @@ static void ScanFiles(const char *dir, const char *prefix,
 
 			if (stat(fullfilename, &sb) == 0 &&
 			    (sb.st_mode & acceptmask) &&
-			    !(sb.st_mode & declinemask) &&
-			    WMFindInArray(result, (WMMatchDataProc *) strmatch,
-					  de->d_name + prefixlen) == WANotFound) {
+			    !(sb.st_mode & declinemask)) {
 				suffix = wstrdup(de->d_name + prefixlen);
 				if (sb.st_mode & S_IFDIR)
 					suffix = wstrappend(suffix, "/");
@@ -260,11 +265,305 @@ static void ScanFiles(const char *dir, const char *prefix,
 	closedir(d);
 }
 
+/*
+ * Index of the executables found in $PATH, used to complete the first word
+ * in the run dialog. It is a sorted array of unique names, so completing is
+ * a binary search for the prefix followed by a walk over the matches.
+ *
+ * The index is built the first time it is needed, or when the run dialog is
+ * idle, and rebuilt only when $PATH changes or one of its directories gets
+ * modified. With inotify the directories are watched, otherwise their mtime
+ * is checked before each lookup. At idle time, it is built by slices of
+ * PATH_INDEX_SLICE directory entries, so that the dialog keeps answering
+ * while a large $PATH is read; a lookup finishes the build at once.
+ */
+#define PATH_INDEX_SLICE	256
+
+static struct {
+	char *path;		/* value of $PATH the index was built for */
+	char **names;
+	int count;
+
+	struct {
+		char *name;
+		time_t mtime;
+	} *dirs;
+	int dir_count;
+
+#ifdef HAVE_INOTIFY
+	int fd;			/* inotify queue, -1 when not watching */
+#endif
+	Bool dirty;
+	WMHandlerID prime;
+
+	/* build in progress */
+	Bool building;
+	int size;		/* of names */
+	int next_dir;
+	DIR *scan;		/* of dirs[next_dir] */
+} path_index = {
+#ifdef HAVE_INOTIFY
+	.fd = -1,
+#endif
+	.dirty = True
+};
+
+static int path_index_compare(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void PathIndexClear(void)
+{
+	int i;
+
+	for (i = 0; i < path_index.count; i++)
+		wfree(path_index.names[i]);
+	if (path_index.names)
+		wfree(path_index.names);
+	path_index.names = NULL;
+	path_index.count = 0;
+
+	for (i = 0; i < path_index.dir_count; i++)
+		wfree(path_index.dirs[i].name);
+	if (path_index.dirs)
+		wfree(path_index.dirs);
+	path_index.dirs = NULL;
+	path_index.dir_count = 0;
+
+	if (path_index.path)
+		wfree(path_index.path);
+	path_index.path = NULL;
+
+	if (path_index.scan)
+		closedir(path_index.scan);
+	path_index.scan = NULL;
+	path_index.building = False;
+	path_index.size = 0;
+	path_index.next_dir = 0;
+
+#ifdef HAVE_INOTIFY
+	/* closing the queue drops all the watches at once */
+	if (path_index.fd >= 0)
+		close(path_index.fd);
+	path_index.fd = -1;
+#endif
+}
+
+/* Start building the index for the path, PathIndexStep() reads the directories */
+static void PathIndexStart(const char *path)
+{
+	const char *p, *pos;
+	struct stat sb;
+
+	PathIndexClear();
+	path_index.path = wstrdup(path);
+
+#ifdef HAVE_INOTIFY
+	/* not to be inherited by the applications that are launched */
+	path_index.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
+	for (p = path; p; p = pos ? pos + 1 : NULL) {
+		char *dir;
+
+		pos = strchr(p, ':');
+		dir = pos ? wstrndup(p, pos - p) : wstrdup(p);
+		if (*dir == '\0') {
+			wfree(dir);
+			continue;
+		}
+
+		path_index.dirs = wrealloc(path_index.dirs, (path_index.dir_count + 1) * sizeof(*path_index.dirs));
+		path_index.dirs[path_index.dir_count].name = dir;
+		path_index.dirs[path_index.dir_count].mtime = stat(dir, &sb) == 0 ? sb.st_mtime : 0;
+#ifdef HAVE_INOTIFY
+		/* watch before reading, so that no change slips in between */
+		if (path_index.fd >= 0)
+			inotify_add_watch(path_index.fd, dir,
+					  IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO |
+					  IN_DELETE_SELF | IN_MOVE_SELF);
+#endif
+		path_index.dir_count++;
+	}
+
+	path_index.building = True;
+}
+
+/* Read up to max entries of the directories, all of them if max is negative; True when done */
+static Bool PathIndexStep(int max)
+{
+	struct dirent *de;
+	struct stat sb;
+	char *fullfilename;
+	const char *dir;
+
+	while (max != 0 && path_index.next_dir < path_index.dir_count) {
+		dir = path_index.dirs[path_index.next_dir].name;
+
+		if (!path_index.scan) {
+			path_index.scan = opendir(dir);
+			if (!path_index.scan) {
+				path_index.next_dir++;
+				continue;
+			}
+		}
+
+		de = readdir(path_index.scan);
+		if (!de) {
+			closedir(path_index.scan);
+			path_index.scan = NULL;
+			path_index.next_dir++;
+			continue;
+		}
+
+		if (max > 0)
+			max--;
+
+		if (de->d_name[0] == '.' && (de->d_name[1] == '\0' ||
+					     (de->d_name[1] == '.' && de->d_name[2] == '\0')))
+			continue;
+
+		fullfilename = wstrconcat((char *)dir, "/");
+		fullfilename = wstrappend(fullfilename, de->d_name);
+
+		if (stat(fullfilename, &sb) == 0 &&
+		    (sb.st_mode & (S_IXOTH | S_IXGRP | S_IXUSR)) && !S_ISDIR(sb.st_mode)) {
+			if (path_index.count == path_index.size) {
+				path_index.size = path_index.size ? path_index.size * 2 : 256;
+				path_index.names = wrealloc(path_index.names, path_index.size * sizeof(char *));
+			}
+			path_index.names[path_index.count++] = wstrdup(de->d_name);
+		}
+		wfree(fullfilename);
+	}
+
+	return path_index.next_dir >= path_index.dir_count;
+}
+
+static void PathIndexFinish(void)
+{
+	int i, j;
+
+	/* the same command can be found in several directories */
+	qsort(path_index.names, path_index.count, sizeof(char *), path_index_compare);
+	for (i = 0, j = 0; i < path_index.count; i++) {
+		if (j > 0 && strcmp(path_index.names[j - 1], path_index.names[i]) == 0)
+			wfree(path_index.names[i]);
+		else
+			path_index.names[j++] = path_index.names[i];
+	}
+	path_index.count = j;
+
+	path_index.building = False;
+	path_index.dirty = False;
+}
+
+static Bool PathIndexChanged(void)
+{
+	struct stat sb;
+	int i;
+
+#ifdef HAVE_INOTIFY
+	if (path_index.fd >= 0) {
+		char buff[(sizeof(struct inotify_event) + NAME_MAX + 1) * 5];
+		Bool changed = False;
+
+		/* any event at all means a rebuild, just drain the queue */
+		while (read(path_index.fd, buff, sizeof(buff)) > 0)
+			changed = True;
+
+		return changed;
+	}
+#endif
+
+	for (i = 0; i < path_index.dir_count; i++) {
+		time_t mtime = stat(path_index.dirs[i].name, &sb) == 0 ? sb.st_mtime : 0;
+
+		if (mtime != path_index.dirs[i].mtime)
+			return True;
+	}
+
+	return False;
+}
+
+/* Start a new build of the index if it is out of date */
+static void PathIndexCheck(void)
+{
+	const char *path;
+
+	path = getenv("PATH");
+	if (!path)
+		path = "";
+
+	/* the changes seen during a build are only checked after it */
+	if (path_index.building && strcmp(path, path_index.path) == 0)
+		return;
+
+	if (path_index.dirty || !path_index.path || strcmp(path, path_index.path) != 0 || PathIndexChanged())
+		PathIndexStart(path);
+}
+
+static void PathIndexUpdate(void)
+{
+	PathIndexCheck();
+
+	if (path_index.building) {
+		PathIndexStep(-1);
+		PathIndexFinish();
+	}
+}
+
+static void PathIndexPrime(void *data)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
+
+	path_index.prime = NULL;
+	PathIndexCheck();
+
+	if (!path_index.building)
+		return;
+
+	if (PathIndexStep(PATH_INDEX_SLICE))
+		PathIndexFinish();
+	else
+		path_index.prime = WMAddIdleHandler(PathIndexPrime, NULL);
+}
+
+static void PathIndexLookup(const char *prefix, WMArray *result)
+{
+	int prefixlen, low, high, mid;
+
+	PathIndexUpdate();
+
+	/* find the first name not sorting before the prefix */
+	low = 0;
+	high = path_index.count;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (strcmp(path_index.names[mid], prefix) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	prefixlen = strlen(prefix);
+	for (; low < path_index.count; low++) {
+		const char *name = path_index.names[low];
+
+		if (strncmp(name, prefix, prefixlen) != 0)
+			break;
+		if (name[prefixlen] != '\0')
+			WMAddToArray(result, wstrdup(name + prefixlen));
+	}
+}
+
 static WMArray *GenerateVariants(const char *complete)
 {
 	Bool firstWord = True;
 	WMArray *variants = NULL;
-	char *pos = NULL, *path = NULL, *tmp = NULL, *dir = NULL, *prefix = NULL;
+	char *pos = NULL, *tmp = NULL, *dir = NULL, *prefix = NULL;
 
 	variants = WMCreateArrayWithDestructor(0, wfree);
 
@@ -295,20 +594,9 @@ static WMArray *GenerateVariants(const char *complete)
 	} else if (*complete == '~') {
 		WMAddToArray(variants, wstrdup("/"));
 	} else if (firstWord) {
-		path = getenv("PATH");
-		while (path) {
-			pos = strchr(path, ':');
-			if (pos) {
-				tmp = wstrndup(path, pos - path);
-				path = pos + 1;
-			} else if (*path != '\0') {
-				tmp = wstrdup(path);
-				path = NULL;
-			} else
-				break;
-			ScanFiles(tmp, complete, S_IXOTH | S_IXGRP | S_IXUSR, S_IFDIR, variants);
-			wfree(tmp);
-		}
+		/* comes out sorted already */
+		PathIndexLookup(complete, variants);
+		return variants;
 	}
 
 	WMSortArray(variants, (WMCompareDataProc *) pstrcmp);
@@ -447,7 +735,16 @@ int wAdvancedInputDialog(virtual_screen *vscr, const char *title,
 
 	WMCreateEventHandler(WMWidgetView(p->panel->text), KeyPressMask, handleHistoryKeyPress, p);
 
+	/* get the command index ready while the user types */
+	if (!path_index.prime)
+		path_index.prime = WMAddIdleHandler(PathIndexPrime, NULL);
+
 	result = create_input_panel(vscr, p->panel);
+
+	if (path_index.prime) {
+		WMDeleteIdleHandler(path_index.prime);
+		path_index.prime = NULL;
+	}
 	if (result) {
 		wfree(WMReplaceInArray(p->history, 0, wstrdup(result)));
 		SaveHistory(p->history, filename);
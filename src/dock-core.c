@@ -50,6 +50,7 @@
 #include "placement.h"
 #include "misc.h"
 #include "event.h"
+#include "wmspec.h"
 #ifdef USE_DOCK_XDND
 #include "xdnd.h"
 #endif
@@ -492,7 +493,7 @@ void launchDockedApplication(WAppIcon *btn, Bool withSelection)
 	btn->drop_launch = 0;
 	btn->paste_launch = withSelection;
 	vscr->last_dock = btn->dock;
-	btn->pid = execCommand(btn, (withSelection ? btn->paste_command : btn->command), NULL);
+	wDockSetLaunchPid(btn, execCommand(btn, (withSelection ? btn->paste_command : btn->command), NULL));
 	if (btn->pid > 0) {
 		if (btn->buggy_app) {
 			/* give feedback that the app was launched */
@@ -874,7 +875,7 @@ void wDockLaunchWithState(WAppIcon *btn, WSavedState *state)
 		btn->drop_launch = 0;
 		btn->paste_launch = 0;
 
-		btn->pid = execCommand(btn, btn->command, state);
+		wDockSetLaunchPid(btn, execCommand(btn, btn->command, state));
 
 		if (btn->pid > 0) {
 			if (!btn->forced_dock && !btn->buggy_app) {
@@ -987,7 +988,7 @@ int wDockReceiveDNDDrop(virtual_screen *vscr, XEvent *event)
 	btn->paste_launch = 0;
 	btn->drop_launch = 1;
 	vscr->last_dock = dock;
-	btn->pid = execCommand(btn, btn->dnd_command, NULL);
+	wDockSetLaunchPid(btn, execCommand(btn, btn->dnd_command, NULL));
 	if (btn->pid > 0) {
 		dockIconPaint(btn);
 	} else {
@@ -1625,6 +1626,54 @@ static void moveDock(WDock *dock, int new_x, int new_y)
 	}
 }
 
+/*
+ * Put the dock back along its side of the screen, or the clip back on a head,
+ * after the screen layout changed.
+ */
+void wDockKeepOnScreen(WDock *dock)
+{
+	virtual_screen *vscr = dock->vscr;
+	WScreen *scr = vscr->screen_ptr;
+	int x = dock->x_pos, y = dock->y_pos;
+	int i;
+
+	switch (dock->type) {
+	case WM_DOCK:
+		if (dock->on_right_side)
+			x = scr->scr_width - ICON_SIZE - DOCK_EXTRA_SPACE;
+		else
+			x = DOCK_EXTRA_SPACE;
+
+		/* only the vertical position is kept inside a head, as when dragging it */
+		i = x;
+		wScreenKeepInside(vscr, &i, &y, ICON_SIZE, ICON_SIZE);
+		break;
+	case WM_CLIP:
+		if (onScreen(vscr, x, y))
+			return;
+
+		wScreenKeepInside(vscr, &x, &y, ICON_SIZE, ICON_SIZE);
+		break;
+	default:
+		/* drawers follow the dock */
+		return;
+	}
+
+	if (x == dock->x_pos && y == dock->y_pos)
+		return;
+
+	moveDock(dock, x, y);
+
+	if (dock->type == WM_CLIP) {
+		for (i = 0; i < vscr->workspace.count; i++) {
+			if ((vscr->workspace.array[i]) && (vscr->workspace.array[i]->clip)) {
+				vscr->workspace.array[i]->clip->x_pos = x;
+				vscr->workspace.array[i]->clip->y_pos = y;
+			}
+		}
+	}
+}
+
 static void swapDock(WDock *dock)
 {
 	virtual_screen *vscr = dock->vscr;
@@ -1807,88 +1856,347 @@ WAppIcon *wDockFindIconForWindow(WDock *dock, Window window)
 	return NULL;
 }
 
-static int find_win_in_dock(WDock *dock, Window window, char *wm_class,
-			    char *wm_instance, char *command, Bool firstPass)
+/*
+ * Launch tracking.
+ *
+ * A newly mapped window is matched with the docked icon it belongs to by
+ * its instance and class. Application icons are indexed by those, and the
+ * icons that launched a process also by its pid, so finding the icons of a
+ * window is a probe into a small table rather than a comparison with every
+ * icon of the dock, the clips and the drawers. The pid of the window, and
+ * then its command, are only fetched when several icons of a dock remain.
+ */
+#define LAUNCH_CLASS_BUCKETS	64	/* power of 2 */
+#define LAUNCH_PID_BUCKETS	16
+
+static WAppIcon *launch_by_class[LAUNCH_CLASS_BUCKETS];
+static WAppIcon *launch_partial;	/* icons with only an instance or a class */
+static WAppIcon *launch_by_pid[LAUNCH_PID_BUCKETS];
+static int launch_pid_count;
+
+typedef struct {
+	Window window;
+	int have_class;			/* 0 until fetched, -1 when there is none */
+	char *wm_class;
+	char *wm_instance;
+	Bool own_class;			/* fetched here, and freed with the query */
+	int pid;			/* -1 until fetched */
+	Bool have_command;
+	char *command;
+} WLaunchQuery;
+
+static WAppIcon **launch_class_chain(const char *wm_instance, const char *wm_class)
+{
+	unsigned int hash = 2166136261U;
+	const char *p;
+
+	if (!wm_instance || !wm_class)
+		return &launch_partial;
+
+	/* FNV-1a over "instance.class" */
+	for (p = wm_instance; *p; p++)
+		hash = (hash ^ (unsigned char) *p) * 16777619U;
+	hash = (hash ^ '.') * 16777619U;
+	for (p = wm_class; *p; p++)
+		hash = (hash ^ (unsigned char) *p) * 16777619U;
+
+	return &launch_by_class[hash & (LAUNCH_CLASS_BUCKETS - 1)];
+}
+
+void wDockIndexIcon(WAppIcon *icon)
+{
+	WAppIcon **chain;
+
+	if (!icon->wm_instance && !icon->wm_class)
+		return;
+
+	chain = launch_class_chain(icon->wm_instance, icon->wm_class);
+	icon->class_next = *chain;
+	*chain = icon;
+}
+
+void wDockUnindexIcon(WAppIcon *icon)
+{
+	WAppIcon **chain;
+
+	chain = launch_class_chain(icon->wm_instance, icon->wm_class);
+	while (*chain && *chain != icon)
+		chain = &(*chain)->class_next;
+
+	if (*chain)
+		*chain = icon->class_next;
+
+	icon->class_next = NULL;
+	wDockSetLaunchPid(icon, 0);
+}
+
+void wDockSetLaunchPid(WAppIcon *icon, pid_t pid)
+{
+	WAppIcon **chain;
+
+	if (icon->pid > 0) {
+		chain = &launch_by_pid[icon->pid % LAUNCH_PID_BUCKETS];
+		while (*chain && *chain != icon)
+			chain = &(*chain)->pid_next;
+
+		if (*chain) {
+			*chain = icon->pid_next;
+			launch_pid_count--;
+		}
+		icon->pid_next = NULL;
+	}
+
+	icon->pid = pid;
+
+	if (pid > 0) {
+		chain = &launch_by_pid[pid % LAUNCH_PID_BUCKETS];
+		icon->pid_next = *chain;
+		*chain = icon;
+		launch_pid_count++;
+	}
+}
+
+static Bool launch_query_class(WLaunchQuery *query)
+{
+	WWindow *wwin;
+
+	if (query->have_class)
+		return query->have_class > 0;
+
+	/* managed windows already know their class */
+	wwin = wWindowFor(query->window);
+	if (wwin && wwin->wm_class && wwin->wm_instance) {
+		query->wm_class = wwin->wm_class;
+		query->wm_instance = wwin->wm_instance;
+		query->have_class = 1;
+		return True;
+	}
+
+	query->own_class = True;
+	if (PropGetWMClass(query->window, &query->wm_class, &query->wm_instance))
+		query->have_class = 1;
+	else
+		query->have_class = -1;
+
+	return query->have_class > 0;
+}
+
+static void launch_query_free(WLaunchQuery *query)
+{
+	if (query->own_class) {
+		if (query->wm_class)
+			wfree(query->wm_class);
+
+		if (query->wm_instance)
+			wfree(query->wm_instance);
+	}
+
+	if (query->command)
+		wfree(query->command);
+}
+
+static Bool launch_candidate(WAppIcon *icon, WDock *dock, WLaunchQuery *query)
+{
+	if (icon->dock != dock)
+		return False;
+
+	if (!icon->launching && icon->running)
+		return False;
+
+	if (icon->wm_instance && strcmp(icon->wm_instance, query->wm_instance) != 0)
+		return False;
+
+	if (icon->wm_class && strcmp(icon->wm_class, query->wm_class) != 0)
+		return False;
+
+	return True;
+}
+
+/* Pick between several icons of the dock that fit the window */
+static WAppIcon *launch_disambiguate(WDock *dock, WLaunchQuery *query, WAppIcon *first)
 {
 	WAppIcon *icon;
+	WAppIcon **chains[2];
 	int i;
 
-	for (i = 0; i < dock->max_icons; i++) {
-		icon = dock->icon_array[i];
-		if (!icon)
-			continue;
+	/* the icon that launched the process of the window */
+	if (launch_pid_count > 0) {
+		if (query->pid < 0)
+			query->pid = wNETWMGetPidForWindow(query->window);
 
-		/* app is already attached to icon */
-		if (icon->main_window == window)
-			return 1;
+		if (query->pid > 0) {
+			for (icon = launch_by_pid[query->pid % LAUNCH_PID_BUCKETS]; icon; icon = icon->pid_next)
+				if (icon->pid == query->pid && launch_candidate(icon, dock, query))
+					return icon;
+		}
+	}
 
-		if (!icon->wm_instance && !icon->wm_class)
-			continue;
+	/* or the one with the same command */
+	if (!query->have_command) {
+		query->command = GetCommandForWindow(query->window);
+		query->have_command = True;
+	}
 
-		if (!icon->launching && icon->running)
-			continue;
+	if (!query->command)
+		return first;
 
-		if (icon->wm_instance && wm_instance && strcmp(icon->wm_instance, wm_instance) != 0)
-			continue;
+	chains[0] = launch_class_chain(query->wm_instance, query->wm_class);
+	chains[1] = &launch_partial;
+	for (i = 0; i < 2; i++) {
+		for (icon = *chains[i]; icon; icon = icon->class_next)
+			if (launch_candidate(icon, dock, query) &&
+			    icon->command && strcmp(icon->command, query->command) == 0)
+				return icon;
+	}
 
-		if (icon->wm_class && wm_class && strcmp(icon->wm_class, wm_class) != 0)
-			continue;
+	return first;
+}
 
-		if (firstPass && command && strcmp(icon->command, command) != 0)
-			continue;
+static int track_launch_in_dock(WDock *dock, WLaunchQuery *query)
+{
+	WAppIcon *icon, *found = NULL;
+	WAppIcon **chains[2];
+	int i, count = 0;
+
+	chains[0] = launch_class_chain(query->wm_instance, query->wm_class);
+	chains[1] = &launch_partial;
+	for (i = 0; i < 2; i++) {
+		for (icon = *chains[i]; icon; icon = icon->class_next) {
+			if (!launch_candidate(icon, dock, query))
+				continue;
+
+			if (!found)
+				found = icon;
+			count++;
+		}
+	}
 
-		if (!icon->relaunching) {
-			WApplication *wapp;
+	if (!found)
+		return 0;
 
-			/* Possibly an application that was docked with dockit,
-			 * but the user did not update WMState to indicate that
-			 * it was docked by force */
-			wapp = wApplicationOf(window);
-			if (!wapp) {
-				icon->forced_dock = 1;
-				icon->running = 0;
-			}
+	if (count > 1)
+		found = launch_disambiguate(dock, query, found);
 
-			if (!icon->forced_dock)
-				icon->main_window = window;
-		}
+	icon = found;
+	if (!icon->relaunching) {
+		WApplication *wapp;
 
-		if (!wPreferences.no_animations && !icon->launching &&
-		    !w_global.startup.phase1 && !dock->collapsed)
-			move_appicon_to_dock(dock->vscr, icon, wm_class, wm_instance);
+		/* Possibly an application that was docked with dockit,
+		 * but the user did not update WMState to indicate that
+		 * it was docked by force */
+		wapp = wApplicationOf(query->window);
+		if (!wapp) {
+			icon->forced_dock = 1;
+			icon->running = 0;
+		}
 
-		wDockFinishLaunch(icon);
-		return 1;
+		if (!icon->forced_dock)
+			icon->main_window = query->window;
 	}
 
-	return 0;
+	if (!wPreferences.no_animations && !icon->launching &&
+	    !w_global.startup.phase1 && !dock->collapsed)
+		move_appicon_to_dock(dock->vscr, icon, query->wm_class, query->wm_instance);
+
+	wDockFinishLaunch(icon);
+	return 1;
 }
 
 void wDockTrackWindowLaunch(WDock *dock, Window window)
 {
-	char *wm_class, *wm_instance, *command = NULL;
-	Bool found = False;
+	WLaunchQuery query;
 
-	if (!PropGetWMClass(window, &wm_class, &wm_instance)) {
-		wfree(wm_class);
-		wfree(wm_instance);
+	/* app is already attached to icon */
+	if (wDockFindIconForWindow(dock, window))
 		return;
+
+	memset(&query, 0, sizeof(query));
+	query.window = window;
+	query.pid = -1;
+
+	if (launch_query_class(&query))
+		track_launch_in_dock(dock, &query);
+
+	launch_query_free(&query);
+}
+
+static WAppIcon *find_launched_icon(WDock *dock, WLaunchQuery *query)
+{
+	WAppIcon *icon;
+
+	icon = wDockFindIconForWindow(dock, query->window);
+	if (!icon && launch_query_class(query) && track_launch_in_dock(dock, query))
+		icon = wDockFindIconForWindow(dock, query->window);
+
+	return icon;
+}
+
+/*
+ * Find the docked icon of a window, attaching it if the window was just
+ * launched. The last dock used goes first, then the dock, the clips and
+ * the drawers.
+ */
+WAppIcon *wDockFindLaunchedIcon(virtual_screen *vscr, Window window)
+{
+	WLaunchQuery query;
+	WAppIcon *icon = NULL;
+	WDrawerChain *dc;
+	int i;
+
+	memset(&query, 0, sizeof(query));
+	query.window = window;
+	query.pid = -1;
+
+	if (vscr->last_dock)
+		icon = find_launched_icon(vscr->last_dock, &query);
+
+	/* check main dock if we did not find it in last dock */
+	if (!icon && vscr->dock.dock)
+		icon = find_launched_icon(vscr->dock.dock, &query);
+
+	/* check clips */
+	for (i = 0; !icon && i < vscr->workspace.count; i++) {
+		WDock *dock = vscr->workspace.array[i]->clip;
+
+		if (dock)
+			icon = find_launched_icon(dock, &query);
 	}
 
-	command = GetCommandForWindow(window);
+	/* Finally check drawers */
+	for (dc = vscr->drawer.drawers; !icon && dc != NULL; dc = dc->next)
+		icon = find_launched_icon(dc->adrawer, &query);
 
-	found = find_win_in_dock(dock, window, wm_class, wm_instance, command, True);
-	if (!found)
-		find_win_in_dock(dock, window, wm_class, wm_instance, command, False);
+	launch_query_free(&query);
+
+	return icon;
+}
+
+/* The icon of the dock for exactly that instance, class and command */
+WAppIcon *wDockFindIconForCommand(WDock *dock, const char *wm_instance, const char *wm_class,
+				  const char *command)
+{
+	WAppIcon *icon;
 
-	if (command)
-		wfree(command);
+	if (!wm_instance && !wm_class)
+		return NULL;
 
-	if (wm_class)
-		wfree(wm_class);
+	for (icon = *launch_class_chain(wm_instance, wm_class); icon; icon = icon->class_next) {
+		if (icon->dock != dock || icon->launching)
+			continue;
 
-	if (wm_instance)
-		wfree(wm_instance);
+		if (!wm_instance != !icon->wm_instance || !wm_class != !icon->wm_class ||
+		    !command != !icon->command)
+			continue;
+
+		if ((wm_instance && strcmp(wm_instance, icon->wm_instance) != 0) ||
+		    (wm_class && strcmp(wm_class, icon->wm_class) != 0) ||
+		    (command && strcmp(command, icon->command) != 0))
+			continue;
+
+		return icon;
+	}
+
+	return NULL;
 }
 
 static void trackDeadProcess(pid_t pid, unsigned int status, WDock *client_data)
@@ -1909,7 +2217,7 @@ static void trackDeadProcess(pid_t pid, unsigned int status, WDock *client_data)
 			}
 
 			wDockFinishLaunch(icon);
-			icon->pid = 0;
+			wDockSetLaunchPid(icon, 0);
 			if (status == 111) {
 				char msg[PATH_MAX];
 				char *cmd;
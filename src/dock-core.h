@@ -64,12 +64,19 @@ Bool wDockFindFreeSlot(WDock *dock, int *req_x, int *req_y);
 void wDockDetach(WDock *dock, WAppIcon *icon);
 Bool wDockMoveIconBetweenDocks(WDock *src, WDock *dest, WAppIcon *icon, int x, int y);
 void wDockReattachIcon(WDock *dock, WAppIcon *icon, int x, int y);
+void wDockKeepOnScreen(WDock *dock);
 
 void wSlideAppicons(WAppIcon **appicons, int n, int to_the_left);
 
 void wDockFinishLaunch(WAppIcon *icon);
 void wDockTrackWindowLaunch(WDock *dock, Window window);
 WAppIcon *wDockFindIconForWindow(WDock *dock, Window window);
+WAppIcon *wDockFindLaunchedIcon(virtual_screen *vscr, Window window);
+WAppIcon *wDockFindIconForCommand(WDock *dock, const char *wm_instance, const char *wm_class,
+				  const char *command);
+void wDockIndexIcon(WAppIcon *icon);
+void wDockUnindexIcon(WAppIcon *icon);
+void wDockSetLaunchPid(WAppIcon *icon, pid_t pid);
 void wDockLaunchWithState(WAppIcon *btn, WSavedState *state);
 
 void dockedapps_autolaunch(int vscrno);
@@ -41,6 +41,11 @@
 #include <X11/XKBlib.h>
 #endif				/* KEEP_XKB_LOCK_STATUS */
 
+#ifdef USE_POINTER_BARRIERS
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/XInput2.h>
+#endif
+
 #include "WindowMaker.h"
 #include "window.h"
 #include "actions.h"
@@ -70,6 +75,7 @@
 #include "winmenu.h"
 #include "switchmenu.h"
 #include "wsmap.h"
+#include "stats.h"
 
 /************ Local stuff ***********/
 static void saveTimestamp(XEvent *event);
@@ -89,6 +95,9 @@ static void handleClientMessage(XEvent *event);
 static void handleKeyPress(XEvent *event);
 static void handleFocusIn(XEvent *event);
 static void handleMotionNotify(XEvent *event);
+#ifdef USE_POINTER_BARRIERS
+static void handleBarrierEvent(XEvent *event);
+#endif
 static void handleVisibilityNotify(XEvent *event);
 static void handle_inotify_events(void);
 static void handle_selection_request(XSelectionRequestEvent *event);
@@ -157,6 +166,8 @@ static void wdelete_death_handler(WMagicNumber id)
 
 void DispatchEvent(XEvent *event)
 {
+	WStatsMark mark;
+
 	if (deathHandlers)
 		handleDeadProcess();
 
@@ -186,6 +197,8 @@ void DispatchEvent(XEvent *event)
 	if (!event)
 		return;
 
+	wStatsMarkStart(&mark);
+
 	saveTimestamp(event);
 	switch (event->type) {
 	case MapRequest:
@@ -276,6 +289,8 @@ void DispatchEvent(XEvent *event)
 		handleExtensions(event);
 		break;
 	}
+
+	wStatsEventEnd(event, &mark);
 }
 
 #ifdef HAVE_INOTIFY
@@ -582,15 +597,28 @@ static void handleExtensions(XEvent *event)
 		handleXkbIndicatorStateNotify((XkbEvent *) event);
 	}
 #endif				/*KEEP_XKB_LOCK_STATUS */
+#ifdef USE_POINTER_BARRIERS
+	if (w_global.xext.barrier.supported && event->type == GenericEvent
+	    && event->xcookie.extension == w_global.xext.barrier.xi_opcode) {
+		handleBarrierEvent(event);
+	}
+#endif
 #ifdef USE_RANDR
 	if (w_global.xext.randr.supported && event->type == (w_global.xext.randr.event_base + RRScreenChangeNotify)) {
+		virtual_screen *vscr;
+
 		/* From xrandr man page: "Clients must call back into Xlib using
 		 * XRRUpdateConfiguration when screen configuration change notify
 		 * events are generated */
 		XRRUpdateConfiguration(event);
-		WCHANGE_STATE(WSTATE_RESTARTING);
-		Shutdown(WSRestartPreparationMode);
-		Restart(NULL,True);
+
+		/* a hotplug usually comes as a burst of notifies, handle the last one */
+		while (XCheckTypedEvent(dpy, event->type, event))
+			XRRUpdateConfiguration(event);
+
+		vscr = wScreenForRootWindow(((XRRScreenChangeNotifyEvent *) event)->root);
+		if (vscr)
+			wScreenUpdateHeads(vscr);
 	}
 #endif
 }
@@ -600,6 +628,7 @@ static void handleMapRequest(XEvent *ev)
 	WWindow *wwin;
 	virtual_screen *vscr = NULL;
 	Window window = ev->xmaprequest.window;
+	WStatsMark mark;
 
 	wwin = wWindowFor(window);
 	if (wwin != NULL) {
@@ -621,7 +650,9 @@ static void handleMapRequest(XEvent *ev)
 	}
 
 	vscr = wScreenForRootWindow(ev->xmaprequest.parent);
+	wStatsMarkStart(&mark);
 	wwin = wManageWindow(vscr, window);
+	wStatsSpanEnd(WSPAN_MANAGE_WINDOW, &mark);
 
 	/*
 	 * This is to let the Dock know that the application it launched
@@ -703,12 +734,10 @@ static void handleDestroyNotify(XEvent *event)
 	if (app) {
 		if (window == app->main_window) {
 			app->refcount = 0;
-			wwin = app->main_window_desc->vscr->window.focused;
-			while (wwin) {
-				if (wwin->main_window == window)
-					wwin->main_window = None;
-
-				wwin = wwin->prev;
+			while (app->windows) {
+				wwin = app->windows;
+				wwin->main_window = None;
+				wApplicationRemoveWindow(wwin);
 			}
 		}
 		wApplicationDestroy(app);
@@ -1007,6 +1036,10 @@ static void handleClientMessage(XEvent *event)
 		if (strncmp(command, "Reconfigure", sizeof("Reconfigure")) == 0) {
 			wwarning(_("Got Reconfigure command"));
 			wDefaultsCheckDomains(NULL);
+		} else if (strncmp(command, "DumpStats", sizeof("DumpStats")) == 0) {
+			wStatsDump();
+		} else if (strncmp(command, "ResetStats", sizeof("ResetStats")) == 0) {
+			wStatsReset();
 		} else {
 			wwarning(_("Got unknown command %s"), command);
 		}
@@ -2177,10 +2210,34 @@ static inline int get_corner(WMRect rect, WMPoint p)
 	return CORNER_NONE;
 }
 
+#ifdef USE_POINTER_BARRIERS
+static Bool pointerInHotCorner(WScreen *scr, int corner)
+{
+	Window junk_win;
+	int junk, x, y;
+	unsigned int mask;
+	WMPoint p;
+
+	if (!XQueryPointer(dpy, scr->root_win, &junk_win, &junk_win, &x, &y, &junk, &junk, &mask))
+		return False;
+
+	p = wmkpoint(x, y);
+
+	return get_corner(wGetRectForHead(scr, wGetHeadForPoint(scr->vscr, p)), p) == corner;
+}
+#endif
+
 static void hotCornerDelay(void *data)
 {
 	WScreen *scr = (WScreen *) data;
 
+#ifdef USE_POINTER_BARRIERS
+	/* Barriers do not tell when the pointer leaves without pushing on them */
+	if (scr->hot_corner_barriers && scr->flags.in_hot_corner
+	    && !pointerInHotCorner(scr, scr->flags.in_hot_corner))
+		scr->flags.in_hot_corner = CORNER_NONE;
+#endif
+
 	if (scr->flags.in_hot_corner && wPreferences.hot_corner_actions[scr->flags.in_hot_corner - 1])
 		ExecuteShellCommand(scr->vscr, wPreferences.hot_corner_actions[scr->flags.in_hot_corner - 1]);
 	WMDeleteTimerHandler(scr->hot_corner_timer);
@@ -2200,7 +2257,11 @@ static void handleMotionNotify(XEvent *event)
 	p = wmkpoint(event->xmotion.x_root, event->xmotion.y_root);
 	rect = wGetRectForHead(vscr->screen_ptr, wGetHeadForPoint(vscr, p));
 
+#ifdef USE_POINTER_BARRIERS
+	if (wPreferences.hot_corners && !vscr->screen_ptr->hot_corner_barriers) {
+#else
 	if (wPreferences.hot_corners) {
+#endif
 		if (!vscr->screen_ptr->flags.in_hot_corner) {
 			vscr->screen_ptr->flags.in_hot_corner = get_corner(rect, p);
 			if (vscr->screen_ptr->flags.in_hot_corner && !vscr->screen_ptr->hot_corner_timer)
@@ -2256,6 +2317,182 @@ static void handleMotionNotify(XEvent *event)
 	}
 }
 
+#ifdef USE_POINTER_BARRIERS
+/* A point just outside the head, is it on another head? */
+static Bool pointOnAnyHead(WScreen *scr, int x, int y)
+{
+	WMRect rect;
+	int i;
+
+	for (i = 0; i < wXineramaHeads(scr); i++) {
+		rect = wGetRectForHead(scr, i);
+		if (x >= rect.pos.x && x < rect.pos.x + rect.size.width
+		    && y >= rect.pos.y && y < rect.pos.y + rect.size.height)
+			return True;
+	}
+
+	return False;
+}
+
+static void destroyHotCornerBarriers(WScreen *scr)
+{
+	int i;
+
+	for (i = 0; i < scr->hot_corner_barrier_count; i++)
+		if (scr->hot_corner_barriers[i] != None)
+			XFixesDestroyPointerBarrier(dpy, scr->hot_corner_barriers[i]);
+
+	wfree(scr->hot_corner_barriers);
+	scr->hot_corner_barriers = NULL;
+	scr->hot_corner_barrier_count = 0;
+}
+
+/*
+ * Put two short barriers in each corner of each head, along the edges, which
+ * stop the pointer from going out of the screen. Pushing the pointer into a
+ * corner then makes the server send a barrier event, while the pointer moving
+ * around normally sends nothing at all.
+ * Edges shared with another head get no barrier, as it would keep the pointer
+ * from going over there, so the corners along them do not work.
+ */
+static void createHotCornerBarriers(WScreen *scr)
+{
+	unsigned char mask_bits[XIMaskLen(XI_LASTEVENT)] = { 0 };
+	XIEventMask mask;
+	XID *barrier;
+	WMRect rect;
+	int head, count, len, x1, y1, x2, y2;
+
+	count = wXineramaHeads(scr) * 8;
+	scr->hot_corner_barriers = wmalloc(sizeof(XID) * count);
+	scr->hot_corner_barrier_count = count;
+
+	/* the same area as get_corner() */
+	len = wPreferences.hot_corner_edge + 1;
+
+	for (head = 0; head < wXineramaHeads(scr); head++) {
+		rect = wGetRectForHead(scr, head);
+		x1 = rect.pos.x;
+		y1 = rect.pos.y;
+		x2 = rect.pos.x + rect.size.width;
+		y2 = rect.pos.y + rect.size.height;
+		barrier = &scr->hot_corner_barriers[head * 8];
+
+#define BARRIER(i, bx1, by1, bx2, by2, dir, outside_x, outside_y) \
+		if (!pointOnAnyHead(scr, outside_x, outside_y)) \
+			barrier[i] = XFixesCreatePointerBarrier(dpy, scr->root_win, bx1, by1, bx2, by2, dir, 0, NULL)
+
+		/* in the CORNER_* order, the vertical barrier first */
+		BARRIER(0, x1, y1, x1, y1 + len, BarrierPositiveX, x1 - 1, y1);
+		BARRIER(1, x1, y1, x1 + len, y1, BarrierPositiveY, x1, y1 - 1);
+		BARRIER(2, x2, y1, x2, y1 + len, BarrierNegativeX, x2, y1);
+		BARRIER(3, x2 - len, y1, x2, y1, BarrierPositiveY, x2 - 1, y1 - 1);
+		BARRIER(4, x1, y2 - len, x1, y2, BarrierPositiveX, x1 - 1, y2 - 1);
+		BARRIER(5, x1, y2, x1 + len, y2, BarrierNegativeY, x1, y2);
+		BARRIER(6, x2, y2 - len, x2, y2, BarrierNegativeX, x2, y2 - 1);
+		BARRIER(7, x2 - len, y2, x2, y2, BarrierNegativeY, x2 - 1, y2);
+
+#undef BARRIER
+	}
+
+	XISetMask(mask_bits, XI_BarrierHit);
+	XISetMask(mask_bits, XI_BarrierLeave);
+	mask.deviceid = XIAllMasterDevices;
+	mask.mask_len = sizeof(mask_bits);
+	mask.mask = mask_bits;
+	XISelectEvents(dpy, scr->root_win, &mask, 1);
+}
+
+static void handleBarrierEvent(XEvent *event)
+{
+	XIBarrierEvent *bev;
+	virtual_screen *vscr;
+	WScreen *scr;
+	WMPoint p;
+	int i, corner = CORNER_NONE;
+
+	if (!XGetEventData(dpy, &event->xcookie))
+		return;
+
+	bev = (XIBarrierEvent *) event->xcookie.data;
+	vscr = wScreenForRootWindow(bev->root);
+	if (!vscr || (bev->evtype != XI_BarrierHit && bev->evtype != XI_BarrierLeave)) {
+		XFreeEventData(dpy, &event->xcookie);
+		return;
+	}
+
+	scr = vscr->screen_ptr;
+	for (i = 0; i < scr->hot_corner_barrier_count; i++)
+		if (scr->hot_corner_barriers[i] == bev->barrier)
+			corner = (i % 8) / 2 + 1;
+
+	if (corner == CORNER_NONE) {
+		XFreeEventData(dpy, &event->xcookie);
+		return;
+	}
+
+	if (bev->evtype == XI_BarrierHit) {
+		/* nothing new when pushing on the corner we are already in */
+		if (scr->flags.in_hot_corner != corner) {
+			if (scr->hot_corner_timer)
+				WMDeleteTimerHandler(scr->hot_corner_timer);
+			scr->flags.in_hot_corner = corner;
+			scr->hot_corner_timer = WMAddTimerHandler(wPreferences.hot_corner_delay, hotCornerDelay, scr);
+		}
+	} else if (scr->flags.in_hot_corner == corner) {
+		p = wmkpoint(bev->root_x, bev->root_y);
+
+		/*
+		 * Going away from the corner cancels it, and once it has
+		 * triggered, pushing on it again triggers it again
+		 */
+		if (!scr->hot_corner_timer
+		    || get_corner(wGetRectForHead(scr, wGetHeadForPoint(vscr, p)), p) != corner) {
+			scr->flags.in_hot_corner = CORNER_NONE;
+			if (scr->hot_corner_timer) {
+				WMDeleteTimerHandler(scr->hot_corner_timer);
+				scr->hot_corner_timer = NULL;
+			}
+		}
+	}
+
+	XFreeEventData(dpy, &event->xcookie);
+}
+#endif
+
+/*
+ * Set up the hot corners after a change of the preferences or of the heads.
+ * With pointer barriers, the root window does not need the pointer motion
+ * for them.
+ */
+void wHotCornersUpdate(WScreen *scr)
+{
+#ifdef USE_POINTER_BARRIERS
+	Bool motion = wPreferences.scrollable_menus || wPreferences.hot_corners;
+
+	if (scr->hot_corner_barriers)
+		destroyHotCornerBarriers(scr);
+
+	if (wPreferences.hot_corners && w_global.xext.barrier.supported) {
+		createHotCornerBarriers(scr);
+		motion = wPreferences.scrollable_menus;
+	}
+#endif
+
+	if (!wPreferences.hot_corners) {
+		scr->flags.in_hot_corner = CORNER_NONE;
+		if (scr->hot_corner_timer) {
+			WMDeleteTimerHandler(scr->hot_corner_timer);
+			scr->hot_corner_timer = NULL;
+		}
+	}
+
+#ifdef USE_POINTER_BARRIERS
+	/* without the barriers, the root window keeps the pointer motion it always had */
+	wScreenSetPointerMotion(scr, motion);
+#endif
+}
+
 static void handleVisibilityNotify(XEvent *event)
 {
 	WWindow *wwin;
@@ -24,6 +24,7 @@ void DispatchEvent(XEvent *event);
 void ProcessPendingEvents(void);
 WMagicNumber wAddDeathHandler(pid_t pid, WDeathHandler *callback, void *cdata);
 Bool IsDoubleClick(virtual_screen *vscr, XEvent *event);
+void wHotCornersUpdate(WScreen *scr);
 
 /* called from the signal handler */
 void NotifyDeadProcess(pid_t pid, unsigned char status);
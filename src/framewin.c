@@ -16,6 +16,11 @@
 #include <X11/XKBlib.h>
 #endif				/* KEEP_XKB_LOCK_STATUS */
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -29,6 +34,8 @@
 #include "window.h"
 #include "framewin.h"
 #include "stacking.h"
+#include "pool.h"
+#include "stats.h"
 #include "misc.h"
 #include "event.h"
 
@@ -71,6 +78,87 @@ static void resizebar_unmap(WFrameWindow *fwin);
 static int get_framewin_height(WFrameWindow *fwin, int flags);
 static int get_framewin_titleheight(WFrameWindow *fwin);
 static int get_framewin_btn_size(int titleheight);
+/* part of the titlebar, cut like RGetSubImage() does */
+static Pixmap titlebarPart(WScreen *scr, Pixmap full, int full_width, int full_height,
+			   int x, int y, int width, int height, int *part_width)
+{
+	Pixmap part;
+
+	if (x + width > full_width)
+		width = full_width - x;
+	if (y + height > full_height)
+		height = full_height - y;
+
+	*part_width = 0;
+	if (width <= 0 || height <= 0)
+		return None;
+
+	part = wTextureCopyPixmap(scr, full, x, y, width, height);
+	wTextureBevelPixmap(scr, part, width, height, WREL_RAISED);
+	*part_width = width;
+
+	return part;
+}
+
+/* The same as renderTexture(), drawn by the server */
+static Bool renderServerTexture(WScreen *scr, WTexture *texture,
+				int width, int height,
+				int bwidth, int bheight,
+				Pixmap *title,
+				int left, Pixmap *lbutton,
+#ifdef XKB_BUTTON_HINT
+				int language, Pixmap *languagebutton,
+#endif
+				int right, Pixmap *rbutton)
+{
+	Pixmap full;
+	int x = 0, w = width, pw;
+
+	if (wPreferences.new_style != TS_NEW) {
+		*title = wTextureRenderPixmap(scr, texture, width, height, WREL_RAISED);
+		if (*title == None)
+			return False;
+
+		wStatsDecorationSent(WDECO_XRENDER, 1, 0);
+		return True;
+	}
+
+	full = wTextureRenderPixmap(scr, texture, width, height, WREL_FLAT);
+	if (full == None)
+		return False;
+
+	if (left) {
+		*lbutton = titlebarPart(scr, full, width, height, 0, 0, bwidth, bheight, &pw);
+		x += pw;
+		w -= pw;
+	}
+
+#ifdef XKB_BUTTON_HINT
+	if (language) {
+		*languagebutton = titlebarPart(scr, full, width, height, bwidth * left, 0, bwidth, bheight, &pw);
+		x += pw;
+		w -= pw;
+	}
+#endif
+
+	if (right) {
+		*rbutton = titlebarPart(scr, full, width, height, width - bwidth, 0, bwidth, bheight, &pw);
+		w -= pw;
+	}
+
+	if (w != width) {
+		*title = titlebarPart(scr, full, width, height, x, 0, w, height, &pw);
+		XFreePixmap(dpy, full);
+	} else {
+		wTextureBevelPixmap(scr, full, width, height, WREL_RAISED);
+		*title = full;
+	}
+
+	wStatsDecorationSent(WDECO_XRENDER, 1, 0);
+
+	return True;
+}
+
 static void renderTexture(WScreen *scr, WTexture *texture,
 			 int width, int height,
 			 int bwidth, int bheight,
@@ -85,6 +173,7 @@ static void renderResizebarTexture(WScreen *scr, WTexture *texture,
 				   Pixmap *pmap);
 static void updateTexture_titlebar(WFrameWindow *fwin);
 static void updateTexture_resizebar(WFrameWindow *fwin);
+static void unqueue_frame(WFrameWindow *fwin);
 static void remakeTexture_titlebar(WFrameWindow *fwin, int state);
 static void remakeTexture_resizebar(WFrameWindow *fwin, int state);
 static char *get_title(WFrameWindow *fwin);
@@ -137,7 +226,7 @@ WFrameWindow *wframewindow_create(WWindow *parent_wwin, WMenu *parent_wmenu,
 {
 	WFrameWindow *fwin;
 
-	fwin = wmalloc(sizeof(WFrameWindow));
+	fwin = wPoolAlloc(&wFrameWindowPool);
 	fwin->width = width;
 	fwin->height = height;
 	fwin->core = wcore_create();
@@ -190,7 +279,7 @@ void wframewindow_map(WFrameWindow *fwin, virtual_screen *vscr, int wlevel,
 			   fwin->colormap, scr->frame_border_pixel);
 
 	/* setup stacking information */
-	wcore->stacking = wmalloc(sizeof(WStacking));
+	wcore->stacking = wPoolAlloc(&wStackingPool);
 	wcore->stacking->above = NULL;
 	wcore->stacking->under = NULL;
 	wcore->stacking->child_of = NULL;
@@ -832,11 +921,14 @@ void framewindow_unmap(WFrameWindow *fwin)
 
 void wFrameWindowDestroy(WFrameWindow *fwin)
 {
+	if (fwin->flags.remake_queued)
+		unqueue_frame(fwin);
+
 	titlebar_destroy(fwin);
 	resizebar_destroy(fwin);
 
 	if (fwin->core && fwin->core->stacking) {
-		wfree(fwin->core->stacking);
+		wPoolFree(&wStackingPool, fwin->core->stacking);
 		fwin->core->stacking = NULL;
 	}
 
@@ -846,7 +938,13 @@ void wFrameWindowDestroy(WFrameWindow *fwin)
 
 	destroy_framewin_buttons(fwin);
 
-	wfree(fwin);
+	if (fwin->shrunk_title.font) {
+		WMReleaseFont(fwin->shrunk_title.font);
+		wfree(fwin->shrunk_title.title);
+		wfree(fwin->shrunk_title.text);
+	}
+
+	wPoolFree(&wFrameWindowPool, fwin);
 }
 
 void wFrameWindowChangeState(WFrameWindow *fwin, int state)
@@ -896,6 +994,95 @@ void wframewindow_refresh_titlebar(WFrameWindow *fwin)
 	}
 }
 
+/* The parts of a titlebar */
+enum {
+	TB_TITLE,
+	TB_LEFT,
+	TB_LANGUAGE,
+	TB_RIGHT,
+	TB_PARTS
+};
+
+/*
+ * Render the images of the parts of a titlebar. It does not talk to the
+ * server, nor touch anything but the images, so that the render workers
+ * can run it.
+ */
+static Bool renderTextureImages(WTexture *texture, int width, int height,
+				int bwidth, int bheight,
+				int left, int language, int right,
+				RImage *parts[TB_PARTS])
+{
+	RImage *img;
+	int i, x = 0, w;
+
+	for (i = 0; i < TB_PARTS; i++)
+		parts[i] = NULL;
+
+	img = wTextureRenderImageNoStats(texture, width, height, WREL_FLAT);
+	if (!img)
+		return False;
+
+	if (wPreferences.new_style != TS_NEW) {
+		RBevelImage(img, RBEV_RAISED2);
+		parts[TB_TITLE] = img;
+		return True;
+	}
+
+	w = img->width;
+
+	if (left)
+		parts[TB_LEFT] = RGetSubImage(img, 0, 0, bwidth, bheight);
+
+	if (language)
+		parts[TB_LANGUAGE] = RGetSubImage(img, bwidth * left, 0, bwidth, bheight);
+
+	if (right)
+		parts[TB_RIGHT] = RGetSubImage(img, width - bwidth, 0, bwidth, bheight);
+
+	for (i = TB_LEFT; i < TB_PARTS; i++) {
+		if (!parts[i])
+			continue;
+
+		RBevelImage(parts[i], RBEV_RAISED2);
+		if (i != TB_RIGHT)
+			x += parts[i]->width;
+		w -= parts[i]->width;
+	}
+
+	if (w != width) {
+		parts[TB_TITLE] = RGetSubImage(img, x, 0, w, img->height);
+		RReleaseImage(img);
+		img = parts[TB_TITLE];
+		if (!img)
+			return True;
+	} else {
+		parts[TB_TITLE] = img;
+	}
+
+	RBevelImage(img, RBEV_RAISED2);
+
+	return True;
+}
+
+/* Convert and release the images of renderTextureImages() */
+static void convertTextureImages(WScreen *scr, RImage *parts[TB_PARTS], Pixmap pixmaps[TB_PARTS])
+{
+	int i;
+
+	for (i = 0; i < TB_PARTS; i++) {
+		pixmaps[i] = None;
+		if (!parts[i])
+			continue;
+
+		if (!wTextureConvertImage(scr, parts[i], &pixmaps[i]))
+			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
+
+		RReleaseImage(parts[i]);
+		parts[i] = NULL;
+	}
+}
+
 static void renderTexture(WScreen *scr, WTexture *texture,
 			 int width, int height,
 			 int bwidth, int bheight,
@@ -906,11 +1093,13 @@ static void renderTexture(WScreen *scr, WTexture *texture,
 #endif
 			 int right, Pixmap *rbutton)
 {
-	RImage *img, *limg = NULL, *rimg = NULL, *mimg;
-#ifdef XKB_BUTTON_HINT
-	RImage *timg = NULL;
+	RImage *parts[TB_PARTS];
+	Pixmap pixmaps[TB_PARTS];
+	WStatsMark mark;
+	Bool done;
+#ifndef XKB_BUTTON_HINT
+	int language = 0;
 #endif
-	int x = 0, w;
 
 	*title = None;
 	*lbutton = None;
@@ -919,99 +1108,45 @@ static void renderTexture(WScreen *scr, WTexture *texture,
 	*languagebutton = None;
 #endif
 
-	img = wTextureRenderImage(texture, width, height, WREL_FLAT);
-	if (!img) {
-		wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
+	if (renderServerTexture(scr, texture, width, height, bwidth, bheight, title,
+				left, lbutton,
+#ifdef XKB_BUTTON_HINT
+				language, languagebutton,
+#endif
+				right, rbutton))
 		return;
-	}
 
-	if (wPreferences.new_style != TS_NEW) {
-		RBevelImage(img, RBEV_RAISED2);
-
-		if (!RConvertImage(scr->rcontext, img, title))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
+	wStatsMarkStart(&mark);
+	done = renderTextureImages(texture, width, height, bwidth, bheight, left, language, right, parts);
+	wStatsSpanEnd(WSPAN_TEXTURE_RENDER, &mark);
 
-		RReleaseImage(img);
+	if (!done) {
+		wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
 		return;
 	}
 
-	if (left)
-		limg = RGetSubImage(img, 0, 0, bwidth, bheight);
+	wStatsDecorationSent(WDECO_IMAGE, 1, 0);
 
-	w = img->width;
+	convertTextureImages(scr, parts, pixmaps);
 
+	*title = pixmaps[TB_TITLE];
+	*lbutton = pixmaps[TB_LEFT];
+	*rbutton = pixmaps[TB_RIGHT];
 #ifdef XKB_BUTTON_HINT
-	if (language)
-		timg = RGetSubImage(img, bwidth * left, 0, bwidth, bheight);
+	*languagebutton = pixmaps[TB_LANGUAGE];
 #endif
-
-	if (limg) {
-		RBevelImage(limg, RBEV_RAISED2);
-		if (!RConvertImage(scr->rcontext, limg, lbutton))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-
-		x += limg->width;
-		w -= limg->width;
-		RReleaseImage(limg);
-	}
-
-#ifdef XKB_BUTTON_HINT
-	if (timg) {
-		RBevelImage(timg, RBEV_RAISED2);
-		if (!RConvertImage(scr->rcontext, timg, languagebutton))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-
-		x += timg->width;
-		w -= timg->width;
-		RReleaseImage(timg);
-	}
-#endif
-
-	if (right)
-		rimg = RGetSubImage(img, width - bwidth, 0, bwidth, bheight);
-
-	if (rimg) {
-		RBevelImage(rimg, RBEV_RAISED2);
-		if (!RConvertImage(scr->rcontext, rimg, rbutton))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-
-		w -= rimg->width;
-		RReleaseImage(rimg);
-	}
-
-	if (w != width) {
-		mimg = RGetSubImage(img, x, 0, w, img->height);
-		RBevelImage(mimg, RBEV_RAISED2);
-
-		if (!RConvertImage(scr->rcontext, mimg, title))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-
-		RReleaseImage(mimg);
-	} else {
-		RBevelImage(img, RBEV_RAISED2);
-
-		if (!RConvertImage(scr->rcontext, img, title))
-			wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
-	}
-
-	RReleaseImage(img);
 }
 
-static void renderResizebarTexture(WScreen *scr, WTexture *texture,
-				   int width, int height, int cwidth,
-				   Pixmap *pmap)
+/* Render the image of a resizebar, like renderTextureImages() for the titlebar */
+static RImage *renderResizebarImage(WTexture *texture, int width, int height, int cwidth)
 {
 	RImage *img;
 	RColor light;
 	RColor dark;
 
-	*pmap = None;
-
-	img = wTextureRenderImage(texture, width, height, WREL_FLAT);
-	if (!img) {
-		wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
-		return;
-	}
+	img = wTextureRenderImageNoStats(texture, width, height, WREL_FLAT);
+	if (!img)
+		return NULL;
 
 	light.alpha = 0;
 	light.red = light.green = light.blue = 80;
@@ -1036,12 +1171,424 @@ static void renderResizebarTexture(WScreen *scr, WTexture *texture,
 	ROperateLine(img, RSubtractOperation, 0, height - 1, width - 1, height - 1, &dark);
 #endif				/* SHADOW_RESIZEBAR */
 
-	if (!RConvertImage(scr->rcontext, img, pmap))
+	return img;
+}
+
+static void renderResizebarTexture(WScreen *scr, WTexture *texture,
+				   int width, int height, int cwidth,
+				   Pixmap *pmap)
+{
+	RImage *img;
+	WStatsMark mark;
+
+	*pmap = wTextureRenderPixmap(scr, texture, width, height, WREL_FLAT);
+	if (*pmap != None) {
+		wTextureShadeLine(scr, *pmap, -40, 0, 0, width - 1, 0);
+		wTextureShadeLine(scr, *pmap, 80, 0, 1, width - 1, 1);
+
+		wTextureShadeLine(scr, *pmap, -40, cwidth, 2, cwidth, height - 1);
+		wTextureShadeLine(scr, *pmap, 80, cwidth + 1, 2, cwidth + 1, height - 1);
+
+		if (width > 1)
+			wTextureShadeLine(scr, *pmap, -40, width - cwidth - 2, 2, width - cwidth - 2, height - 1);
+		wTextureShadeLine(scr, *pmap, 80, width - cwidth - 1, 2, width - cwidth - 1, height - 1);
+
+#ifdef SHADOW_RESIZEBAR
+		wTextureShadeLine(scr, *pmap, 80, 0, 1, 0, height - 1);
+		wTextureShadeLine(scr, *pmap, -40, width - 1, 1, width - 1, height - 1);
+		wTextureShadeLine(scr, *pmap, -40, 0, height - 1, width - 1, height - 1);
+#endif
+
+		wStatsDecorationSent(WDECO_XRENDER, 1, 0);
+		return;
+	}
+
+	wStatsMarkStart(&mark);
+	img = renderResizebarImage(texture, width, height, cwidth);
+	wStatsSpanEnd(WSPAN_TEXTURE_RENDER, &mark);
+
+	if (!img) {
+		wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
+		return;
+	}
+
+	wStatsDecorationSent(WDECO_IMAGE, 1, 0);
+
+	if (!wTextureConvertImage(scr, img, pmap))
 		wwarning(_("error rendering image: %s"), RMessageForError(RErrorCode));
 
 	RReleaseImage(img);
 }
 
+/*
+ * Frames painted in a batch.
+ *
+ * When the appearance changes, every frame remakes its textures, and
+ * rendering them one after the other takes seconds on a busy session.
+ * Between wFrameWindowBeginBatch() and wFrameWindowEndBatch(), the frames
+ * that need new textures are only queued when painted. The end of the
+ * batch then collects the titlebars and resizebars they need, once for
+ * each texture and size, renders their images on up to MAX_RENDER_WORKERS
+ * threads, converts them, and paints the queued frames, which take the
+ * pixmaps rendered for them instead of rendering their own.
+ *
+ * Only the images are rendered on the workers: the connection to the
+ * server and the statistics are only used by the main thread. The
+ * textures drawn by the server are not worth a job. Without threads, the
+ * main thread renders the jobs itself.
+ */
+#define MAX_RENDER_WORKERS	8
+#define RENDER_JOB_BUCKETS	64
+
+typedef struct RenderJob {
+	struct RenderJob *next;		/* in the bucket */
+	unsigned int hash;
+
+	/* what to render */
+	WTexture *texture;
+	int resizebar;
+	int width, height;
+	int bsize;			/* of the buttons, or of the resizebar corners */
+	int left, language, right;
+
+	WScreen *scr;
+	int users;			/* frames that will take the pixmaps */
+	RImage *images[TB_PARTS];
+	Pixmap pixmaps[TB_PARTS];
+	int widths[TB_PARTS];
+	int heights[TB_PARTS];
+} RenderJob;
+
+static struct {
+	int level;			/* of nested batches */
+	WMArray *frames;		/* queued */
+
+	RenderJob *buckets[RENDER_JOB_BUCKETS];
+	RenderJob **jobs;
+	int count, size;
+	int next;			/* job to be taken by a worker */
+} batch;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static unsigned int render_job_hash(const RenderJob *key)
+{
+	uintptr_t values[6];
+	const unsigned char *p = (const unsigned char *) values;
+	unsigned int hash = 2166136261u;
+	size_t i;
+
+	values[0] = (uintptr_t) key->texture;
+	values[1] = key->resizebar;
+	values[2] = key->width;
+	values[3] = key->height;
+	values[4] = key->bsize;
+	values[5] = key->left | key->language << 1 | key->right << 2;
+
+	for (i = 0; i < sizeof(values); i++) {
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static RenderJob *find_render_job(RenderJob *key)
+{
+	RenderJob *job;
+
+	key->hash = render_job_hash(key);
+
+	for (job = batch.buckets[key->hash & (RENDER_JOB_BUCKETS - 1)]; job; job = job->next) {
+		if (job->hash == key->hash && job->texture == key->texture &&
+		    job->resizebar == key->resizebar &&
+		    job->width == key->width && job->height == key->height &&
+		    job->bsize == key->bsize && job->left == key->left &&
+		    job->language == key->language && job->right == key->right)
+			return job;
+	}
+
+	return NULL;
+}
+
+/* What remakeTexture_titlebar() renders for the state, False if no image */
+static Bool titlebar_render_key(WFrameWindow *fwin, int state, RenderJob *key)
+{
+	WTexture *texture = fwin->title_texture[state];
+
+	if (!texture || !fwin->titlebar || !fwin->flags.titlebar ||
+	    texture->any.type == WTEX_SOLID)
+		return False;
+
+	memset(key, 0, sizeof(*key));
+	key->texture = texture;
+	key->width = fwin->width + 1;
+	key->height = fwin->titlebar_height;
+	key->bsize = fwin->titlebar_height;
+
+	/* eventually surrounded by if new_style */
+	key->left = fwin->left_button && fwin->flags.map_left_button &&
+		    !fwin->flags.lbutton_dont_fit;
+#ifdef XKB_BUTTON_HINT
+	key->language = fwin->language_button && fwin->flags.map_language_button &&
+			!fwin->flags.languagebutton_dont_fit;
+#endif
+	key->right = fwin->right_button && fwin->flags.map_right_button &&
+		     !fwin->flags.rbutton_dont_fit;
+
+	return True;
+}
+
+/* What remakeTexture_resizebar() renders, False if no image */
+static Bool resizebar_render_key(WFrameWindow *fwin, RenderJob *key)
+{
+	if (!fwin->resizebar_texture || !fwin->resizebar_texture[0] ||
+	    !fwin->resizebar || !fwin->flags.resizebar ||
+	    fwin->resizebar_texture[0]->any.type == WTEX_SOLID)
+		return False;
+
+	memset(key, 0, sizeof(*key));
+	key->texture = fwin->resizebar_texture[0];
+	key->resizebar = 1;
+	key->width = fwin->width;
+	key->height = fwin->resizebar_height;
+	key->bsize = fwin->resizebar_corner_width;
+
+	return True;
+}
+
+static void add_render_job(WScreen *scr, RenderJob *key)
+{
+	RenderJob *job;
+
+	if (wTextureServerRenders(scr, key->texture, WREL_FLAT))
+		return;
+
+	job = find_render_job(key);
+	if (!job) {
+		job = wmalloc(sizeof(RenderJob));
+		*job = *key;
+		job->scr = scr;
+		job->next = batch.buckets[job->hash & (RENDER_JOB_BUCKETS - 1)];
+		batch.buckets[job->hash & (RENDER_JOB_BUCKETS - 1)] = job;
+
+		if (batch.count == batch.size) {
+			batch.size = batch.size ? batch.size * 2 : 64;
+			batch.jobs = wrealloc(batch.jobs, batch.size * sizeof(RenderJob *));
+		}
+		batch.jobs[batch.count++] = job;
+	}
+
+	job->users++;
+}
+
+/* The jobs of what wFrameWindowPaint() will remake */
+static void add_frame_jobs(WFrameWindow *fwin)
+{
+	WScreen *scr = fwin->vscr->screen_ptr;
+	RenderJob key;
+	int state;
+
+	for (state = 0; state < (fwin->flags.single_texture ? 1 : 3); state++)
+		if (titlebar_render_key(fwin, state, &key))
+			add_render_job(scr, &key);
+
+	if (resizebar_render_key(fwin, &key))
+		add_render_job(scr, &key);
+}
+
+static void *render_worker(void *data)
+{
+	RenderJob *job;
+
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) data;
+
+	for (;;) {
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&batch_lock);
+#endif
+		job = batch.next < batch.count ? batch.jobs[batch.next++] : NULL;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&batch_lock);
+#endif
+
+		if (!job)
+			break;
+
+		if (job->resizebar)
+			job->images[TB_TITLE] = renderResizebarImage(job->texture, job->width,
+								     job->height, job->bsize);
+		else
+			renderTextureImages(job->texture, job->width, job->height,
+					    job->bsize, job->bsize,
+					    job->left, job->language, job->right, job->images);
+	}
+
+	return NULL;
+}
+
+static void run_render_jobs(void)
+{
+#ifdef HAVE_PTHREAD
+	pthread_t workers[MAX_RENDER_WORKERS];
+	long cpus;
+	int i, started = 0;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > MAX_RENDER_WORKERS)
+		cpus = MAX_RENDER_WORKERS;
+#endif
+
+	batch.next = 0;
+
+#ifdef HAVE_PTHREAD
+	/* the main thread is one of the workers, and does it all if the others can't start */
+	for (i = 1; i < cpus && i < batch.count; i++) {
+		if (pthread_create(&workers[started], NULL, render_worker, NULL) != 0)
+			break;
+		started++;
+	}
+#endif
+
+	render_worker(NULL);
+
+#ifdef HAVE_PTHREAD
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+#endif
+}
+
+static void convert_render_job(RenderJob *job)
+{
+	int i;
+
+	/* remakeTexture_*() will render it again, and tell why it fails */
+	if (!job->images[TB_TITLE]) {
+		for (i = 0; i < TB_PARTS; i++)
+			if (job->images[i])
+				RReleaseImage(job->images[i]);
+		job->users = 0;
+		return;
+	}
+
+	for (i = 0; i < TB_PARTS; i++) {
+		if (job->images[i]) {
+			job->widths[i] = job->images[i]->width;
+			job->heights[i] = job->images[i]->height;
+		}
+	}
+
+	wStatsDecorationSent(WDECO_IMAGE, 1, 0);
+	convertTextureImages(job->scr, job->images, job->pixmaps);
+}
+
+/*
+ * Take the pixmaps the batch rendered for key. All but the last frame
+ * using them get copies, made by the server.
+ */
+static Bool take_rendered_pixmaps(RenderJob *key, Pixmap pixmaps[TB_PARTS])
+{
+	RenderJob *job;
+	WScreen *scr;
+	int i;
+
+	if (batch.count == 0)
+		return False;
+
+	job = find_render_job(key);
+	if (!job || job->users <= 0)
+		return False;
+
+	scr = job->scr;
+	XSetClipMask(dpy, scr->copy_gc, None);
+
+	for (i = 0; i < TB_PARTS; i++) {
+		if (job->users > 1 && job->pixmaps[i] != None) {
+			pixmaps[i] = XCreatePixmap(dpy, scr->w_win, job->widths[i], job->heights[i], scr->w_depth);
+			XCopyArea(dpy, job->pixmaps[i], pixmaps[i], scr->copy_gc,
+				  0, 0, job->widths[i], job->heights[i], 0, 0);
+		} else {
+			pixmaps[i] = job->pixmaps[i];
+			job->pixmaps[i] = None;
+		}
+	}
+
+	job->users--;
+
+	return True;
+}
+
+static void free_render_jobs(void)
+{
+	RenderJob *job;
+	int i, j;
+
+	for (i = 0; i < batch.count; i++) {
+		job = batch.jobs[i];
+		for (j = 0; j < TB_PARTS; j++)
+			if (job->pixmaps[j] != None)
+				XFreePixmap(dpy, job->pixmaps[j]);
+		wfree(job);
+	}
+
+	wfree(batch.jobs);
+	batch.jobs = NULL;
+	batch.count = batch.size = batch.next = 0;
+	memset(batch.buckets, 0, sizeof(batch.buckets));
+}
+
+static void unqueue_frame(WFrameWindow *fwin)
+{
+	WMRemoveFromArray(batch.frames, fwin);
+	fwin->flags.remake_queued = 0;
+}
+
+void wFrameWindowBeginBatch(void)
+{
+	if (!batch.frames)
+		batch.frames = WMCreateArray(64);
+
+	batch.level++;
+}
+
+void wFrameWindowEndBatch(void)
+{
+	WMArrayIterator iter;
+	WFrameWindow *fwin;
+	WStatsMark mark;
+	int i;
+
+	if (batch.level == 0 || --batch.level > 0)
+		return;
+
+	if (WMGetArrayItemCount(batch.frames) == 0)
+		return;
+
+	wStatsMarkStart(&mark);
+
+	WM_ITERATE_ARRAY(batch.frames, fwin, iter)
+		add_frame_jobs(fwin);
+
+	run_render_jobs();
+
+	for (i = 0; i < batch.count; i++)
+		convert_render_job(batch.jobs[i]);
+
+	wStatsSpanEnd(WSPAN_TEXTURE_RENDER, &mark);
+
+	/* and swap the textures of all the frames in one pass */
+	WM_ITERATE_ARRAY(batch.frames, fwin, iter) {
+		fwin->flags.remake_queued = 0;
+		wFrameWindowPaint(fwin);
+	}
+
+	WMEmptyArray(batch.frames);
+	free_render_jobs();
+}
+
 static void updateTexture_titlebar(WFrameWindow *fwin)
 {
 	unsigned long pixel;
@@ -1114,69 +1661,55 @@ static void updateTexture_resizebar(WFrameWindow *fwin)
 
 static void remakeTexture_titlebar(WFrameWindow *fwin, int state)
 {
-	Pixmap pmap, lpmap, rpmap;
-	int left, right, width;
-#ifdef XKB_BUTTON_HINT
-	Pixmap tpmap;
-	int language;
-#endif
+	RenderJob key;
+	Pixmap parts[TB_PARTS];
 
 	if (!fwin->title_texture[state] || !fwin->titlebar || !fwin->flags.titlebar)
 		return;
 
 	destroy_framewin_button(fwin, state);
-	if (fwin->title_texture[state]->any.type == WTEX_SOLID)
+	if (!titlebar_render_key(fwin, state, &key))
 		return;
 
-	/* eventually surrounded by if new_style */
-	left = fwin->left_button && fwin->flags.map_left_button &&
-	       !fwin->flags.lbutton_dont_fit;
-#ifdef XKB_BUTTON_HINT
-	language = fwin->language_button && fwin->flags.map_language_button &&
-		   !fwin->flags.languagebutton_dont_fit;
-#endif
-	right = fwin->right_button && fwin->flags.map_right_button &&
-		!fwin->flags.rbutton_dont_fit;
-
-	width = fwin->width + 1;
-	renderTexture(fwin->vscr->screen_ptr, fwin->title_texture[state],
-		      width, fwin->titlebar_height,
-		      fwin->titlebar_height, fwin->titlebar_height,
-		      &pmap,
-		      left, &lpmap,
+	if (!take_rendered_pixmaps(&key, parts))
+		renderTexture(fwin->vscr->screen_ptr, key.texture,
+			      key.width, key.height,
+			      key.bsize, key.bsize,
+			      &parts[TB_TITLE],
+			      key.left, &parts[TB_LEFT],
 #ifdef XKB_BUTTON_HINT
-		      language, &tpmap,
+			      key.language, &parts[TB_LANGUAGE],
 #endif
-		      right, &rpmap);
+			      key.right, &parts[TB_RIGHT]);
 
-	fwin->title_back[state] = pmap;
+	fwin->title_back[state] = parts[TB_TITLE];
 	if (wPreferences.new_style == TS_NEW) {
-		fwin->lbutton_back[state] = lpmap;
-		fwin->rbutton_back[state] = rpmap;
+		fwin->lbutton_back[state] = parts[TB_LEFT];
+		fwin->rbutton_back[state] = parts[TB_RIGHT];
 #ifdef XKB_BUTTON_HINT
-		fwin->languagebutton_back[state] = tpmap;
+		fwin->languagebutton_back[state] = parts[TB_LANGUAGE];
 #endif
 	}
 }
 
 static void remakeTexture_resizebar(WFrameWindow *fwin, int state)
 {
-	Pixmap pmap;
+	RenderJob key;
+	Pixmap parts[TB_PARTS];
 
 	if (!fwin->resizebar_texture || !fwin->resizebar_texture[0] ||
 	    !fwin->resizebar || !fwin->flags.resizebar || state != 0)
 		return;
 
 	destroy_pixmap(fwin->resizebar_back[0]);
-	if (fwin->resizebar_texture[0]->any.type == WTEX_SOLID)
+	if (!resizebar_render_key(fwin, &key))
 		return;
 
-	renderResizebarTexture(fwin->vscr->screen_ptr,
-			       fwin->resizebar_texture[0],
-			       fwin->width,
-			       fwin->resizebar_height, fwin->resizebar_corner_width, &pmap);
+	if (!take_rendered_pixmaps(&key, parts))
+		renderResizebarTexture(fwin->vscr->screen_ptr, key.texture,
+				       key.width, key.height, key.bsize, &parts[TB_TITLE]);
 
-	fwin->resizebar_back[0] = pmap;
+	fwin->resizebar_back[0] = parts[TB_TITLE];
 }
 
 static char *get_title(WFrameWindow *fwin)
@@ -1197,16 +1730,34 @@ static void paint_title(WFrameWindow *fwin, int lofs, int rofs, int state)
 	WScreen *scr = vscr->screen_ptr;
 	char *title, *orig_title;
 	int w, h, x, y;
-	int titlelen;
+	int titlelen, width;
 
 	orig_title = get_title(fwin);
 
 	if (!orig_title)
 		return;
 
-	title = ShrinkString(*fwin->font, orig_title, fwin->titlebar_width - lofs - rofs);
+	/* titles are repainted far more often than they change */
+	width = fwin->titlebar_width - lofs - rofs;
+	if (fwin->shrunk_title.font != *fwin->font || fwin->shrunk_title.width != width ||
+	    strcmp(fwin->shrunk_title.title, orig_title) != 0) {
+		if (fwin->shrunk_title.font) {
+			WMReleaseFont(fwin->shrunk_title.font);
+			wfree(fwin->shrunk_title.title);
+			wfree(fwin->shrunk_title.text);
+		}
+
+		fwin->shrunk_title.font = WMRetainFont(*fwin->font);
+		fwin->shrunk_title.title = wstrdup(orig_title);
+		fwin->shrunk_title.width = width;
+		fwin->shrunk_title.text = ShrinkString(*fwin->font, orig_title, width);
+		fwin->shrunk_title.text_width = WMWidthOfString(*fwin->font, fwin->shrunk_title.text,
+								 strlen(fwin->shrunk_title.text));
+	}
+
+	title = fwin->shrunk_title.text;
 	titlelen = strlen(title);
-	w = WMWidthOfString(*fwin->font, title, titlelen);
+	w = fwin->shrunk_title.text_width;
 
 	switch (fwin->flags.justification) {
 	case WTJ_LEFT:
@@ -1254,8 +1805,6 @@ static void paint_title(WFrameWindow *fwin, int lofs, int rofs, int state)
 
 	XCopyArea(dpy, buf, fwin->titlebar->window, scr->copy_gc, 0, 0, w + 2, h, x - 1, y);
 	XFreePixmap(dpy, buf);
-
-	wfree(title);
 }
 
 void wFrameWindowPaint(WFrameWindow *fwin)
@@ -1268,6 +1817,15 @@ void wFrameWindowPaint(WFrameWindow *fwin)
 	if (fwin->flags.is_client_window_frame)
 		fwin->flags.justification = wPreferences.title_justification;
 
+	/* the textures are remade at the end of the batch */
+	if (fwin->flags.need_texture_remake && batch.level > 0) {
+		if (!fwin->flags.remake_queued) {
+			fwin->flags.remake_queued = 1;
+			WMAddToArray(batch.frames, fwin);
+		}
+		return;
+	}
+
 	if (fwin->flags.need_texture_remake) {
 		fwin->flags.need_texture_remake = 0;
 		fwin->flags.need_texture_change = 0;
@@ -84,6 +84,15 @@ typedef struct WFrameWindow {
     WMColor **title_color;
     WMFont **font;
 
+    /* last title shrunk to fit the titlebar, reused while nothing changes */
+    struct {
+	WMFont *font;		       /* retained */
+	char *title;
+	int width;
+	char *text;
+	int text_width;
+    } shrunk_title;
+
 #ifdef KEEP_XKB_LOCK_STATUS
     int languagemode;
     int last_languagemode;
@@ -144,6 +153,8 @@ typedef struct WFrameWindow {
         unsigned int is_client_window_frame:1;
 
         unsigned int incomplete_title:1;
+
+        unsigned int remake_queued:1;   /* until the end of the batch */
     } flags;
     int depth;
     int width;		/* Framewin width */
@@ -169,6 +180,15 @@ void wframewin_set_borders(WFrameWindow *fwin, int flags);
 void wFrameWindowDestroy(WFrameWindow *fwin);
 void wFrameWindowChangeState(WFrameWindow *fwin, int state);
 void wFrameWindowPaint(WFrameWindow *fwin);
+
+/*
+ * Between these, the frames that need new textures are not painted but
+ * queued, and the end of the outer batch renders what they all need at
+ * once, each texture and size once and on several threads, before
+ * painting them. For the appearance changes, that remake every frame.
+ */
+void wFrameWindowBeginBatch(void);
+void wFrameWindowEndBatch(void);
 void wFrameWindowConfigure(WFrameWindow *fwin, int x, int y, int width, int height);
 void wFrameWindowResize(WFrameWindow *fwin, int width, int height);
 int wFrameWindowChangeTitle(WFrameWindow *fwin, const char *new_title);
@@ -38,6 +38,7 @@
 #include "input.h"
 #include "framewin.h"
 #include "miniwindow.h"
+#include "pool.h"
 
 /**** Global varianebles ****/
 
@@ -111,7 +112,7 @@ WIcon *icon_create_core(virtual_screen *vscr)
 {
 	WIcon *icon;
 
-	icon = wmalloc(sizeof(WIcon));
+	icon = wPoolAlloc(&wIconPool);
 	icon->core = wcore_create();
 	icon->vscr = vscr;
 
@@ -121,7 +122,7 @@ WIcon *icon_create_core(virtual_screen *vscr)
 	icon->core->descriptor.parent_type = WCLASS_MINIWINDOW;
 	icon->core->descriptor.parent = icon;
 
-	icon->core->stacking = wmalloc(sizeof(WStacking));
+	icon->core->stacking = wPoolAlloc(&wStackingPool);
 	icon->core->stacking->above = NULL;
 	icon->core->stacking->under = NULL;
 	icon->core->stacking->window_level = NORMAL_ICON_LEVEL;
@@ -137,14 +138,14 @@ WIcon *icon_create_core(virtual_screen *vscr)
 static void icon_destroy_core(WIcon *icon)
 {
 	if (icon->core->stacking)
-		wfree(icon->core->stacking);
+		wPoolFree(&wStackingPool, icon->core->stacking);
 
 	XDeleteContext(dpy, icon->core->window, w_global.context.client_win);
 	XDestroyWindow(dpy, icon->core->window);
 
 	wcore_destroy(icon->core);
 	icon->core = NULL;
-	wfree(icon);
+	wPoolFree(&wIconPool, icon);
 }
 
 void wIconDestroy(WIcon *icon)
@@ -8,46 +8,128 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+#include <stdlib.h>
+
 #include <X11/Xutil.h>
+#include <WINGs/WUtil.h>
+
 #include "input.h"
 
 unsigned int _NumLockMask;
 unsigned int _ScrollLockMask;
 
 /* Keyboard functions */
-#ifdef NUMLOCK_HACK
-void
-wHackedGrabKey(Display *dpy, int keycode, unsigned int modifiers,
-	       Window grab_window, Bool owner_events, int pointer_mode, int keyboard_mode)
+
+/*
+ * Key grab sets
+ *
+ * The shortcuts are grabbed once on the root window. The set of grabs is
+ * kept sorted, so that a change of the bindings or of the focused window
+ * only sends the grabs that really appear or disappear, instead of
+ * ungrabbing and grabbing everything again on every window.
+ */
+#define KEYGRAB(keycode, modifiers)	(((unsigned long) (keycode) << 16) | (modifiers))
+#define KEYGRAB_KEYCODE(key)		((int) ((key) >> 16))
+#define KEYGRAB_MODIFIERS(key)		((unsigned int) ((key) & 0xffff))
+
+static void keygrab_append(WKeyGrabSet *set, int keycode, unsigned int modifiers)
+{
+	if (set->count == set->size) {
+		set->size = set->size ? set->size * 2 : 64;
+		set->keys = wrealloc(set->keys, sizeof(unsigned long) * set->size);
+	}
+
+	set->keys[set->count++] = KEYGRAB(keycode, modifiers);
+}
+
+/* add the key and all its combinations with CapsLock, NumLock and ScrollLock */
+void wKeyGrabSetAdd(WKeyGrabSet *set, int keycode, unsigned int modifiers)
 {
+	if (keycode == 0)
+		return;
+
+	keygrab_append(set, keycode, modifiers);
+
 	if (modifiers == AnyModifier)
 		return;
 
-	/* grab all combinations of the modifier with CapsLock, NumLock and
-	 * ScrollLock. How much memory/CPU does such a monstrosity consume
-	 * in the server?
-	 */
-	if (_NumLockMask)
-		XGrabKey(dpy, keycode, modifiers | _NumLockMask,
-			 grab_window, owner_events, pointer_mode, keyboard_mode);
-	if (_ScrollLockMask)
-		XGrabKey(dpy, keycode, modifiers | _ScrollLockMask,
-			 grab_window, owner_events, pointer_mode, keyboard_mode);
-	if (_NumLockMask && _ScrollLockMask)
-		XGrabKey(dpy, keycode, modifiers | _NumLockMask | _ScrollLockMask,
-			 grab_window, owner_events, pointer_mode, keyboard_mode);
-	if (_NumLockMask)
-		XGrabKey(dpy, keycode, modifiers | _NumLockMask | LockMask,
-			 grab_window, owner_events, pointer_mode, keyboard_mode);
-	if (_ScrollLockMask)
-		XGrabKey(dpy, keycode, modifiers | _ScrollLockMask | LockMask,
-			 grab_window, owner_events, pointer_mode, keyboard_mode);
-	if (_NumLockMask && _ScrollLockMask)
-		XGrabKey(dpy, keycode, modifiers | _NumLockMask | _ScrollLockMask | LockMask,
-			 grab_window, owner_events, pointer_mode, keyboard_mode);
-	/* phew, I guess that's all, right? */
-}
+	keygrab_append(set, keycode, modifiers | LockMask);
+
+#ifdef NUMLOCK_HACK
+	if (_NumLockMask) {
+		keygrab_append(set, keycode, modifiers | _NumLockMask);
+		keygrab_append(set, keycode, modifiers | _NumLockMask | LockMask);
+	}
+	if (_ScrollLockMask) {
+		keygrab_append(set, keycode, modifiers | _ScrollLockMask);
+		keygrab_append(set, keycode, modifiers | _ScrollLockMask | LockMask);
+	}
+	if (_NumLockMask && _ScrollLockMask) {
+		keygrab_append(set, keycode, modifiers | _NumLockMask | _ScrollLockMask);
+		keygrab_append(set, keycode, modifiers | _NumLockMask | _ScrollLockMask | LockMask);
+	}
 #endif			  /* NUMLOCK_HACK */
+}
+
+static int compare_keygrabs(const void *a, const void *b)
+{
+	unsigned long ka = *(const unsigned long *) a;
+	unsigned long kb = *(const unsigned long *) b;
+
+	return (ka > kb) - (ka < kb);
+}
+
+/*
+ * Make the grabs on window match the wanted set. The wanted set becomes the
+ * grabbed one, and is left empty. Returns the number of grab requests sent.
+ */
+int wKeyGrabSetUpdate(Display *dpy, Window window, WKeyGrabSet *grabbed, WKeyGrabSet *wanted)
+{
+	int i, j, n, requests = 0;
+
+	if (wanted->count > 1)
+		qsort(wanted->keys, wanted->count, sizeof(unsigned long), compare_keygrabs);
+
+	/* drop duplicates, the same key can be bound by several shortcuts */
+	for (i = 1, n = wanted->count ? 1 : 0; i < wanted->count; i++)
+		if (wanted->keys[i] != wanted->keys[n - 1])
+			wanted->keys[n++] = wanted->keys[i];
+	wanted->count = n;
+
+	i = j = 0;
+	while (i < grabbed->count || j < wanted->count) {
+		if (j >= wanted->count || (i < grabbed->count && grabbed->keys[i] < wanted->keys[j])) {
+			XUngrabKey(dpy, KEYGRAB_KEYCODE(grabbed->keys[i]),
+				   KEYGRAB_MODIFIERS(grabbed->keys[i]), window);
+			requests++;
+			i++;
+		} else if (i >= grabbed->count || wanted->keys[j] < grabbed->keys[i]) {
+			XGrabKey(dpy, KEYGRAB_KEYCODE(wanted->keys[j]), KEYGRAB_MODIFIERS(wanted->keys[j]),
+				 window, True, GrabModeAsync, GrabModeAsync);
+			requests++;
+			j++;
+		} else {
+			i++;
+			j++;
+		}
+	}
+
+	wKeyGrabSetFree(grabbed);
+	*grabbed = *wanted;
+	wanted->keys = NULL;
+	wanted->count = wanted->size = 0;
+
+	return requests;
+}
+
+void wKeyGrabSetFree(WKeyGrabSet *set)
+{
+	if (set->keys)
+		wfree(set->keys);
+
+	set->keys = NULL;
+	set->count = set->size = 0;
+}
 
 void
 wHackedGrabButton(Display *dpy, unsigned int button, unsigned int modifiers,
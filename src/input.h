@@ -23,11 +23,16 @@ void wHackedGrabButton(Display *dpy, unsigned int button, unsigned int modifiers
 		       unsigned int event_mask, int pointer_mode,
 		       int keyboard_mode, Window confine_to, Cursor cursor);
 
-#ifdef NUMLOCK_HACK
-void wHackedGrabKey(Display *dpy, int keycode, unsigned int modifiers,
-		    Window grab_window, Bool owner_events, int pointer_mode,
-		    int keyboard_mode);
-#endif
+/* A set of passive key grabs held on a window */
+typedef struct WKeyGrabSet {
+	unsigned long *keys;	/* keycode and modifiers of each grab, sorted */
+	int count;
+	int size;
+} WKeyGrabSet;
+
+void wKeyGrabSetAdd(WKeyGrabSet *set, int keycode, unsigned int modifiers);
+int wKeyGrabSetUpdate(Display *dpy, Window window, WKeyGrabSet *grabbed, WKeyGrabSet *wanted);
+void wKeyGrabSetFree(WKeyGrabSet *set);
 
 void getOffendingModifiers(Display *dpy);
 
@@ -25,6 +25,8 @@
 #include "framewin.h"
 #include "menu.h"
 #include "actions.h"
+#include "pool.h"
+#include "stats.h"
 #include "winmenu.h"
 #include "stacking.h"
 #include "xinerama.h"
@@ -264,7 +266,7 @@ void menu_destroy(WMenu *menu)
 	}
 
 	if (menu->core->stacking) {
-		wfree(menu->core->stacking);
+		wPoolFree(&wStackingPool, menu->core->stacking);
 		menu->core->stacking = NULL;
 	}
 
@@ -453,17 +455,40 @@ static Pixmap renderTexture(WMenu *menu)
 	RColor light, dark, mid;
 	WScreen *scr = menu->vscr->screen_ptr;
 	WTexture *texture = scr->menu_item_texture;
+	int height;
 
 	if (wPreferences.menu_style == MS_NORMAL)
-		img = wTextureRenderImage(texture, menu->width, menu->entry_height, WREL_MENUENTRY);
+		height = menu->entry_height;
 	else
-		img = wTextureRenderImage(texture, menu->width, get_menu_height(menu) + 1, WREL_MENUENTRY);
+		height = get_menu_height(menu) + 1;
+
+	pix = wTextureRenderPixmap(scr, texture, menu->width, height, WREL_MENUENTRY);
+	if (pix != None) {
+		if (wPreferences.menu_style == MS_SINGLE_TEXTURE) {
+			for (i = 1; i < menu->entry_no; i++) {
+				wTextureShadeLine(scr, pix, -40, 0, i * menu->entry_height - 2,
+						  menu->width - 1, i * menu->entry_height - 2);
+
+				wTextureDrawBlackLine(scr, pix, 0, i * menu->entry_height - 1,
+						      menu->width - 1, i * menu->entry_height - 1);
 
+				wTextureShadeLine(scr, pix, 80, 0, i * menu->entry_height,
+						  menu->width - 1, i * menu->entry_height);
+			}
+		}
+
+		wStatsDecorationSent(WDECO_XRENDER, 1, 0);
+		return pix;
+	}
+
+	img = wTextureRenderImage(texture, menu->width, height, WREL_MENUENTRY);
 	if (!img) {
 		wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
 		return None;
 	}
 
+	wStatsDecorationSent(WDECO_IMAGE, 1, 0);
+
 	if (wPreferences.menu_style == MS_SINGLE_TEXTURE) {
 		light.alpha = 0;
 		light.red = light.green = light.blue = 80;
@@ -486,7 +511,7 @@ static Pixmap renderTexture(WMenu *menu)
 		}
 	}
 
-	if (!RConvertImage(scr->rcontext, img, &pix))
+	if (!wTextureConvertImage(scr, img, &pix))
 		wwarning(_("error rendering image:%s"), RMessageForError(RErrorCode));
 
 	RReleaseImage(img);
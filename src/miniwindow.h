@@ -19,6 +19,7 @@ typedef struct WMiniWindow {
 	int icon_x, icon_y;        /* Position of the icon */
 	int icon_w, icon_h;        /* Used by minimize animation */
 	RImage *net_icon_image;    /* Window Image */
+	unsigned long net_icon_hash; /* of the _NET_WM_ICON image it was made from */
 } WMiniWindow;
 
 WMiniWindow *miniwindow_create(void);
@@ -15,6 +15,7 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <strings.h>
 #include <unistd.h>
@@ -122,6 +123,90 @@ void move_window(Window win, int from_x, int from_y, int to_x, int to_y)
 #endif
 }
 
+/* icon slide animation parameters, by speed */
+static const struct {
+	int delay;
+	int steps;
+	int slowdown;
+} apars[5] = {
+	{ICON_SLIDE_DELAY_UF, ICON_SLIDE_STEPS_UF, ICON_SLIDE_SLOWDOWN_UF},
+	{ICON_SLIDE_DELAY_F,  ICON_SLIDE_STEPS_F,  ICON_SLIDE_SLOWDOWN_F},
+	{ICON_SLIDE_DELAY_M,  ICON_SLIDE_STEPS_M,  ICON_SLIDE_SLOWDOWN_M},
+	{ICON_SLIDE_DELAY_S,  ICON_SLIDE_STEPS_S,  ICON_SLIDE_SLOWDOWN_S},
+	{ICON_SLIDE_DELAY_US, ICON_SLIDE_STEPS_US, ICON_SLIDE_SLOWDOWN_US}
+};
+
+/*
+ * Move several windows at once, each one from its own position to its own
+ * destination. When animated, they all slide together, along the same
+ * easing as slide_windows() for the longest of the moves, so the time it
+ * takes does not depend on how many windows there are.
+ */
+void move_windows(WWindowMove *moves, int count)
+{
+#ifdef USE_ANIMATIONS
+	time_t time0 = time(NULL);
+	int slide_delay, slide_steps, slide_slowdown;
+	int longest, done, step, d;
+#endif
+	int i;
+
+	if (count <= 0)
+		return;
+
+#ifdef USE_ANIMATIONS
+	if (!wPreferences.no_animations) {
+		slide_slowdown = apars[(int)wPreferences.icon_slide_speed].slowdown;
+		slide_steps = apars[(int)wPreferences.icon_slide_speed].steps;
+		slide_delay = apars[(int)wPreferences.icon_slide_speed].delay;
+
+		longest = 0;
+		for (i = 0; i < count; i++) {
+			d = WMAX(abs(moves[i].to_x - moves[i].from_x), abs(moves[i].to_y - moves[i].from_y));
+			if (d > longest)
+				longest = d;
+		}
+
+		for (done = 0; done < longest;) {
+			step = (longest - done) / slide_slowdown;
+			if (step < slide_steps)
+				step = slide_steps;
+
+			done += step;
+			if (done > longest)
+				done = longest;
+
+			for (i = 0; i < count; i++)
+				XMoveWindow(dpy, moves[i].win,
+					    moves[i].from_x + (moves[i].to_x - moves[i].from_x) * done / longest,
+					    moves[i].from_y + (moves[i].to_y - moves[i].from_y) * done / longest);
+
+			XFlush(dpy);
+
+			if (slide_delay > 0)
+				wusleep(slide_delay * 1000L);
+			else
+				wusleep(1000L);
+
+			if (time(NULL) - time0 > MAX_ANIMATION_TIME)
+				break;
+		}
+	}
+#endif
+
+	for (i = 0; i < count; i++)
+		XMoveWindow(dpy, moves[i].win, moves[i].to_x, moves[i].to_y);
+
+#ifdef USE_ANIMATIONS
+	if (!wPreferences.no_animations) {
+		XSync(dpy, 0);
+
+		/* compress expose events */
+		eatExpose();
+	}
+#endif
+}
+
 /* wins is an array of Window, sorted from left to right, the first is
  * going to be moved from (from_x,from_y) to (to_x,to_y) and the
  * following windows are going to be offset by (ICON_SIZE*i,0) */
@@ -134,19 +219,6 @@ void slide_windows(Window wins[], int n, int from_x, int from_y, int to_x, int t
 	int slide_delay, slide_steps, slide_slowdown;
 	int i;
 
-	/* animation parameters */
-	static const struct {
-		int delay;
-		int steps;
-		int slowdown;
-	} apars[5] = {
-		{ICON_SLIDE_DELAY_UF, ICON_SLIDE_STEPS_UF, ICON_SLIDE_SLOWDOWN_UF},
-		{ICON_SLIDE_DELAY_F,  ICON_SLIDE_STEPS_F,  ICON_SLIDE_SLOWDOWN_F},
-		{ICON_SLIDE_DELAY_M,  ICON_SLIDE_STEPS_M,  ICON_SLIDE_SLOWDOWN_M},
-		{ICON_SLIDE_DELAY_S,  ICON_SLIDE_STEPS_S,  ICON_SLIDE_SLOWDOWN_S},
-		{ICON_SLIDE_DELAY_US, ICON_SLIDE_STEPS_US, ICON_SLIDE_SLOWDOWN_US}
-	};
-
 	slide_slowdown = apars[(int)wPreferences.icon_slide_speed].slowdown;
 	slide_steps = apars[(int)wPreferences.icon_slide_speed].steps;
 	slide_delay = apars[(int)wPreferences.icon_slide_speed].delay;
@@ -234,26 +306,166 @@ void slide_windows(Window wins[], int n, int from_x, int from_y, int to_x, int t
 	eatExpose();
 }
 
-/* find the start of a UTF-8 character at or before the given position */
-static int utf8_find_char_start(const char *string, int pos)
+/*
+ * Glyph advances, cached per font so that the width of a string can be
+ * summed up character by character without asking the font every time.
+ * The fonts are retained while they sit in the cache, so that a pointer
+ * can not be reused by a different font.
+ */
+#define GLYPH_CACHE_FONTS	8
+#define GLYPH_CACHE_ASCII	128
+
+typedef struct {
+	uint32_t key;		/* the bytes of the UTF-8 sequence, 0 when free */
+	int advance;
+} GlyphAdvance;
+
+static struct glyph_cache {
+	WMFont *font;
+	unsigned long stamp;	/* for least recently used eviction */
+	short ascii[GLYPH_CACHE_ASCII];	/* -1 when not known yet */
+	GlyphAdvance *others;	/* open addressed, size is a power of 2 */
+	int others_size;
+	int others_count;
+} glyph_cache[GLYPH_CACHE_FONTS];
+
+static unsigned long glyph_cache_stamp;
+
+static struct glyph_cache *glyph_cache_for(WMFont *font)
 {
-	while (pos > 0 && (string[pos] & 0xC0) == 0x80) {
-		pos--;
+	struct glyph_cache *gc, *victim = &glyph_cache[0];
+	int i;
+
+	for (i = 0; i < GLYPH_CACHE_FONTS; i++) {
+		gc = &glyph_cache[i];
+		if (gc->font == font) {
+			gc->stamp = ++glyph_cache_stamp;
+			return gc;
+		}
+		if (gc->stamp < victim->stamp)
+			victim = gc;
 	}
-	return pos;
+
+	gc = victim;
+	if (gc->font)
+		WMReleaseFont(gc->font);
+	if (gc->others)
+		wfree(gc->others);
+
+	gc->font = WMRetainFont(font);
+	gc->stamp = ++glyph_cache_stamp;
+	for (i = 0; i < GLYPH_CACHE_ASCII; i++)
+		gc->ascii[i] = -1;
+	gc->others = NULL;
+	gc->others_size = 0;
+	gc->others_count = 0;
+
+	return gc;
 }
 
+/* length of the UTF-8 sequence starting at s, invalid bytes count as one */
+static int utf8_char_length(const char *s, int left)
+{
+	unsigned char c = *s;
+	int i, len;
+
+	if (c < 0xC0)
+		len = 1;
+	else if (c < 0xE0)
+		len = 2;
+	else if (c < 0xF0)
+		len = 3;
+	else
+		len = 4;
+
+	if (len > left)
+		return 1;
+
+	for (i = 1; i < len; i++)
+		if ((s[i] & 0xC0) != 0x80)
+			return 1;
+
+	return len;
+}
+
+static int glyph_advance(struct glyph_cache *gc, const char *s, int len)
+{
+	uint32_t key = 0;
+	unsigned int h;
+	int i;
+
+	if (len == 1 && (unsigned char)*s < GLYPH_CACHE_ASCII) {
+		if (gc->ascii[(unsigned char)*s] < 0)
+			gc->ascii[(unsigned char)*s] = WMWidthOfString(gc->font, s, 1);
+		return gc->ascii[(unsigned char)*s];
+	}
+
+	for (i = 0; i < len; i++)
+		key = (key << 8) | (unsigned char)s[i];
+
+	if (gc->others_count * 2 >= gc->others_size) {
+		GlyphAdvance *old = gc->others;
+		int old_size = gc->others_size;
+
+		gc->others_size = old_size ? old_size * 2 : 64;
+		gc->others = wmalloc(gc->others_size * sizeof(GlyphAdvance));
+		for (i = 0; i < old_size; i++) {
+			if (!old[i].key)
+				continue;
+			h = (old[i].key * 2654435761U) & (gc->others_size - 1);
+			while (gc->others[h].key)
+				h = (h + 1) & (gc->others_size - 1);
+			gc->others[h] = old[i];
+		}
+		if (old)
+			wfree(old);
+	}
+
+	h = (key * 2654435761U) & (gc->others_size - 1);
+	while (gc->others[h].key) {
+		if (gc->others[h].key == key)
+			return gc->others[h].advance;
+		h = (h + 1) & (gc->others_size - 1);
+	}
+
+	gc->others[h].key = key;
+	gc->others[h].advance = WMWidthOfString(gc->font, s, len);
+	gc->others_count++;
+
+	return gc->others[h].advance;
+}
+
+static int string_advance(struct glyph_cache *gc, const char *s, int len)
+{
+	int w = 0, n;
+
+	while (len > 0) {
+		n = utf8_char_length(s, len);
+		w += glyph_advance(gc, s, n);
+		s += n;
+		len -= n;
+	}
+
+	return w;
+}
+
+/*
+ * Shorten the string to fit in width, keeping the first word, the
+ * longest tail that fits, and "..." in between. The returned string
+ * must be freed by the caller.
+ */
 char *ShrinkString(WMFont *font, const char *string, int width)
 {
-	int w, w1 = 0;
-	int p;
+	struct glyph_cache *gc;
 	char *pos, *text;
-	int p1, p2, t, utf8_safe_pos;
+	int len, w, n;
 
-	p = strlen(string);
-	w = WMWidthOfString(font, string, p);
-	text = wmalloc(strlen(string) + 8);
+	gc = glyph_cache_for(font);
+
+	len = strlen(string);
+	text = wmalloc(len + 8);
 	strcpy(text, string);
+	w = string_advance(gc, string, len);
 	if (w <= width)
 		return text;
 
@@ -261,62 +473,28 @@ char *ShrinkString(WMFont *font, const char *string, int width)
 	if (!pos)
 		pos = strchr(text, ':');
 
-	if (pos) {
+	if (pos && string_advance(gc, text, pos - text) <= width) {
+		width -= string_advance(gc, text, pos - text);
+		string += pos - text + 1;
+		len -= pos - text + 1;
+		w = string_advance(gc, string, len);
 		*pos = 0;
-		p = strlen(text);
-		w1 = WMWidthOfString(font, text, p);
-
-		if (w1 > width) {
-			p = 0;
-			*pos = ' ';
-			*text = 0;
-		} else {
-			*pos = 0;
-			width -= w1;
-			p++;
-		}
-
-		string += p;
-		p = strlen(string);
 	} else {
 		*text = 0;
 	}
 
 	strcat(text, "...");
-	width -= WMWidthOfString(font, "...", 3);
-
-	p1 = 0;
-	p2 = p;
-	t = (p2 - p1) / 2;
-
-	while (p2 > p1) {
-		int old_t = t;
-		/* ensure we cut at UTF-8 character boundary */
-		utf8_safe_pos = utf8_find_char_start(string, p - t);
-		t = p - utf8_safe_pos;
-
-		w = WMWidthOfString(font, &string[utf8_safe_pos], t);
-		if (w > width) {
-			p2 = t;
-		} else if (w < width) {
-			p1 = t;
-		} else {
-			p1 = t;
-			break;
-		}
-
-		/* Calculate new t for next iteration */
-		t = p1 + (p2 - p1) / 2;
-
-		/* Prevent infinite loop if we're not making progress */
-		if (t == old_t || (p2 - p1) <= 1) {
-			break;
-		}
+	width -= string_advance(gc, "...", 3);
+
+	/* drop characters from the front until the rest fits */
+	while (len > 0 && w > width) {
+		n = utf8_char_length(string, len);
+		w -= glyph_advance(gc, string, n);
+		string += n;
+		len -= n;
 	}
 
-	/* ensure final cut is at UTF-8 character boundary */
-	utf8_safe_pos = utf8_find_char_start(string, p - p1);
-	strcat(text, &string[utf8_safe_pos]);
+	strcat(text, string);
 
 	return text;
 }
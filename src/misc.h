@@ -17,7 +17,14 @@
 Bool wFetchName(Display *dpy, Window win, char **winname);
 Bool UpdateDomainFile(WDDomain *domain);
 
+typedef struct {
+	Window win;
+	int from_x, from_y;
+	int to_x, to_y;
+} WWindowMove;
+
 void move_window(Window win, int from_x, int from_y, int to_x, int to_y);
+void move_windows(WWindowMove *moves, int count);
 void slide_windows(Window wins[], int n, int from_x, int from_y, int to_x, int to_y);
 void ParseWindowName(WMPropList *value, char **winstance, char **wclass, const char *where);
 
@@ -13,6 +13,11 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/keysym.h>
+#ifdef USE_XSYNC
+#include <X11/extensions/sync.h>
+#include <poll.h>
+#include <time.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -34,6 +39,7 @@
 #include "screen.h"
 #include "xinerama.h"
 #include "miniwindow.h"
+#include "properties.h"
 
 #include <WINGs/WINGsP.h>
 
@@ -2004,6 +2010,156 @@ static int getResizeDirection(WWindow * wwin, int x, int y, int dy, int flags)
 	return dir;
 }
 
+#ifdef USE_XSYNC
+/*
+ * How long a client may take to redraw after a configure before the rest of
+ * the resize goes on without waiting for it, in milliseconds
+ */
+#define SYNC_REQUEST_TIMEOUT	100
+
+/*
+ * Opaque resize paced with the _NET_WM_SYNC_REQUEST protocol: every configure
+ * is preceded by a request for the client to set its counter to a new value
+ * once it has redrawn, and an alarm on that counter tells us when it is done.
+ * Meanwhile, the pointer motion only updates the geometry to configure next,
+ * so the window is resized as fast as the client can draw and no faster.
+ */
+typedef struct {
+	XSyncCounter counter;	/* None when the window is not paced */
+	XSyncAlarm alarm;
+	XSyncValue value;	/* value asked for in the last request */
+	Bool waiting;		/* the client did not reach value yet */
+	Bool pending;		/* a geometry is waiting to be configured */
+	struct timespec deadline;
+} WResizeSync;
+
+static void resizeSyncStart(WWindow *wwin, WResizeSync *sync)
+{
+	XSyncAlarmAttributes attr;
+	XSyncValue one;
+	int overflow;
+
+	if (!w_global.xext.sync.supported || !wwin->protocols.SYNC_REQUEST)
+		return;
+
+	attr.trigger.counter = PropGetSyncRequestCounter(wwin->client_win);
+	if (attr.trigger.counter == None || !XSyncQueryCounter(dpy, attr.trigger.counter, &sync->value))
+		return;
+
+	/* Armed for the first request, so that it does not trigger right away */
+	attr.trigger.value_type = XSyncAbsolute;
+	XSyncIntToValue(&one, 1);
+	XSyncValueAdd(&attr.trigger.wait_value, sync->value, one, &overflow);
+	attr.trigger.test_type = XSyncPositiveComparison;
+	XSyncIntToValue(&attr.delta, 0);
+	attr.events = True;
+	sync->alarm = XSyncCreateAlarm(dpy, XSyncCACounter | XSyncCAValueType | XSyncCAValue
+				       | XSyncCATestType | XSyncCADelta | XSyncCAEvents, &attr);
+	if (sync->alarm == None)
+		return;
+
+	sync->counter = attr.trigger.counter;
+}
+
+static void resizeSyncStop(WResizeSync *sync)
+{
+	if (sync->alarm != None)
+		XSyncDestroyAlarm(dpy, sync->alarm);
+
+	sync->alarm = None;
+	sync->counter = None;
+	sync->waiting = False;
+}
+
+static void resizeConfigure(WWindow *wwin, WResizeSync *sync, Time time, int x, int y, int width, int height)
+{
+	XSyncAlarmAttributes attr;
+	XSyncValue one;
+	XEvent event;
+	int overflow;
+
+	if (sync->counter == None) {
+		wWindowConfigure(wwin, x, y, width, height);
+		return;
+	}
+
+	if (sync->waiting) {
+		sync->pending = True;
+		return;
+	}
+
+	XSyncIntToValue(&one, 1);
+	XSyncValueAdd(&sync->value, sync->value, one, &overflow);
+
+	attr.trigger.wait_value = sync->value;
+	XSyncChangeAlarm(dpy, sync->alarm, XSyncCAValue, &attr);
+
+	event.xclient.type = ClientMessage;
+	event.xclient.message_type = w_global.atom.wm.protocols;
+	event.xclient.format = 32;
+	event.xclient.display = dpy;
+	event.xclient.window = wwin->client_win;
+	event.xclient.data.l[0] = w_global.atom.wm.sync_request;
+	event.xclient.data.l[1] = time;
+	event.xclient.data.l[2] = XSyncValueLow32(sync->value);
+	event.xclient.data.l[3] = XSyncValueHigh32(sync->value);
+	event.xclient.data.l[4] = 0;
+	XSendEvent(dpy, wwin->client_win, False, NoEventMask, &event);
+
+	wWindowConfigure(wwin, x, y, width, height);
+
+	sync->waiting = True;
+	sync->pending = False;
+	clock_gettime(CLOCK_MONOTONIC, &sync->deadline);
+	sync->deadline.tv_nsec += SYNC_REQUEST_TIMEOUT * 1000000L;
+	if (sync->deadline.tv_nsec >= 1000000000L) {
+		sync->deadline.tv_sec++;
+		sync->deadline.tv_nsec -= 1000000000L;
+	}
+}
+
+/*
+ * Wait for either an event in mask, which is returned, or for the client to
+ * catch up with the last configure. A client that does not answer in time is
+ * not waited for anymore until the end of the resize.
+ */
+static Bool resizeSyncWaitEvent(WResizeSync *sync, long mask, XEvent *event)
+{
+	struct timespec now;
+	struct pollfd pfd;
+	long remaining;
+
+	pfd.fd = ConnectionNumber(dpy);
+	pfd.events = POLLIN;
+
+	while (sync->waiting) {
+		if (XCheckTypedEvent(dpy, w_global.xext.sync.event_base + XSyncAlarmNotify, event)) {
+			XSyncAlarmNotifyEvent *notify = (XSyncAlarmNotifyEvent *) event;
+
+			if (notify->alarm == sync->alarm
+			    && XSyncValueGreaterOrEqual(notify->counter_value, sync->value))
+				sync->waiting = False;
+			continue;
+		}
+
+		if (XCheckMaskEvent(dpy, mask, event))
+			return True;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		remaining = (sync->deadline.tv_sec - now.tv_sec) * 1000
+			+ (sync->deadline.tv_nsec - now.tv_nsec) / 1000000;
+		if (remaining <= 0) {
+			resizeSyncStop(sync);
+			break;
+		}
+
+		poll(&pfd, 1, remaining);
+	}
+
+	return False;
+}
+#endif
+
 void wMouseResizeWindow(WWindow *wwin, XEvent *ev)
 {
 	XEvent event;
@@ -2033,6 +2189,13 @@ void wMouseResizeWindow(WWindow *wwin, XEvent *ev)
 		    ? wGetHeadForWindow(wwin)
 		    : scr->xine_info.primary_head);
 	int opaqueResize = wPreferences.opaque_resize;
+	long mask = KeyPressMask | ButtonMotionMask | ButtonReleaseMask
+		| PointerMotionHintMask | ButtonPressMask | ExposureMask;
+#ifdef USE_XSYNC
+	WResizeSync sync;
+
+	memset(&sync, 0, sizeof(sync));
+#endif
 
 	if (!IS_RESIZABLE(wwin))
 		return;
@@ -2078,10 +2241,26 @@ void wMouseResizeWindow(WWindow *wwin, XEvent *ev)
 	}
 
 	while (1) {
-		WMMaskEvent(dpy, KeyPressMask | ButtonMotionMask
-			    | ButtonReleaseMask | PointerMotionHintMask | ButtonPressMask | ExposureMask, &event);
+#ifdef USE_XSYNC
+		if (sync.waiting) {
+			if (!resizeSyncWaitEvent(&sync, mask, &event)) {
+				/* The client is ready for the latest geometry */
+				if (sync.pending)
+					resizeConfigure(wwin, &sync, CurrentTime, fx, fy, fw, fh - vert_border);
+				continue;
+			}
+		} else
+#endif
+			WMMaskEvent(dpy, mask, &event);
+
+#ifdef USE_XSYNC
+		/* A paced resize is already throttled by the client */
+		if (sync.counter == None && !checkMouseSamplingRate(&event))
+			continue;
+#else
 		if (!checkMouseSamplingRate(&event))
 			continue;
+#endif
 
 		switch (event.type) {
 		case KeyPress:
@@ -2197,6 +2376,11 @@ void wMouseResizeWindow(WWindow *wwin, XEvent *ev)
 
 				showGeometry(wwin, fx, fy, fx + fw, fy + fh, res);
 
+#ifdef USE_XSYNC
+				if (opaqueResize)
+					resizeSyncStart(wwin, &sync);
+#endif
+
 				started = 1;
 			}
 			if (started) {
@@ -2223,7 +2407,11 @@ void wMouseResizeWindow(WWindow *wwin, XEvent *ev)
 					/* Now, continue drawing */
 					XUngrabServer(dpy);
 					moveGeometryDisplayCentered(vscr, fx + fw / 2, fy + fh / 2);
+#ifdef USE_XSYNC
+					resizeConfigure(wwin, &sync, event.xmotion.time, fx, fy, fw, fh - vert_border);
+#else
 					wWindowConfigure(wwin, fx, fy, fw, fh - vert_border);
+#endif
 					showGeometry(wwin, fx, fy, fx + fw, fy + fh, res);
 				};
 			}
@@ -2237,6 +2425,10 @@ void wMouseResizeWindow(WWindow *wwin, XEvent *ev)
 				break;
 
 			if (started) {
+#ifdef USE_XSYNC
+				/* The final configure below is not paced */
+				resizeSyncStop(&sync);
+#endif
 				showGeometry(wwin, fx, fy, fx + fw, fy + fh, res);
 
 				if (!opaqueResize)
@@ -28,6 +28,7 @@
 #include "xinerama.h"
 #include "placement.h"
 #include "miniwindow.h"
+#include "stats.h"
 
 static int get_y_origin(WArea usableArea);
 static int get_x_origin(WArea usableArea);
@@ -497,9 +498,12 @@ void PlaceWindow(WWindow *wwin, int *x_ret, int *y_ret, unsigned width, unsigned
 {
 	virtual_screen *vscr = wwin->vscr;
 	WScreen *scr = vscr->screen_ptr;
+	WStatsMark mark;
 	int h = WMFontHeight(scr->title_font)
 		+ (wPreferences.window_title_clearance + TITLEBAR_EXTEND_SPACE) * 2;
 
+	wStatsMarkStart(&mark);
+
 	if (h > wPreferences.window_title_max_height)
 		h = wPreferences.window_title_max_height;
 
@@ -563,4 +567,6 @@ void PlaceWindow(WWindow *wwin, int *x_ret, int *y_ret, unsigned width, unsigned
 		*y_ret = usableArea.y2 - height;
 	if (*y_ret < usableArea.y1)
 		*y_ret = usableArea.y1;
+
+	wStatsSpanEnd(WSPAN_PLACEMENT, &mark);
 }
@@ -0,0 +1,202 @@
+/*
+ * awmaker - Abstracting Window Maker
+ *
+ * Fork of GNU Window Maker (GPL-2).
+ * Copyright (C) Alfredo K. Kojima, Dan Pascu, the Window Maker Team,
+ * and individual contributors; see LICENSE for full attribution.
+ * Fork modifications: Copyright (C) Rodolfo Garcia Penas (kix) <kix@kix.es>.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Every slab holds SLAB_OBJECTS objects and a mask of the ones in use.
+ * Each object is preceded by a pointer to its slab, so freeing it does
+ * not need to look for the slab. The slabs with free objects are kept
+ * at the head of the list, so allocating only looks at the first one.
+ * A slab that becomes empty is released when there is another slab
+ * worth of free objects in the pool, so that the pool shrinks back
+ * after a peak, but an object freed and allocated again right away does
+ * not go back to malloc().
+ */
+
+#include "awconfig.h"
+
+#include <X11/Xlib.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WindowMaker.h"
+#include "wcore.h"
+#include "framewin.h"
+#include "icon.h"
+#include "pool.h"
+
+#define SLAB_OBJECTS	64
+
+/* room for the slab pointer in front of each object, keeping the alignment */
+#define SLOT_HEADER	(2 * sizeof(void *))
+
+struct WPoolSlab {
+	WPoolSlab *prev, *next;
+	uint64_t used;			/* one bit per object */
+	size_t stride;
+	unsigned char *slots;
+};
+
+WPool wCoreWindowPool = WPOOL_INIT("core windows", WCoreWindow);
+WPool wFrameWindowPool = WPOOL_INIT("frames", WFrameWindow);
+WPool wStackingPool = WPOOL_INIT("stacking", WStacking);
+WPool wIconPool = WPOOL_INIT("icons", WIcon);
+
+static WPool *pools;
+
+static size_t pool_stride(WPool *pool)
+{
+	return (SLOT_HEADER + pool->size + SLOT_HEADER - 1) & ~(SLOT_HEADER - 1);
+}
+
+static void unlink_slab(WPool *pool, WPoolSlab *slab)
+{
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		pool->slabs = slab->next;
+
+	if (slab->next)
+		slab->next->prev = slab->prev;
+	else
+		pool->last = slab->prev;
+
+	slab->prev = slab->next = NULL;
+}
+
+static void push_slab(WPool *pool, WPoolSlab *slab)
+{
+	slab->prev = NULL;
+	slab->next = pool->slabs;
+	if (pool->slabs)
+		pool->slabs->prev = slab;
+	else
+		pool->last = slab;
+	pool->slabs = slab;
+}
+
+static void append_slab(WPool *pool, WPoolSlab *slab)
+{
+	slab->next = NULL;
+	slab->prev = pool->last;
+	if (pool->last)
+		pool->last->next = slab;
+	else
+		pool->slabs = slab;
+	pool->last = slab;
+}
+
+static WPoolSlab *create_slab(WPool *pool)
+{
+	WPoolSlab *slab;
+	size_t stride = pool_stride(pool);
+
+	slab = wmalloc(sizeof(WPoolSlab));
+	slab->stride = stride;
+	slab->slots = wmalloc(stride * SLAB_OBJECTS);
+	pool->capacity += SLAB_OBJECTS;
+
+	/* the first slab of the pool */
+	if (pool->capacity == SLAB_OBJECTS) {
+		WPool *p;
+
+		for (p = pools; p && p != pool; p = p->next)
+			;
+		if (!p) {
+			pool->next = pools;
+			pools = pool;
+		}
+	}
+
+	return slab;
+}
+
+void *wPoolAlloc(WPool *pool)
+{
+	WPoolSlab *slab = pool->slabs;
+	unsigned char *slot;
+	int i;
+
+	if (!slab || slab->used == UINT64_MAX) {
+		slab = create_slab(pool);
+		push_slab(pool, slab);
+	}
+
+	for (i = 0; slab->used & ((uint64_t) 1 << i); i++)
+		;
+
+	slab->used |= (uint64_t) 1 << i;
+	pool->in_use++;
+
+	/* keep the full slabs behind the others */
+	if (slab->used == UINT64_MAX && slab->next) {
+		unlink_slab(pool, slab);
+		append_slab(pool, slab);
+	}
+
+	slot = slab->slots + i * slab->stride;
+	*(WPoolSlab **) slot = slab;
+	memset(slot + SLOT_HEADER, 0, pool->size);
+
+	return slot + SLOT_HEADER;
+}
+
+void wPoolFree(WPool *pool, void *object)
+{
+	unsigned char *slot;
+	WPoolSlab *slab;
+	int i;
+
+	if (!object)
+		return;
+
+	slot = (unsigned char *) object - SLOT_HEADER;
+	slab = *(WPoolSlab **) slot;
+	i = (slot - slab->slots) / slab->stride;
+
+	if (slab->used == UINT64_MAX && slab->prev) {
+		unlink_slab(pool, slab);
+		push_slab(pool, slab);
+	}
+
+	slab->used &= ~((uint64_t) 1 << i);
+	pool->in_use--;
+
+	if (slab->used == 0 && pool->capacity - pool->in_use >= 2 * SLAB_OBJECTS) {
+		unlink_slab(pool, slab);
+		pool->capacity -= SLAB_OBJECTS;
+		wfree(slab->slots);
+		wfree(slab);
+	}
+}
+
+void wPoolForEach(WPool *pool, void (*proc)(void *object, void *data), void *data)
+{
+	WPoolSlab *slab, *next;
+	int i;
+
+	for (slab = pool->slabs; slab; slab = next) {
+		next = slab->next;
+		for (i = 0; i < SLAB_OBJECTS; i++)
+			if (slab->used & ((uint64_t) 1 << i))
+				(*proc)(slab->slots + i * slab->stride + SLOT_HEADER, data);
+	}
+}
+
+WPool *wPoolList(void)
+{
+	return pools;
+}
+
+size_t wPoolFootprint(WPool *pool)
+{
+	return (pool->capacity / SLAB_OBJECTS) * (sizeof(WPoolSlab) + pool_stride(pool) * SLAB_OBJECTS);
+}
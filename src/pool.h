@@ -0,0 +1,57 @@
+/*
+ * awmaker - Abstracting Window Maker
+ *
+ * Fork of GNU Window Maker (GPL-2).
+ * Copyright (C) Alfredo K. Kojima, Dan Pascu, the Window Maker Team,
+ * and individual contributors; see LICENSE for full attribution.
+ * Fork modifications: Copyright (C) Rodolfo Garcia Penas (kix) <kix@kix.es>.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef WMPOOL_H_
+#define WMPOOL_H_
+
+#include <stddef.h>
+
+/*
+ * Pools of objects of the same type, allocated by slabs.
+ *
+ * The objects every managed window, menu and icon is made of are taken
+ * from these rather than from malloc() one by one, so that they are kept
+ * together and reused, and so that the memory they use can be told.
+ * Like wmalloc(), wPoolAlloc() returns zeroed memory.
+ */
+typedef struct WPoolSlab WPoolSlab;
+
+typedef struct WPool {
+	const char *name;
+	size_t size;			/* of the objects */
+
+	WPoolSlab *slabs;		/* the ones with free objects first */
+	WPoolSlab *last;
+	unsigned long in_use;		/* objects */
+	unsigned long capacity;		/* objects in the slabs */
+
+	struct WPool *next;		/* in the list of pools, once used */
+} WPool;
+
+#define WPOOL_INIT(name, type)	{ name, sizeof(type), NULL, NULL, 0, 0, NULL }
+
+extern WPool wCoreWindowPool;
+extern WPool wFrameWindowPool;
+extern WPool wStackingPool;
+extern WPool wIconPool;
+
+void *wPoolAlloc(WPool *pool);
+void wPoolFree(WPool *pool, void *object);
+
+/* Call proc for every object of the pool in use */
+void wPoolForEach(WPool *pool, void (*proc)(void *object, void *data), void *data);
+
+/* The pools that were used, linked by next */
+WPool *wPoolList(void);
+
+/* Bytes taken by the slabs of the pool */
+size_t wPoolFootprint(WPool *pool);
+
+#endif
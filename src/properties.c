@@ -77,10 +77,32 @@ void PropGetProtocols(Window window, WProtocols *prots)
 			prots->SAVE_YOURSELF = 1;
 		else if (protocols[i] == w_global.atom.gnustep.wm_miniaturize_window)
 			prots->MINIATURIZE_WINDOW = 1;
+		else if (protocols[i] == w_global.atom.wm.sync_request)
+			prots->SYNC_REQUEST = 1;
 	}
 	XFree(protocols);
 }
 
+/*
+ * The basic counter of the _NET_WM_SYNC_REQUEST protocol, the client may
+ * also provide an extended one after it that we do not use
+ */
+XID PropGetSyncRequestCounter(Window window)
+{
+	unsigned long *data;
+	XID counter;
+
+	data = (unsigned long *)PropGetCheckProperty(window, w_global.atom.wm.sync_request_counter,
+						     XA_CARDINAL, 32, 1, NULL);
+	if (!data)
+		return None;
+
+	counter = data[0];
+	XFree(data);
+
+	return counter;
+}
+
 unsigned char *PropGetCheckProperty(Window window, Atom hint, Atom type, int format, int count, int *retCount)
 {
 	Atom type_ret;
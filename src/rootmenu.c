@@ -48,6 +48,7 @@
 #include "screen.h"
 #include "input.h"
 #include "shbinding.h"
+#include "stats.h"
 
 #include <WINGs/WUtil.h>
 
@@ -281,39 +282,44 @@ Bool wRootMenuPerformShortcut(XEvent *event)
 	return done;
 }
 
-void wRootMenuBindShortcuts(Window window)
+/*
+ * Grab the shortcuts on the root window. Only the difference with the grabs
+ * already held is sent to the server, so rebinding after a change of the
+ * menu or of the key bindings costs nothing for the unchanged keys.
+ */
+void rebindKeygrabs(virtual_screen *vscr)
 {
+	WScreen *scr = vscr->screen_ptr;
+	WKeyGrabSet wanted = { NULL, 0, 0 };
 	SHBinding *b;
+	int i;
 
-	for (b = shGetBindings(); b != NULL; b = b->next) {
-		if (b->type == RSM_WKBD || b->keycode == 0)
-			continue;
+	if (!scr->flags.key_grabs_off) {
+		for (i = 0; i < WKBD_LAST; i++)
+			wKeyGrabSetAdd(&wanted, wKeyBindings[i].keycode, wKeyBindings[i].modifier);
 
-		if (b->modifier != AnyModifier) {
-			XGrabKey(dpy, b->keycode, b->modifier | LockMask,
-				 window, True, GrabModeAsync, GrabModeAsync);
-#ifdef NUMLOCK_HACK
-			wHackedGrabKey(dpy, b->keycode, b->modifier, window, True, GrabModeAsync, GrabModeAsync);
-#endif
-		}
-		XGrabKey(dpy, b->keycode, b->modifier, window, True, GrabModeAsync, GrabModeAsync);
+		for (b = shGetBindings(); b != NULL; b = b->next)
+			if (b->type != RSM_WKBD)
+				wKeyGrabSetAdd(&wanted, b->keycode, b->modifier);
 	}
+
+	wKeyGrabSetUpdate(dpy, scr->root_win, &scr->key_grabs, &wanted);
 }
 
-void rebindKeygrabs(virtual_screen *vscr)
+/*
+ * A window with NoKeyBindings receives the shortcut keys itself, so the
+ * grabs are released while it has the focus.
+ */
+void updateKeygrabsFocus(virtual_screen *vscr, WWindow *wwin)
 {
-	WWindow *wwin;
-
-	wwin = vscr->window.focused;
-
-	while (wwin != NULL) {
-		XUngrabKey(dpy, AnyKey, AnyModifier, wwin->frame->core->window);
+	WScreen *scr = vscr->screen_ptr;
+	Bool off = (wwin != NULL && WFLAGP(wwin, no_bind_keys));
 
-		if (!WFLAGP(wwin, no_bind_keys))
-			wWindowSetKeyGrabs(wwin);
+	if (off == scr->flags.key_grabs_off)
+		return;
 
-		wwin = wwin->prev;
-	}
+	scr->flags.key_grabs_off = off;
+	rebindKeygrabs(vscr);
 }
 
 /*
@@ -1645,6 +1651,7 @@ void rootmenu_destroy(virtual_screen *vscr)
 void OpenRootMenu(virtual_screen *vscr, int x, int y, int keyboard)
 {
 	WMenu *rootmenu = NULL;
+	WStatsMark mark;
 
 	if (vscr->menu.root_menu && vscr->menu.root_menu->flags.mapped) {
 		rootmenu = vscr->menu.root_menu;
@@ -1669,7 +1676,10 @@ void OpenRootMenu(virtual_screen *vscr, int x, int y, int keyboard)
 	    w_global.domain.root_menu->timestamp > vscr->menu.root_menu->timestamp) {
 		if (vscr->menu.root_menu)
 			rootmenu_destroy(vscr);
+
+		wStatsMarkStart(&mark);
 		vscr->menu.root_menu = create_rootmenu(vscr);
+		wStatsSpanEnd(WSPAN_MENU_BUILD, &mark);
 		if (vscr->menu.root_menu)
 			vscr->menu.root_menu->timestamp = w_global.domain.root_menu->timestamp;
 
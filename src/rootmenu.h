@@ -12,10 +12,10 @@
 #define WMROOTMENU_H
 
 Bool wRootMenuPerformShortcut(XEvent *event);
-void wRootMenuBindShortcuts(Window window);
 void OpenRootMenu(virtual_screen *vscr, int x, int y, int keyboard);
 WMenu *create_rootmenu(virtual_screen *vscr);
 void rootmenu_destroy(virtual_screen *vscr);
 void rebindKeygrabs(virtual_screen *vscr);
+void updateKeygrabsFocus(virtual_screen *vscr, struct WWindow *wwin);
 
 #endif /* WMROOTMENU_H */
@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -32,6 +33,8 @@
 #include "pixmap.h"
 #include "menu.h"
 #include "window.h"
+#include "miniwindow.h"
+#include "framewin.h"
 #include "wdefaults.h"
 #include "main.h"
 #include "actions.h"
@@ -45,6 +48,7 @@
 #include "balloon.h"
 #include "geomview.h"
 #include "wmspec.h"
+#include "event.h"
 
 #include "xinerama.h"
 
@@ -783,6 +787,7 @@ WScreen *wScreenInit(int screen_number)
 
 	/* create GCs with default values */
 	allocGCs(scr);
+	wTextureInitRender(scr);
 
 	return scr;
 }
@@ -923,6 +928,234 @@ void wScreenUpdateUsableArea(virtual_screen *vscr)
 		wArrangeIcons(vscr, True);
 }
 
+/*
+ * Head reconfiguration
+ *
+ * When the monitors change (hotplug, mode switch, rotation) the head layout
+ * is read again and whatever ended up outside of it is brought back, so the
+ * window manager does not need to restart and re-adopt every window.
+ */
+static double elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/* the head of the previous layout that covered most of the rectangle, or -1 */
+static int find_old_head(const WMRect *heads, int count, int x, int y, int width, int height)
+{
+	unsigned long area, best_area = 0;
+	int i, best = -1;
+
+	for (i = 0; i < count; i++) {
+		int x1 = WMAX(x, heads[i].pos.x);
+		int y1 = WMAX(y, heads[i].pos.y);
+		int x2 = WMIN(x + width, heads[i].pos.x + (int) heads[i].size.width);
+		int y2 = WMIN(y + height, heads[i].pos.y + (int) heads[i].size.height);
+
+		if (x2 <= x1 || y2 <= y1)
+			continue;
+
+		area = (unsigned long) (x2 - x1) * (y2 - y1);
+		if (area > best_area) {
+			best_area = area;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Bring a geometry back on the screen, returns True if it was changed.
+ * Something still touching a head is only pulled in enough to be reachable;
+ * something left on a vanished head keeps its offset from the corner of
+ * that head, but on the primary head.
+ */
+static Bool relocate_rect(virtual_screen *vscr, const WMRect *old_heads, int old_count,
+			  int *x, int *y, int width, int height)
+{
+	WScreen *scr = vscr->screen_ptr;
+	WMRect rect, head;
+	int flags, old_head, new_x, new_y;
+
+	rect.pos.x = *x;
+	rect.pos.y = *y;
+	rect.size.width = width;
+	rect.size.height = height;
+
+	wGetRectPlacementInfo(vscr, rect, &flags);
+	if (!(flags & XFLAG_DEAD))
+		return wScreenBringInside(vscr, x, y, width, height) != 0;
+
+	head = wGetRectForHead(scr, scr->xine_info.primary_head);
+	old_head = find_old_head(old_heads, old_count, *x, *y, width, height);
+	if (old_head >= 0) {
+		new_x = head.pos.x + *x - old_heads[old_head].pos.x;
+		new_y = head.pos.y + *y - old_heads[old_head].pos.y;
+	} else {
+		new_x = head.pos.x;
+		new_y = head.pos.y;
+	}
+
+	wScreenKeepInside(vscr, &new_x, &new_y, width, height);
+	if (width > (int) head.size.width)
+		new_x = head.pos.x;
+	if (height > (int) head.size.height)
+		new_y = head.pos.y;
+
+	*x = new_x;
+	*y = new_y;
+
+	return True;
+}
+
+static Bool relocate_window(WWindow *wwin, const WMRect *old_heads, int old_count)
+{
+	virtual_screen *vscr = wwin->vscr;
+	WScreen *scr = vscr->screen_ptr;
+	int x = wwin->frame_x;
+	int y = wwin->frame_y;
+	int head, old_head;
+	WMRect rect;
+
+	if (wwin->flags.fullscreen) {
+		x = wwin->bfs_geometry.x;
+		y = wwin->bfs_geometry.y;
+		if (relocate_rect(vscr, old_heads, old_count, &x, &y,
+				  wwin->bfs_geometry.width, wwin->bfs_geometry.height)) {
+			wwin->bfs_geometry.x = x;
+			wwin->bfs_geometry.y = y;
+		}
+
+		rect = wGetRectForHead(scr, wGetHeadForWindow(wwin));
+		if (rect.pos.x == wwin->frame_x && rect.pos.y == wwin->frame_y &&
+		    (int) rect.size.width == wwin->frame->width && (int) rect.size.height == wwin->frame->height)
+			return False;
+
+		wWindowConfigure(wwin, rect.pos.x, rect.pos.y, rect.size.width, rect.size.height);
+		return True;
+	}
+
+	if (wwin->flags.maximized) {
+		old_head = find_old_head(old_heads, old_count, x, y, wwin->frame->width, wwin->frame->height);
+		head = wGetHeadForWindow(wwin);
+		rect = wGetRectForHead(scr, head);
+		if (old_head >= 0 &&
+		    rect.pos.x == old_heads[old_head].pos.x && rect.pos.y == old_heads[old_head].pos.y &&
+		    rect.size.width == old_heads[old_head].size.width &&
+		    rect.size.height == old_heads[old_head].size.height)
+			return False;
+
+		x = wwin->old_geometry.x;
+		y = wwin->old_geometry.y;
+		if (relocate_rect(vscr, old_heads, old_count, &x, &y,
+				  wwin->old_geometry.width, wwin->old_geometry.height)) {
+			wwin->old_geometry.x = x;
+			wwin->old_geometry.y = y;
+		}
+
+		wMaximizeWindow(wwin, wwin->flags.maximized | MAX_KEYBOARD, head);
+		return True;
+	}
+
+	if (!relocate_rect(vscr, old_heads, old_count, &x, &y, wwin->frame->width, wwin->frame->height))
+		return False;
+
+	wWindowMove(wwin, x, y);
+	wWindowSynthConfigureNotify(wwin);
+
+	return True;
+}
+
+static Bool icons_off_screen(virtual_screen *vscr)
+{
+	WAppIcon *aicon;
+	WWindow *wwin;
+
+	for (aicon = w_global.app_icon_list; aicon; aicon = aicon->next)
+		if (!aicon->docked && !onScreen(vscr, aicon->x_pos, aicon->y_pos))
+			return True;
+
+	for (wwin = vscr->window.focused; wwin; wwin = wwin->prev)
+		if (wwin->flags.miniaturized && wwin->miniwindow->icon &&
+		    !onScreen(vscr, wwin->miniwindow->icon_x, wwin->miniwindow->icon_y))
+			return True;
+
+	return False;
+}
+
+/*
+ * Only the hot corners and the scrollable menus want to know where the
+ * pointer goes on the root window, and not always
+ */
+void wScreenSetPointerMotion(WScreen *scr, Bool enable)
+{
+	if (enable)
+		XSelectInput(dpy, scr->root_win, EVENT_MASK);
+	else
+		XSelectInput(dpy, scr->root_win, EVENT_MASK & ~PointerMotionMask);
+}
+
+void wScreenUpdateHeads(virtual_screen *vscr)
+{
+	WScreen *scr = vscr->screen_ptr;
+	struct timespec start;
+	double heads_ms, windows_ms;
+	WMRect *old_heads;
+	WWindow *wwin;
+	int old_count, moved, i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	old_count = wXineramaHeads(scr);
+	old_heads = wmalloc(sizeof(WMRect) * old_count);
+	for (i = 0; i < old_count; i++)
+		old_heads[i] = wGetRectForHead(scr, i);
+
+	scr->scr_width = WidthOfScreen(ScreenOfDisplay(dpy, scr->screen));
+	scr->scr_height = HeightOfScreen(ScreenOfDisplay(dpy, scr->screen));
+
+	wInitXinerama(scr);
+
+	scr->usableArea = wrealloc(scr->usableArea, sizeof(WArea) * wXineramaHeads(scr));
+	scr->totalUsableArea = wrealloc(scr->totalUsableArea, sizeof(WArea) * wXineramaHeads(scr));
+	wScreenUpdateUsableArea(vscr);
+
+	wNETWMUpdateDesktop(vscr);
+	wNETWMUpdateWorkarea(vscr);
+	wHotCornersUpdate(scr);
+
+	heads_ms = elapsed_ms(&start);
+
+	if (vscr->dock.dock)
+		wDockKeepOnScreen(vscr->dock.dock);
+
+	if (vscr->workspace.count > 0 && vscr->workspace.array[vscr->workspace.current]->clip)
+		wDockKeepOnScreen(vscr->workspace.array[vscr->workspace.current]->clip);
+
+	moved = 0;
+	for (wwin = vscr->window.focused; wwin; wwin = wwin->prev)
+		if (relocate_window(wwin, old_heads, old_count))
+			moved++;
+
+	windows_ms = elapsed_ms(&start);
+
+	/* the icons follow their windows, wScreenUpdateUsableArea() was too early for them */
+	if ((wPreferences.auto_arrange_icons && moved > 0) || icons_off_screen(vscr))
+		wArrangeIcons(vscr, True);
+
+	wfree(old_heads);
+
+	wmessage(_("screen changed to %dx%d with %d head(s), %d window(s) moved in %.1f ms"
+		   " (heads %.1f ms, windows %.1f ms, icons %.1f ms)"),
+		 scr->scr_width, scr->scr_height, wXineramaHeads(scr), moved, elapsed_ms(&start),
+		 heads_ms, windows_ms - heads_ms, elapsed_ms(&start) - windows_ms);
+}
+
 void virtual_screen_restore(virtual_screen *vscr)
 {
 
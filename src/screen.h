@@ -13,8 +13,13 @@
 
 #include "awconfig.h"
 #include "WindowMaker.h"
+#include "input.h"
 #include <sys/types.h>
 
+#ifdef USE_XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
+
 #include <WINGs/WUtil.h>
 
 
@@ -22,6 +27,16 @@ typedef struct {
     WMRect *screens;
     int count;                 /* screen count, 0 = inactive */
     int primary_head;	       /* main working screen */
+
+    /* lookup tables derived from screens, rebuilt by wInitXinerama() */
+    struct {
+	int *x_edges;	       /* sorted distinct vertical edges of the heads */
+	int *y_edges;	       /* sorted distinct horizontal edges of the heads */
+	int x_count, y_count;
+	int *cells;	       /* head owning each cell of the edge grid, or -1 */
+	int *neighbours;       /* 4 per head: result of wGetHeadRelativeToCurrentHead */
+	Bool overlapping;      /* some heads share pixels (cloned outputs) */
+    } layout;
 } WXineramaInfo;
 
 
@@ -173,6 +188,8 @@ struct WScreen {
 
     WMArray *fakeGroupLeaders;         /* list of fake window group ids */
 
+    WKeyGrabSet key_grabs;	       /* shortcuts grabbed on the root window */
+
     WMBag *stacking_list;	       /* bag of lists of windows
                                         * in stacking order.
                                         * Indexed by window level
@@ -308,12 +325,22 @@ struct WScreen {
     Window workspace_name;
     WMHandlerID *workspace_name_timer;
     struct WorkspaceNameData *workspace_name_data;
+    struct WorkspaceNameGlyph *workspace_name_glyphs;	/* most recent first */
 
     /* for raise-delay */
     WMHandlerID *autoRaiseTimer;
     Window autoRaiseWindow;	       /* window that is scheduled to be
                                         * raised */
     WMHandlerID *hot_corner_timer;     /* timer for hot corner activation */
+#ifdef USE_XRENDER
+    XRenderPictFormat *render_format; /* of w_visual, NULL when the decorations
+                                        * are not drawn by the server */
+    GC render_invert_gc;	       /* to subtract from the pixels, see texture.c */
+#endif
+#ifdef USE_POINTER_BARRIERS
+    XID *hot_corner_barriers;          /* 8 per head, 2 per corner, or None */
+    int hot_corner_barrier_count;
+#endif
 #ifdef USE_DOCK_XDND
     char *xdestring;
 #endif
@@ -333,6 +360,7 @@ struct WScreen {
         unsigned int jump_back_pending:1;
         unsigned int ignore_focus_events:1;
         unsigned int in_hot_corner:3;
+        unsigned int key_grabs_off:1;  /* focused window has NoKeyBindings */
     } flags;
 };
 
@@ -346,6 +374,8 @@ virtual_screen *wScreenForRootWindow(Window window);   /* window must be valid *
 virtual_screen *wScreenForWindow(Window window);       /* slower than above functions */
 
 void wScreenUpdateUsableArea(virtual_screen *vscr);
+void wScreenUpdateHeads(virtual_screen *vscr);
+void wScreenSetPointerMotion(WScreen *scr, Bool enable);
 
 void create_logo_image(virtual_screen *vscr);
 void set_screen_options(virtual_screen *vscr);
@@ -74,6 +74,32 @@
 
 #include <WINGs/WUtil.h>
 
+/* keys of the session state, created once */
+static WMPropList *sApplications, *sWorkspace, *sCommand, *sName, *sDock;
+static WMPropList *sShaded, *sMiniaturized, *sMaximized, *sHidden, *sGeometry;
+static WMPropList *sShortcutMask, *sMarkKey, *sYes, *sNo;
+
+static void make_keys(void)
+{
+	if (sApplications != NULL)
+		return;
+
+	sApplications = WMCreatePLString("Applications");
+	sWorkspace = WMCreatePLString("Workspace");
+	sCommand = WMCreatePLString("Command");
+	sName = WMCreatePLString("Name");
+	sDock = WMCreatePLString("Dock");
+	sShaded = WMCreatePLString("Shaded");
+	sMiniaturized = WMCreatePLString("Miniaturized");
+	sMaximized = WMCreatePLString("Maximized");
+	sHidden = WMCreatePLString("Hidden");
+	sGeometry = WMCreatePLString("Geometry");
+	sShortcutMask = WMCreatePLString("ShortcutMask");
+	sMarkKey = WMCreatePLString("MarkKey");
+	sYes = WMCreatePLString("Yes");
+	sNo = WMCreatePLString("No");
+}
+
 static int getBool(WMPropList * value)
 {
 	char *val;
@@ -146,9 +172,6 @@ static WMPropList *makeWindowState(WWindow *wwin, WApplication *wapp)
 	WMPropList *shaded, *miniaturized, *maximized, *hidden, *geometry;
 	WMPropList *dock, *shortcut;
 	WMPropList *mark_key_pl = NULL;
-	WMPropList *sWorkspace, *sCommand, *sName, *sDock, *sShaded, *sMiniaturized;
-	WMPropList *sMaximized, *sHidden, *sGeometry, *sShortcutMask, *sYes, *sNo;
-	WMPropList *sMarkKey;
 
 	if (wwin->orig_main_window != None && wwin->orig_main_window != wwin->client_win)
 		win = wwin->orig_main_window;
@@ -183,8 +206,6 @@ static WMPropList *makeWindowState(WWindow *wwin, WApplication *wapp)
 	cmd = WMCreatePLString(command);
 
 	workspace = WMCreatePLString(wwin->frame->vscr->workspace.array[wwin->frame->workspace]->name);
-	sYes = WMCreatePLString("Yes");
-	sNo = WMCreatePLString("No");
 	shaded = wwin->flags.shaded ? sYes : sNo;
 	miniaturized = wwin->flags.miniaturized ? sYes : sNo;
 	snprintf(buffer, sizeof(buffer), "0x%04X", wwin->flags.maximized);
@@ -206,16 +227,6 @@ static WMPropList *makeWindowState(WWindow *wwin, WApplication *wapp)
 	if (wwin->mark_key_label)
 		mark_key_pl = WMCreatePLString(wwin->mark_key_label);
 
-	sName = WMCreatePLString("Name");
-	sCommand = WMCreatePLString("Command");
-	sWorkspace = WMCreatePLString("Workspace");
-	sShaded = WMCreatePLString("Shaded");
-	sMiniaturized = WMCreatePLString("Miniaturized");
-	sMaximized = WMCreatePLString("Maximized");
-	sHidden = WMCreatePLString("Hidden");
-	sGeometry = WMCreatePLString("Geometry");
-	sShortcutMask = WMCreatePLString("ShortcutMask");
-	sMarkKey = WMCreatePLString("MarkKey");
 	win_state = WMCreatePLDictionary(sName, name,
 					 sCommand, cmd,
 					 sWorkspace, workspace,
@@ -264,7 +275,6 @@ static WMPropList *makeWindowState(WWindow *wwin, WApplication *wapp)
 		}
 
 		dock = WMCreatePLString(name);
-		sDock = WMCreatePLString("Dock");
 		WMPutInPLDictionary(win_state, sDock, dock);
 		WMReleasePropList(dock);
 	}
@@ -283,7 +293,6 @@ void wSessionSaveState(virtual_screen *vscr)
 {
 	WWindow *wwin = vscr->window.focused;
 	WMPropList *win_info, *wks, *list = NULL;
-	WMPropList *sApplications, *sWorkspace;
 	WMArray *wapp_list = NULL;
 
 	if (!w_global.session_state) {
@@ -292,6 +301,8 @@ void wSessionSaveState(virtual_screen *vscr)
 			return;
 	}
 
+	make_keys();
+
 	list = WMCreatePLArray(NULL);
 	wapp_list = WMCreateArray(16);
 	while (wwin) {
@@ -319,12 +330,10 @@ void wSessionSaveState(virtual_screen *vscr)
 		wwin = wwin->prev;
 	}
 
-	sApplications = WMCreatePLString("Applications");
 	WMRemoveFromPLDictionary(w_global.session_state, sApplications);
 	WMPutInPLDictionary(w_global.session_state, sApplications, list);
 	WMReleasePropList(list);
 
-	sWorkspace = WMCreatePLString("Workspace");
 	wks = WMCreatePLString(vscr->workspace.array[vscr->workspace.current]->name);
 	WMPutInPLDictionary(w_global.session_state, sWorkspace, wks);
 	WMReleasePropList(wks);
@@ -334,13 +343,10 @@ void wSessionSaveState(virtual_screen *vscr)
 
 void wSessionClearState(void)
 {
-	WMPropList *sApplications, *sWorkspace;
-
 	if (!w_global.session_state)
 		return;
 
-	sApplications = WMCreatePLString("Applications");
-	sWorkspace = WMCreatePLString("Workspace");
+	make_keys();
 	WMRemoveFromPLDictionary(w_global.session_state, sApplications);
 	WMRemoveFromPLDictionary(w_global.session_state, sWorkspace);
 }
@@ -365,22 +371,48 @@ static pid_t execCommand(virtual_screen *vscr, char *command)
 	return pid;
 }
 
+/* "<w>x<h>+<x>+<y>", as written by makeWindowState() */
+static Bool parseGeometry(const char *str, WSavedState *state)
+{
+	long value[4];
+	char *end;
+	int i;
+
+	for (i = 0; i < wlengthof(value); i++) {
+		value[i] = strtol(str, &end, 10);
+		if (end == str)
+			return False;
+
+		if (i < wlengthof(value) - 1 && *end != (i == 0 ? 'x' : '+'))
+			return False;
+		str = end + 1;
+	}
+
+	if (*end != '\0' || value[0] <= 0 || value[1] <= 0)
+		return False;
+
+	state->w = value[0];
+	state->h = value[1];
+	state->x = value[2];
+	state->y = value[3];
+
+	return True;
+}
+
 static WSavedState *getWindowState(virtual_screen *vscr, WMPropList *win_state)
 {
 	WSavedState *state = wmalloc(sizeof(WSavedState));
-	WMPropList *value, *sShortcutMask;
-	WMPropList *sWorkspace, *sShaded, *sMiniaturized, *sMaximized, *sHidden, *sGeometry;
-	WMPropList *sMarkKey;
-	char *tmp;
+	WMPropList *value;
+	char *tmp, *end;
 	unsigned mask;
 	int i;
 
-	sWorkspace = WMCreatePLString("Workspace");
 	state->workspace = -1;
 	value = WMGetFromPLDictionary(win_state, sWorkspace);
 	if (value && WMIsPLString(value)) {
 		tmp = WMGetFromPLString(value);
-		if (sscanf(tmp, "%i", &state->workspace) != 1) {
+		state->workspace = strtol(tmp, &end, 0) - 1;
+		if (end == tmp) {
 			state->workspace = -1;
 			for (i = 0; i < vscr->workspace.count; i++) {
 				if (strcmp(vscr->workspace.array[i]->name, tmp) == 0) {
@@ -388,39 +420,31 @@ static WSavedState *getWindowState(virtual_screen *vscr, WMPropList *win_state)
 					break;
 				}
 			}
-		} else {
-			state->workspace--;
 		}
 	}
 
-	sShaded = WMCreatePLString("Shaded");
 	value = WMGetFromPLDictionary(win_state, sShaded);
 	if (value != NULL)
 		state->shaded = getBool(value);
 
-	sMiniaturized = WMCreatePLString("Miniaturized");
 	value = WMGetFromPLDictionary(win_state, sMiniaturized);
 	if (value != NULL)
 		state->miniaturized = getBool(value);
 
-	sMaximized = WMCreatePLString("Maximized");
 	value = WMGetFromPLDictionary(win_state, sMaximized);
 	if (value != NULL)
 		state->maximized = getHex(value);
 
-	sHidden = WMCreatePLString("Hidden");
 	value = WMGetFromPLDictionary(win_state, sHidden);
 	if (value != NULL)
 		state->hidden = getBool(value);
 
-	sShortcutMask = WMCreatePLString("ShortcutMask");
 	value = WMGetFromPLDictionary(win_state, sShortcutMask);
 	if (value != NULL) {
 		mask = getInt(value);
 		state->window_shortcuts = mask;
 	}
 
-	sMarkKey = WMCreatePLString("MarkKey");
 	value = WMGetFromPLDictionary(win_state, sMarkKey);
 	if (value != NULL && WMIsPLString(value)) {
 		char *s = WMGetFromPLString(value);
@@ -428,11 +452,9 @@ static WSavedState *getWindowState(virtual_screen *vscr, WMPropList *win_state)
 			state->mark_key = wstrdup(s);
 	}
 
-	sGeometry = WMCreatePLString("Geometry");
 	value = WMGetFromPLDictionary(win_state, sGeometry);
 	if (value && WMIsPLString(value)) {
-		if (!(sscanf(WMGetFromPLString(value), "%ix%i+%i+%i",
-			     &state->w, &state->h, &state->x, &state->y) == 4 && (state->w > 0 && state->h > 0))) {
+		if (!parseGeometry(WMGetFromPLString(value), state)) {
 			state->w = 0;
 			state->h = 0;
 		}
@@ -441,38 +463,23 @@ static WSavedState *getWindowState(virtual_screen *vscr, WMPropList *win_state)
 	return state;
 }
 
-static inline int is_same(const char *x, const char *y)
-{
-	if ((x == NULL) && (y == NULL))
-		return 1;
-
-	if ((x == NULL) || (y == NULL))
-		return 0;
-
-	if (strcmp(x, y) == 0)
-		return 1;
-	else
-		return 0;
-}
-
 void wSessionRestoreState(virtual_screen *vscr)
 {
 	WSavedState *state;
 	char *instance, *class, *command;
 	WMPropList *win_info, *apps, *cmd, *value;
-	WMPropList *sApplications, *sCommand, *sName, *sDock;
 	pid_t pid;
 	int i, count;
 	WDock *dock;
-	WAppIcon *btn = NULL;
-	int j, n, found;
+	WAppIcon *btn;
+	int j, n;
 	char *tmp;
 
 	if (!w_global.session_state)
 		return;
 
+	make_keys();
 	WMPLSetCaseSensitive(True);
-	sApplications = WMCreatePLString("Applications");
 	apps = WMGetFromPLDictionary(w_global.session_state, sApplications);
 	if (!apps)
 		return;
@@ -481,9 +488,6 @@ void wSessionRestoreState(virtual_screen *vscr)
 	if (count == 0)
 		return;
 
-	sCommand = WMCreatePLString("Command");
-	sName = WMCreatePLString("Name");
-	sDock = WMCreatePLString("Dock");
 	for (i = 0; i < count; i++) {
 		win_info = WMGetFromPLArray(apps, i);
 
@@ -536,21 +540,11 @@ void wSessionRestoreState(virtual_screen *vscr)
 			}
 		}
 
-		found = 0;
-		if (dock != NULL) {
-			for (j = 0; j < dock->max_icons; j++) {
-				btn = dock->icon_array[j];
-				if (btn && is_same(instance, btn->wm_instance) &&
-				    is_same(class, btn->wm_class) &&
-				    is_same(command, btn->command) &&
-				    !btn->launching) {
-					found = 1;
-					break;
-				}
-			}
-		}
+		btn = NULL;
+		if (dock != NULL)
+			btn = wDockFindIconForCommand(dock, instance, class, command);
 
-		if (found) {
+		if (btn) {
 			wDockLaunchWithState(btn, state);
 		} else if ((pid = execCommand(vscr, command)) > 0) {
 			wWindowAddSavedState(instance, class, command, pid, state);
@@ -580,8 +574,8 @@ void wSessionRestoreLastWorkspace(virtual_screen *vscr)
 	if (!w_global.session_state)
 		return;
 
+	make_keys();
 	WMPLSetCaseSensitive(True);
-	sWorkspace = WMCreatePLString("Workspace");
 	wks = WMGetFromPLDictionary(w_global.session_state, sWorkspace);
 	if (!wks || !WMIsPLString(wks))
 		return;
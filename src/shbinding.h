@@ -88,7 +88,7 @@ unsigned int shLabelFor(const SHBinding *b, char *buf, unsigned int buflen);
 extern SHBinding wKeyBindings[WKBD_LAST];
 
 /* Runtime binding list accessor (F5-L): the derived list rebuilt by
- * shRebuildList. Read-only iteration by callers (e.g. wRootMenuBindShortcuts /
+ * shRebuildList. Read-only iteration by callers (e.g. rebindKeygrabs /
  * wRootMenuPerformShortcut) for keygrabs / fallback dispatch. */
 SHBinding *shGetBindings(void);
 
@@ -183,20 +183,7 @@ void CommitStackingForWindow(virtual_screen *vscr, WCoreWindow *frame)
 	}
 }
 
-/*
- *----------------------------------------------------------------------
- * wRaiseFrame--
- * 	Raises a frame taking the window level into account.
- *
- * Returns:
- * 	None
- *
- * Side effects:
- * 	Window stacking order and stacking list are changed.
- *
- *----------------------------------------------------------------------
- */
-void wRaiseFrame(virtual_screen *vscr, WCoreWindow *frame)
+static void raise_frame(virtual_screen *vscr, WCoreWindow *frame)
 {
 	WCoreWindow *wlist = frame;
 	int level = frame->stacking->window_level;
@@ -228,7 +215,7 @@ void wRaiseFrame(virtual_screen *vscr, WCoreWindow *frame)
 		wlist = wlist->stacking->under;
 	while (wlist && wlist != frame) {
 		if (wlist->stacking->child_of == frame) {
-			wRaiseFrame(vscr, wlist);
+			raise_frame(vscr, wlist);
 			goto again;
 		}
 		wlist = wlist->stacking->above;
@@ -263,6 +250,28 @@ void wRaiseFrame(virtual_screen *vscr, WCoreWindow *frame)
 	notifyStackChange(frame, "raise");
 }
 
+/*
+ *----------------------------------------------------------------------
+ * wRaiseFrame--
+ * 	Raises a frame taking the window level into account.
+ *
+ * Returns:
+ * 	None
+ *
+ * Side effects:
+ * 	Window stacking order and stacking list are changed.
+ *
+ *----------------------------------------------------------------------
+ */
+void wRaiseFrame(virtual_screen *vscr, WCoreWindow *frame)
+{
+	WStatsMark mark;
+
+	wStatsMarkStart(&mark);
+	raise_frame(vscr, frame);
+	wStatsSpanEnd(WSPAN_RAISE, &mark);
+}
+
 void wRaiseLowerFrame(virtual_screen *vscr, WCoreWindow *frame)
 {
 	if (!frame->stacking->above
@@ -29,6 +29,13 @@
 #ifdef USE_XSHAPE
 #include <X11/extensions/shape.h>
 #endif
+#ifdef USE_XSYNC
+#include <X11/extensions/sync.h>
+#endif
+#ifdef USE_POINTER_BARRIERS
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/XInput2.h>
+#endif
 #ifdef KEEP_XKB_LOCK_STATUS
 #include <X11/XKBlib.h>
 #endif
@@ -60,6 +67,7 @@
 #include "wmspec.h"
 #include "event.h"
 #include "switchmenu.h"
+#include "rootmenu.h"
 #ifdef USE_DOCK_XDND
 #include "xdnd.h"
 #endif
@@ -246,7 +254,10 @@ static char *atomNames[] = {
 
 	"WM_IGNORE_FOCUS_EVENTS",
 
-	"_WINDOWMAKER_MARK_KEY"
+	"_WINDOWMAKER_MARK_KEY",
+
+	"_NET_WM_SYNC_REQUEST",
+	"_NET_WM_SYNC_REQUEST_COUNTER"
 };
 
 static void startup_set_atoms(void)
@@ -308,6 +319,9 @@ static void startup_set_atoms(void)
 	w_global.atom.wm.ignore_focus_events = atom[21];
 	w_global.atom.wmaker.mark_key = atom[22];
 
+	w_global.atom.wm.sync_request = atom[23];
+	w_global.atom.wm.sync_request_counter = atom[24];
+
 #ifdef USE_DOCK_XDND
 	wXDNDInitializeAtoms();
 #endif
@@ -418,6 +432,27 @@ static void startup_set_defaults(void)
 	w_global.xext.shape.supported = XShapeQueryExtension(dpy, &w_global.xext.shape.event_base, &foo);
 #endif
 
+#ifdef USE_XSYNC
+	/* the alarms need the extension to be initialized on the client side too */
+	w_global.xext.sync.supported = XSyncQueryExtension(dpy, &w_global.xext.sync.event_base, &foo)
+		&& XSyncInitialize(dpy, &foo, &i);
+#endif
+
+#ifdef USE_POINTER_BARRIERS
+	{
+		int fixes_major = 0, fixes_minor = 0;
+		int xi_major = 2, xi_minor = 3;
+
+		/* barriers need XFixes 5.0, and their events XInput 2.3 */
+		w_global.xext.barrier.supported =
+			XFixesQueryExtension(dpy, &foo, &i)
+			&& XFixesQueryVersion(dpy, &fixes_major, &fixes_minor) && fixes_major >= 5
+			&& XQueryExtension(dpy, "XInputExtension", &w_global.xext.barrier.xi_opcode, &foo, &i)
+			&& XIQueryVersion(dpy, &xi_major, &xi_minor) == Success
+			&& (xi_major > 2 || (xi_major == 2 && xi_minor >= 3));
+	}
+#endif
+
 #ifdef USE_RANDR
 	{
 		int rr_major = 0, rr_minor = 0;
@@ -577,6 +612,7 @@ void StartUp(Bool defaultScreenOnly)
 		vscr->clip.icon = clip_icon_create(vscr);
 
 		set_screen_options(w_global.vscreens[j]);
+		wHotCornersUpdate(scr);
 
 		lastDesktop = wNETWMGetCurrentDesktopFromHint(wScreen[j]);
 
@@ -628,6 +664,9 @@ void StartUp(Bool defaultScreenOnly)
 	shRebuildList();
 	wKeyTreeRebuild();
 
+	for (j = 0; j < w_global.screen_count; j++)
+		rebindKeygrabs(w_global.vscreens[j]);
+
 #ifndef HAVE_INOTIFY
 	/* setup defaults file polling */
 	if (!wPreferences.flags.noupdates)
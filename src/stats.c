@@ -0,0 +1,439 @@
+/*
+ * awmaker - Abstracting Window Maker
+ *
+ * Fork of GNU Window Maker (GPL-2).
+ * Copyright (C) Alfredo K. Kojima, Dan Pascu, the Window Maker Team,
+ * and individual contributors; see LICENSE for full attribution.
+ * Fork modifications: Copyright (C) Rodolfo Garcia Penas (kix) <kix@kix.es>.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Event dispatch and hot path statistics.
+ *
+ * Every event going through DispatchEvent() is counted per event type,
+ * with the time spent handling it and the number of X requests issued
+ * meanwhile. A few expensive operations are measured the same way on
+ * their own. The times go into histograms with one bucket per power of
+ * two microseconds, so a stutter shows up as a count in a high bucket
+ * even when the average looks fine.
+ *
+ * Nothing is ever printed on its own: the "DumpStats" command (sent in a
+ * _WINDOWMAKER_COMMAND client message) writes everything to the Stats
+ * file in the state directory, and "ResetStats" starts over.
+ *
+ * Dispatches nest (handlers process pending events themselves), and the
+ * outer one includes the time of the inner ones.
+ *
+ * Debug builds also count the X round trips, see stats.h.
+ *
+ * The dump also tells the memory used by the managed windows, the icons,
+ * the images they keep and their pixmaps on the server. It is measured
+ * when dumping, by going through the windows and the object pools, so
+ * nothing needs to be counted meanwhile. The pixmap sizes are computed
+ * from the geometry of their owner rather than asked to the server.
+ *
+ * The decorations are counted by the way they were drawn, along with the
+ * bytes of the requests sent for them, to compare sending the rendered
+ * images with having the server draw them (see texture.c).
+ */
+
+#include "awconfig.h"
+
+#include <X11/Xlib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "WindowMaker.h"
+#include "window.h"
+#include "framewin.h"
+#include "icon.h"
+#include "miniwindow.h"
+#include "pool.h"
+#include "stats.h"
+
+/* [2^i, 2^(i+1)) microseconds, the first bucket also gets anything faster */
+#define STATS_BUCKETS	21
+
+typedef struct {
+	unsigned long count;
+	unsigned long requests;
+	unsigned long round_trips;
+	double total_us;
+	double max_us;
+	unsigned long histogram[STATS_BUCKETS];
+} WStatsEntry;
+
+/* core events by type, then one entry for all extension events */
+static WStatsEntry event_stats[LASTEvent + 1];
+static WStatsEntry span_stats[WSPAN_COUNT];
+static time_t stats_since;
+
+static struct {
+	unsigned long count;
+	unsigned long long bytes;
+} decoration_stats[WDECO_COUNT];
+
+static const char *const event_names[LASTEvent] = {
+	[KeyPress] = "KeyPress",
+	[KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress",
+	[ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify",
+	[EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify",
+	[FocusIn] = "FocusIn",
+	[FocusOut] = "FocusOut",
+	[KeymapNotify] = "KeymapNotify",
+	[Expose] = "Expose",
+	[GraphicsExpose] = "GraphicsExpose",
+	[NoExpose] = "NoExpose",
+	[VisibilityNotify] = "VisibilityNotify",
+	[CreateNotify] = "CreateNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[UnmapNotify] = "UnmapNotify",
+	[MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest",
+	[ReparentNotify] = "ReparentNotify",
+	[ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest",
+	[GravityNotify] = "GravityNotify",
+	[ResizeRequest] = "ResizeRequest",
+	[CirculateNotify] = "CirculateNotify",
+	[CirculateRequest] = "CirculateRequest",
+	[PropertyNotify] = "PropertyNotify",
+	[SelectionClear] = "SelectionClear",
+	[SelectionRequest] = "SelectionRequest",
+	[SelectionNotify] = "SelectionNotify",
+	[ColormapNotify] = "ColormapNotify",
+	[ClientMessage] = "ClientMessage",
+	[MappingNotify] = "MappingNotify",
+	[GenericEvent] = "GenericEvent"
+};
+
+static const char *const span_names[WSPAN_COUNT] = {
+	[WSPAN_MANAGE_WINDOW] = "manage window",
+	[WSPAN_PLACEMENT] = "placement",
+	[WSPAN_TEXTURE_RENDER] = "texture render",
+	[WSPAN_MENU_BUILD] = "root menu build",
+	[WSPAN_WORKSPACE_SWITCH] = "workspace switch",
+	[WSPAN_MOVE] = "move",
+	[WSPAN_RAISE] = "raise"
+};
+
+static unsigned long round_trips;
+
+#ifdef DEBUG
+static struct {
+	const char *file;
+	int line;
+} round_trip_site;
+
+/* 0 when not checking */
+static unsigned long round_trip_budget;
+static Bool round_trip_budget_read;
+
+void wStatsRoundTrip(const char *file, int line)
+{
+	round_trips++;
+	round_trip_site.file = file;
+	round_trip_site.line = line;
+}
+
+static void check_round_trip_budget(const char *name, unsigned long count)
+{
+	if (!round_trip_budget_read) {
+		const char *budget = getenv("WINDOWMAKER_ROUNDTRIP_BUDGET");
+		char *end;
+
+		round_trip_budget_read = True;
+		if (budget && *budget != '-') {
+			round_trip_budget = strtoul(budget, &end, 10);
+			if (*end != '\0')
+				round_trip_budget = 0;
+		}
+	}
+
+	if (round_trip_budget > 0 && count > round_trip_budget)
+		wwarning(_("%s did %lu X round trips, over the budget of %lu, the last one at %s:%d"),
+			 name, count, round_trip_budget, round_trip_site.file, round_trip_site.line);
+}
+#endif
+
+void wStatsMarkStart(WStatsMark *mark)
+{
+	clock_gettime(CLOCK_MONOTONIC, &mark->start);
+	mark->request = dpy ? NextRequest(dpy) : 0;
+	mark->round_trips = round_trips;
+}
+
+static void account(WStatsEntry *entry, const char *name, WStatsMark *mark)
+{
+	struct timespec now;
+	double us;
+	int bucket;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	us = (now.tv_sec - mark->start.tv_sec) * 1000000.0 + (now.tv_nsec - mark->start.tv_nsec) / 1000.0;
+
+	entry->count++;
+	entry->total_us += us;
+	if (us > entry->max_us)
+		entry->max_us = us;
+	if (dpy)
+		entry->requests += NextRequest(dpy) - mark->request;
+	entry->round_trips += round_trips - mark->round_trips;
+#ifdef DEBUG
+	check_round_trip_budget(name, round_trips - mark->round_trips);
+#else
+	/* Parameter only used for the round trips budget */
+	(void) name;
+#endif
+
+	for (bucket = 0; bucket < STATS_BUCKETS - 1 && us >= (2 << bucket); bucket++)
+		;
+	entry->histogram[bucket]++;
+}
+
+void wStatsEventEnd(XEvent *event, WStatsMark *mark)
+{
+	if (event->type >= 0 && event->type < LASTEvent && event_names[event->type])
+		account(&event_stats[event->type], event_names[event->type], mark);
+	else
+		account(&event_stats[LASTEvent], "extension event", mark);
+}
+
+void wStatsSpanEnd(WStatsSpan span, WStatsMark *mark)
+{
+	account(&span_stats[span], span_names[span], mark);
+}
+
+void wStatsDecorationSent(WStatsDecoration how, unsigned long decorations, size_t bytes)
+{
+	decoration_stats[how].count += decorations;
+	decoration_stats[how].bytes += bytes;
+}
+
+void wStatsReset(void)
+{
+	memset(event_stats, 0, sizeof(event_stats));
+	memset(span_stats, 0, sizeof(span_stats));
+	memset(decoration_stats, 0, sizeof(decoration_stats));
+	stats_since = time(NULL);
+}
+
+/* upper bound of the bucket holding the given fraction of the samples */
+static double percentile_us(WStatsEntry *entry, double fraction)
+{
+	unsigned long seen = 0, wanted;
+	int bucket;
+
+	wanted = entry->count * fraction;
+	for (bucket = 0; bucket < STATS_BUCKETS - 1; bucket++) {
+		seen += entry->histogram[bucket];
+		if (seen > wanted)
+			break;
+	}
+
+	if (bucket == STATS_BUCKETS - 1)
+		return entry->max_us;
+
+	return 2 << bucket;
+}
+
+static void print_entry(FILE *file, const char *name, WStatsEntry *entry)
+{
+	int bucket;
+
+	if (entry->count == 0)
+		return;
+
+	fprintf(file, "%-18s %9lu %11.1f %9.1f %9.0f %9.0f %11.1f %9.2f %9.2f ",
+		name, entry->count, entry->total_us / 1000.0, entry->total_us / entry->count,
+		percentile_us(entry, 0.50), percentile_us(entry, 0.99), entry->max_us,
+		(double) entry->requests / entry->count, (double) entry->round_trips / entry->count);
+
+	for (bucket = 0; bucket < STATS_BUCKETS; bucket++)
+		fprintf(file, " %lu", entry->histogram[bucket]);
+	fprintf(file, "\n");
+}
+
+typedef struct {
+	unsigned long count;
+	size_t bytes;
+} WMemoryUse;
+
+static size_t image_bytes(RImage *image)
+{
+	if (!image)
+		return 0;
+
+	return (size_t) image->width * image->height * (image->format == RRGBAFormat ? 4 : 3);
+}
+
+static size_t pixmap_bytes(Pixmap pixmap, int width, int height, int depth)
+{
+	if (pixmap == None || width <= 0 || height <= 0)
+		return 0;
+
+	if (depth > 16)
+		return (size_t) width * height * 4;
+	if (depth > 8)
+		return (size_t) width * height * 2;
+	return (size_t) width * height;
+}
+
+static void account_frame_pixmaps(void *object, void *data)
+{
+	WFrameWindow *fwin = (WFrameWindow *) object;
+	WMemoryUse *pixmaps = (WMemoryUse *) data;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		pixmaps->bytes += pixmap_bytes(fwin->title_back[i], fwin->width, fwin->top_width, fwin->depth);
+		pixmaps->bytes += pixmap_bytes(fwin->resizebar_back[i], fwin->width, fwin->bottom_width, fwin->depth);
+		pixmaps->bytes += pixmap_bytes(fwin->lbutton_back[i], fwin->btn_size, fwin->btn_size, fwin->depth);
+		pixmaps->bytes += pixmap_bytes(fwin->rbutton_back[i], fwin->btn_size, fwin->btn_size, fwin->depth);
+#ifdef XKB_BUTTON_HINT
+		pixmaps->bytes += pixmap_bytes(fwin->languagebutton_back[i], fwin->btn_size, fwin->btn_size, fwin->depth);
+#endif
+	}
+	pixmaps->count++;
+}
+
+/* data is { images, pixmaps } */
+static void account_icon(void *object, void *data)
+{
+	WIcon *icon = (WIcon *) object;
+	WMemoryUse *use = (WMemoryUse *) data;
+	int size = wPreferences.icon_size;
+	int depth = icon->vscr && icon->vscr->screen_ptr ? icon->vscr->screen_ptr->w_depth : 24;
+
+	if (icon->file_image) {
+		use[0].count++;
+		use[0].bytes += image_bytes(icon->file_image);
+	}
+
+	use[1].bytes += pixmap_bytes(icon->pixmap, size, size, depth);
+	use[1].bytes += pixmap_bytes(icon->mini_preview, size, size, depth);
+}
+
+static void print_memory_use(FILE *file, const char *name, unsigned long count, size_t bytes)
+{
+	fprintf(file, "%-18s %9lu %11.1f\n", name, count, bytes / 1024.0);
+}
+
+static void print_memory(FILE *file)
+{
+	WMemoryUse windows = { 0, 0 }, images = { 0, 0 }, pixmaps = { 0, 0 };
+	WMemoryUse icon_use[2];
+	WPool *pool;
+	int i;
+
+	fprintf(file, "\n%-18s %9s %11s\n", "# memory", "count", "KiB");
+
+	for (i = 0; i < w_global.vscreen_count; i++) {
+		virtual_screen *vscr = w_global.vscreens[i];
+		WWindow *wwin;
+
+		if (!vscr)
+			continue;
+
+		for (wwin = vscr->window.focused; wwin; wwin = wwin->prev) {
+			windows.count++;
+			windows.bytes += sizeof(WWindow) + sizeof(WMiniWindow);
+			if (wwin->miniwindow && wwin->miniwindow->net_icon_image) {
+				images.count++;
+				images.bytes += image_bytes(wwin->miniwindow->net_icon_image);
+			}
+		}
+	}
+
+	memset(icon_use, 0, sizeof(icon_use));
+	wPoolForEach(&wIconPool, account_icon, icon_use);
+	images.count += icon_use[0].count;
+	images.bytes += icon_use[0].bytes;
+
+	wPoolForEach(&wFrameWindowPool, account_frame_pixmaps, &pixmaps);
+	pixmaps.bytes += icon_use[1].bytes;
+
+	print_memory_use(file, "windows", windows.count, windows.bytes);
+	print_memory_use(file, "images", images.count, images.bytes);
+	print_memory_use(file, "server pixmaps", pixmaps.count + wIconPool.in_use, pixmaps.bytes);
+
+	fprintf(file, "\n%-18s %9s %11s %9s\n", "# pool", "in use", "KiB", "capacity");
+	for (pool = wPoolList(); pool; pool = pool->next)
+		fprintf(file, "%-18s %9lu %11.1f %9lu\n", pool->name, pool->in_use,
+			wPoolFootprint(pool) / 1024.0, pool->capacity);
+}
+
+static char *stats_file_name(void)
+{
+	char *filename;
+
+	filename = getenv("XDG_STATE_HOME");
+	if (filename)
+		filename = wstrappend(wexpandpath(filename), "/" PACKAGE_TARNAME "/Stats");
+	else
+		filename = wstrconcat(wusergnusteppath(), "/.AppInfo/" PACKAGE_TARNAME "/Stats");
+
+	return filename;
+}
+
+void wStatsDump(void)
+{
+	char *filename, since[64];
+	FILE *file;
+	int i;
+
+	filename = stats_file_name();
+	file = fopen(filename, "w");
+	if (!file) {
+		werror(_("could not write the statistics to %s"), filename);
+		wfree(filename);
+		return;
+	}
+
+	if (stats_since)
+		strftime(since, sizeof(since), "%Y-%m-%d %H:%M:%S", localtime(&stats_since));
+	else
+		strcpy(since, "startup");
+
+	fprintf(file, "# since %s\n", since);
+	fprintf(file, "# times in microseconds, except total in milliseconds; p50/p99 are bucket upper bounds\n");
+	fprintf(file, "# histogram buckets: [0, 2) [2, 4) [4, 8) ... [%d, inf) us\n", 1 << (STATS_BUCKETS - 1));
+#ifndef DEBUG
+	fprintf(file, "# round trips are only counted in debug builds\n");
+#endif
+	fprintf(file, "%-18s %9s %11s %9s %9s %9s %11s %9s %9s  %s\n",
+		"# event", "count", "total", "mean", "p50", "p99", "max", "requests", "trips", "histogram");
+
+	for (i = 0; i < LASTEvent; i++)
+		if (event_names[i])
+			print_entry(file, event_names[i], &event_stats[i]);
+	print_entry(file, "extension", &event_stats[LASTEvent]);
+
+	fprintf(file, "\n%-18s\n", "# span");
+	for (i = 0; i < WSPAN_COUNT; i++)
+		print_entry(file, span_names[i], &span_stats[i]);
+
+	fprintf(file, "\n%-18s %9s %11s %11s\n", "# decorations", "count", "KiB sent", "bytes each");
+	for (i = 0; i < WDECO_COUNT; i++) {
+		if (decoration_stats[i].count == 0)
+			continue;
+
+		fprintf(file, "%-18s %9lu %11.1f %11.0f\n", i == WDECO_XRENDER ? "xrender" : "image",
+			decoration_stats[i].count, decoration_stats[i].bytes / 1024.0,
+			(double) decoration_stats[i].bytes / decoration_stats[i].count);
+	}
+
+	print_memory(file);
+
+	fclose(file);
+
+	wmessage(_("statistics written to %s"), filename);
+	wfree(filename);
+}
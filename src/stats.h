@@ -0,0 +1,107 @@
+/*
+ * awmaker - Abstracting Window Maker
+ *
+ * Fork of GNU Window Maker (GPL-2).
+ * Copyright (C) Alfredo K. Kojima, Dan Pascu, the Window Maker Team,
+ * and individual contributors; see LICENSE for full attribution.
+ * Fork modifications: Copyright (C) Rodolfo Garcia Penas (kix) <kix@kix.es>.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef WMSTATS_H
+#define WMSTATS_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include <X11/Xlib.h>
+
+/* Expensive operations that get their own latency histogram */
+typedef enum {
+	WSPAN_MANAGE_WINDOW,
+	WSPAN_PLACEMENT,
+	WSPAN_TEXTURE_RENDER,
+	WSPAN_MENU_BUILD,
+	WSPAN_WORKSPACE_SWITCH,
+	WSPAN_MOVE,
+	WSPAN_RAISE,
+	WSPAN_COUNT
+} WStatsSpan;
+
+/* Where a measure started */
+typedef struct WStatsMark {
+	struct timespec start;
+	unsigned long request;		/* serial of the next X request */
+	unsigned long round_trips;
+} WStatsMark;
+
+void wStatsMarkStart(WStatsMark *mark);
+
+/* Account the dispatch of event, which started at mark */
+void wStatsEventEnd(XEvent *event, WStatsMark *mark);
+
+/* Account the span, which started at mark */
+void wStatsSpanEnd(WStatsSpan span, WStatsMark *mark);
+
+/* How a window decoration was drawn */
+typedef enum {
+	WDECO_IMAGE,			/* rendered here, and sent as an image */
+	WDECO_XRENDER,			/* drawn by the server */
+	WDECO_COUNT
+} WStatsDecoration;
+
+/* Account decorations drawn, and bytes sent to the server for them */
+void wStatsDecorationSent(WStatsDecoration how, unsigned long decorations, size_t bytes);
+
+void wStatsReset(void);
+
+/* Write the counters and histograms to the Stats file */
+void wStatsDump(void);
+
+#ifdef DEBUG
+/*
+ * In debug builds, the Xlib calls that wait for a reply from the server
+ * are counted, so that the round trips of each event type and span show up
+ * in the statistics. When WINDOWMAKER_ROUNDTRIP_BUDGET is set in the
+ * environment, any event or span doing more round trips than that gets a
+ * warning naming the last call site.
+ */
+void wStatsRoundTrip(const char *file, int line);
+
+/* the prototypes must be seen before the macros */
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#define W_ROUND_TRIP()	wStatsRoundTrip(__FILE__, __LINE__)
+
+#define XSync(d, discard) \
+	(W_ROUND_TRIP(), XSync(d, discard))
+#define XQueryPointer(d, w, root, child, rx, ry, wx, wy, mask) \
+	(W_ROUND_TRIP(), XQueryPointer(d, w, root, child, rx, ry, wx, wy, mask))
+#define XGetWindowAttributes(d, w, attr) \
+	(W_ROUND_TRIP(), XGetWindowAttributes(d, w, attr))
+#define XGetGeometry(d, w, root, x, y, width, height, border, depth) \
+	(W_ROUND_TRIP(), XGetGeometry(d, w, root, x, y, width, height, border, depth))
+#define XTranslateCoordinates(d, src, dest, sx, sy, dx, dy, child) \
+	(W_ROUND_TRIP(), XTranslateCoordinates(d, src, dest, sx, sy, dx, dy, child))
+#define XGetWindowProperty(d, w, prop, off, len, del, req, type, format, n, after, data) \
+	(W_ROUND_TRIP(), XGetWindowProperty(d, w, prop, off, len, del, req, type, format, n, after, data))
+#define XQueryTree(d, w, root, parent, children, n) \
+	(W_ROUND_TRIP(), XQueryTree(d, w, root, parent, children, n))
+#define XGetInputFocus(d, focus, revert) \
+	(W_ROUND_TRIP(), XGetInputFocus(d, focus, revert))
+#define XInternAtom(d, name, only_if_exists) \
+	(W_ROUND_TRIP(), XInternAtom(d, name, only_if_exists))
+#define XGetTransientForHint(d, w, prop) \
+	(W_ROUND_TRIP(), XGetTransientForHint(d, w, prop))
+#define XGetWMNormalHints(d, w, hints, supplied) \
+	(W_ROUND_TRIP(), XGetWMNormalHints(d, w, hints, supplied))
+#define XGetWMHints(d, w) \
+	(W_ROUND_TRIP(), XGetWMHints(d, w))
+#define XGetClassHint(d, w, hint) \
+	(W_ROUND_TRIP(), XGetClassHint(d, w, hint))
+#define XFetchName(d, w, name) \
+	(W_ROUND_TRIP(), XFetchName(d, w, name))
+#endif /* DEBUG */
+
+#endif /* WMSTATS_H */
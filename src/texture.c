@@ -12,6 +12,11 @@
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/Xproto.h>
+#ifdef USE_XRENDER
+#include <X11/extensions/Xrender.h>
+#include <X11/extensions/renderproto.h>
+#endif
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -20,12 +25,15 @@
 #include <wraster.h>
 
 #include "WindowMaker.h"
+#include "screen.h"
 #include "texture.h"
 #include "window.h"
 #include "misc.h"
+#include "stats.h"
 
 
 static void bevelImage(RImage *image, int relief);
+static RImage *renderTextureImage(WTexture *texture, int width, int height, int relief, Bool tell_reason);
 static RImage *get_texture_image(virtual_screen *vscr, const char *pixmap_file);
 static WTexture *parse_texture(virtual_screen *vscr, WMPropList *pl);
 
@@ -351,6 +359,27 @@ static RImage *get_texture_image(virtual_screen *vscr, const char *pixmap_file)
 }
 
 RImage *wTextureRenderImage(WTexture *texture, int width, int height, int relief)
+{
+	RImage *image;
+	WStatsMark mark;
+
+	wStatsMarkStart(&mark);
+	image = renderTextureImage(texture, width, height, relief, True);
+	wStatsSpanEnd(WSPAN_TEXTURE_RENDER, &mark);
+
+	return image;
+}
+
+RImage *wTextureRenderImageNoStats(WTexture *texture, int width, int height, int relief)
+{
+	return renderTextureImage(texture, width, height, relief, False);
+}
+
+/*
+ * The reason of a failure is only told from the main thread: RErrorCode
+ * is shared by all the threads, and the render workers would race on it.
+ */
+static RImage *renderTextureImage(WTexture *texture, int width, int height, int relief, Bool tell_reason)
 {
 	RImage *image = NULL;
 	RColor color1;
@@ -459,7 +488,10 @@ RImage *wTextureRenderImage(WTexture *texture, int width, int height, int relief
 	if (!image) {
 		RColor gray;
 
-		wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
+		if (tell_reason)
+			wwarning(_("could not render texture: %s"), RMessageForError(RErrorCode));
+		else
+			wwarning(_("could not render texture"));
 
 		image = RCreateImage(width, height, False);
 		if (image == NULL) {
@@ -610,6 +642,437 @@ void wDrawBevel_resizebar(Drawable d, unsigned width, unsigned height, WTexSolid
 #endif
 }
 
+/* bytes of an image of the given size, as sent by XPutImage() */
+static size_t image_request_bytes(int width, int height, int depth)
+{
+	int bpp = depth > 16 ? 32 : (depth > 8 ? 16 : 8);
+
+	return sz_xCreatePixmapReq + sz_xPutImageReq + (size_t) ((width * bpp + 31) / 32) * 4 * height;
+}
+
+Bool wTextureConvertImage(WScreen *scr, RImage *image, Pixmap *pixmap)
+{
+	if (!RConvertImage(scr->rcontext, image, pixmap))
+		return False;
+
+	/* an upper bound, MIT-SHM avoids sending the pixels on a local display */
+	wStatsDecorationSent(WDECO_IMAGE, 0, image_request_bytes(image->width, image->height, scr->w_depth));
+
+	return True;
+}
+
+#ifdef USE_XRENDER
+/*
+ * Decorations drawn by the server.
+ *
+ * Converting the image of a decoration sends every pixel of it to the
+ * server, and that dominates the cost of a titlebar on a remote or large
+ * display. With XRender, the solid and gradient textures and the bevels
+ * drawn over them are described to the server in a few small requests
+ * instead: the gradients are linear gradient pictures, and the lines of
+ * the bevels are added to the pixels with PictOpAdd, or subtracted by
+ * adding to their inverse.
+ *
+ * That needs a TrueColor visual with 8 bits per channel, and XRender
+ * 0.10 for the gradients. The other textures, and the other visuals, go
+ * through wTextureRenderImage() as before, and so does everything when
+ * WINDOWMAKER_NO_XRENDER is set in the environment, to compare both.
+ */
+static void render_sent(size_t bytes)
+{
+	wStatsDecorationSent(WDECO_XRENDER, 0, bytes);
+}
+
+void wTextureInitRender(WScreen *scr)
+{
+	int event_base, error_base, major = 0, minor = 0;
+	XRenderPictFormat *format;
+	XGCValues gcv;
+
+	scr->render_format = NULL;
+
+	if (getenv("WINDOWMAKER_NO_XRENDER"))
+		return;
+
+	if (scr->w_visual->class != TrueColor || scr->w_depth < 24)
+		return;
+
+	if (!XRenderQueryExtension(dpy, &event_base, &error_base) ||
+	    !XRenderQueryVersion(dpy, &major, &minor) ||
+	    (major == 0 && minor < 10))
+		return;
+
+	format = XRenderFindVisualFormat(dpy, scr->w_visual);
+	if (!format || format->type != PictTypeDirect ||
+	    format->direct.redMask != 0xff || format->direct.greenMask != 0xff ||
+	    format->direct.blueMask != 0xff)
+		return;
+
+	gcv.function = GXinvert;
+	gcv.plane_mask = scr->w_visual->red_mask | scr->w_visual->green_mask | scr->w_visual->blue_mask;
+	gcv.graphics_exposures = False;
+	scr->render_invert_gc = XCreateGC(dpy, scr->w_win, GCFunction | GCPlaneMask | GCGraphicsExposures, &gcv);
+	scr->render_format = format;
+}
+
+static Picture create_picture(WScreen *scr, Pixmap pixmap)
+{
+	render_sent(sz_xRenderCreatePictureReq);
+	return XRenderCreatePicture(dpy, pixmap, scr->render_format, 0, NULL);
+}
+
+static void free_picture(Picture picture)
+{
+	render_sent(sz_xRenderFreePictureReq);
+	XRenderFreePicture(dpy, picture);
+}
+
+static void fill_rect(Picture picture, int op, unsigned short level, int x, int y, int width, int height)
+{
+	XRenderColor color;
+
+	color.red = color.green = color.blue = level * 257;
+	color.alpha = 0xffff;
+
+	render_sent(sz_xRenderFillRectanglesReq + sz_xRectangle);
+	XRenderFillRectangle(dpy, op, picture, &color, x, y, width, height);
+}
+
+/* the lines are horizontal or vertical, and include both ends */
+static void shade_line(WScreen *scr, Pixmap pixmap, Picture picture, int delta,
+		       int x1, int y1, int x2, int y2)
+{
+	int x = WMIN(x1, x2), y = WMIN(y1, y2);
+	int width = abs(x2 - x1) + 1, height = abs(y2 - y1) + 1;
+
+	if (delta >= 0) {
+		fill_rect(picture, PictOpAdd, delta, x, y, width, height);
+		return;
+	}
+
+	/* p - delta = ~(~p + delta), saturating like ROperateLine() does */
+	render_sent(2 * (sz_xPolyFillRectangleReq + sz_xRectangle));
+	XFillRectangle(dpy, pixmap, scr->render_invert_gc, x, y, width, height);
+	fill_rect(picture, PictOpAdd, -delta, x, y, width, height);
+	XFillRectangle(dpy, pixmap, scr->render_invert_gc, x, y, width, height);
+}
+
+static void black_line(Picture picture, int x1, int y1, int x2, int y2)
+{
+	fill_rect(picture, PictOpSrc, 0, WMIN(x1, x2), WMIN(y1, y2), abs(x2 - x1) + 1, abs(y2 - y1) + 1);
+}
+
+/* the same as RBevelImage() and bevelImage() */
+static void bevel_picture(WScreen *scr, Pixmap pixmap, Picture picture, int width, int height, int relief)
+{
+	int w = width, h = height;
+
+	switch (relief) {
+	case WREL_RAISED:
+		if (w < 3 || h < 3)
+			break;
+
+		shade_line(scr, pixmap, picture, 80, 0, 0, w - 1, 0);
+		shade_line(scr, pixmap, picture, 80, 0, 1, 0, h - 1);
+
+		shade_line(scr, pixmap, picture, -40, 0, h - 2, w - 3, h - 2);
+		black_line(picture, 0, h - 1, w - 1, h - 1);
+
+		shade_line(scr, pixmap, picture, -40, w - 2, 0, w - 2, h - 2);
+		black_line(picture, w - 1, 0, w - 1, h - 2);
+		break;
+
+	case WREL_MENUENTRY:
+		shade_line(scr, pixmap, picture, 80, 1, 0, w - 2, 0);
+		shade_line(scr, pixmap, picture, 80, 0, 0, 0, h - 1);
+
+		shade_line(scr, pixmap, picture, -40, w - 1, 0, w - 1, h - 1);
+		shade_line(scr, pixmap, picture, -40, 1, h - 2, w - 2, h - 2);
+
+		black_line(picture, 0, h - 1, w - 1, h - 1);
+		break;
+	}
+}
+
+static void fill_gradient(Picture picture, WTexGradient *gradient, int width, int height)
+{
+	XLinearGradient line;
+	XFixed stops[2];
+	XRenderColor colors[2];
+	XRenderPictureAttributes attr;
+	Picture source;
+	int type = gradient->type;
+	double k, length;
+
+	if (type == WTEX_DGRADIENT && width == 1)
+		type = WTEX_VGRADIENT;
+	else if (type == WTEX_DGRADIENT && height == 1)
+		type = WTEX_HGRADIENT;
+
+	/*
+	 * RRenderGradient() gives the color from + (to - from) * i / n to the
+	 * pixel i of n, so the gradient starts at the center of the first pixel.
+	 * Its diagonal gradients are a horizontal gradient of 2 * width - 1
+	 * pixels, shifted by (width - 1) / (height - 1) pixels on every line.
+	 */
+	line.p1.x = line.p1.y = XDoubleToFixed(0.5);
+	switch (type) {
+	case WTEX_HGRADIENT:
+		line.p2.x = XDoubleToFixed(width + 0.5);
+		line.p2.y = line.p1.y;
+		break;
+
+	case WTEX_VGRADIENT:
+		line.p2.x = line.p1.x;
+		line.p2.y = XDoubleToFixed(height + 0.5);
+		break;
+
+	default:
+		k = (double) (width - 1) / (height - 1);
+		length = (2 * width - 1) / (1 + k * k);
+		line.p2.x = XDoubleToFixed(0.5 + length);
+		line.p2.y = XDoubleToFixed(0.5 + k * length);
+		break;
+	}
+
+	stops[0] = XDoubleToFixed(0.0);
+	stops[1] = XDoubleToFixed(1.0);
+
+	colors[0].red = gradient->color1.red * 257;
+	colors[0].green = gradient->color1.green * 257;
+	colors[0].blue = gradient->color1.blue * 257;
+	colors[0].alpha = 0xffff;
+	colors[1].red = gradient->color2.red * 257;
+	colors[1].green = gradient->color2.green * 257;
+	colors[1].blue = gradient->color2.blue * 257;
+	colors[1].alpha = 0xffff;
+
+	source = XRenderCreateLinearGradient(dpy, &line, stops, colors, 2);
+	render_sent(sz_xRenderCreateLinearGradientReq + 2 * (sizeof(XFixed) + sz_xRenderColor));
+
+	/* the last pixels of the diagonal gradients are past its end */
+	attr.repeat = RepeatPad;
+	XRenderChangePicture(dpy, source, CPRepeat, &attr);
+	render_sent(sz_xRenderChangePictureReq + 4);
+
+	XRenderComposite(dpy, PictOpSrc, source, None, picture, 0, 0, 0, 0, 0, 0, width, height);
+	render_sent(sz_xRenderCompositeReq);
+
+	free_picture(source);
+}
+
+Bool wTextureServerRenders(WScreen *scr, WTexture *texture, int relief)
+{
+	if (!scr->render_format)
+		return False;
+
+	switch (texture->any.type) {
+	case WTEX_SOLID:
+	case WTEX_HGRADIENT:
+	case WTEX_VGRADIENT:
+	case WTEX_DGRADIENT:
+		break;
+	default:
+		return False;
+	}
+
+	return relief == WREL_FLAT || relief == WREL_RAISED || relief == WREL_MENUENTRY;
+}
+
+Pixmap wTextureRenderPixmap(WScreen *scr, WTexture *texture, int width, int height, int relief)
+{
+	WStatsMark mark;
+	Pixmap pixmap;
+	Picture picture;
+	XRenderColor color;
+
+	if (width <= 0 || height <= 0 || !wTextureServerRenders(scr, texture, relief))
+		return None;
+
+	wStatsMarkStart(&mark);
+
+	pixmap = XCreatePixmap(dpy, scr->w_win, width, height, scr->w_depth);
+	render_sent(sz_xCreatePixmapReq);
+	picture = create_picture(scr, pixmap);
+
+	if (texture->any.type == WTEX_SOLID) {
+		color.red = texture->solid.normal.red;
+		color.green = texture->solid.normal.green;
+		color.blue = texture->solid.normal.blue;
+		color.alpha = 0xffff;
+		XRenderFillRectangle(dpy, PictOpSrc, picture, &color, 0, 0, width, height);
+		render_sent(sz_xRenderFillRectanglesReq + sz_xRectangle);
+	} else {
+		fill_gradient(picture, &texture->gradient, width, height);
+	}
+
+	bevel_picture(scr, pixmap, picture, width, height, relief);
+	free_picture(picture);
+
+	wStatsSpanEnd(WSPAN_TEXTURE_RENDER, &mark);
+
+	return pixmap;
+}
+
+Pixmap wTextureCopyPixmap(WScreen *scr, Pixmap pixmap, int x, int y, int width, int height)
+{
+	Pixmap copy;
+
+	copy = XCreatePixmap(dpy, scr->w_win, width, height, scr->w_depth);
+	XCopyArea(dpy, pixmap, copy, scr->copy_gc, x, y, width, height, 0, 0);
+	render_sent(sz_xCreatePixmapReq + sz_xCopyAreaReq);
+
+	return copy;
+}
+
+void wTextureBevelPixmap(WScreen *scr, Pixmap pixmap, int width, int height, int relief)
+{
+	Picture picture;
+
+	picture = create_picture(scr, pixmap);
+	bevel_picture(scr, pixmap, picture, width, height, relief);
+	free_picture(picture);
+}
+
+void wTextureShadeLine(WScreen *scr, Pixmap pixmap, int delta, int x1, int y1, int x2, int y2)
+{
+	Picture picture;
+
+	picture = create_picture(scr, pixmap);
+	shade_line(scr, pixmap, picture, delta, x1, y1, x2, y2);
+	free_picture(picture);
+}
+
+void wTextureDrawBlackLine(WScreen *scr, Pixmap pixmap, int x1, int y1, int x2, int y2)
+{
+	Picture picture;
+
+	picture = create_picture(scr, pixmap);
+	black_line(picture, x1, y1, x2, y2);
+	free_picture(picture);
+}
+
+Bool wTextureBlendPixmap(WScreen *scr, Pixmap dest, Pixmap back, Pixmap over,
+			 int width, int height, int opacity)
+{
+	Picture dst, src, mask;
+	XRenderColor alpha;
+
+	if (!scr->render_format)
+		return False;
+
+	XSetClipMask(dpy, scr->copy_gc, None);
+	XCopyArea(dpy, back, dest, scr->copy_gc, 0, 0, width, height, 0, 0);
+	render_sent(sz_xCopyAreaReq);
+
+	dst = create_picture(scr, dest);
+	src = create_picture(scr, over);
+
+	/* the same as RCombineImagesWithOpaqueness(), over is opaque */
+	alpha.red = alpha.green = alpha.blue = 0;
+	alpha.alpha = opacity * 257;
+	mask = XRenderCreateSolidFill(dpy, &alpha);
+	render_sent(sz_xRenderCreateSolidFillReq);
+
+	XRenderComposite(dpy, PictOpOver, src, mask, dst, 0, 0, 0, 0, 0, 0, width, height);
+	render_sent(sz_xRenderCompositeReq);
+
+	free_picture(mask);
+	free_picture(src);
+	free_picture(dst);
+
+	return True;
+}
+
+#else /* !USE_XRENDER */
+
+void wTextureInitRender(WScreen *scr)
+{
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) scr;
+}
+
+Bool wTextureServerRenders(WScreen *scr, WTexture *texture, int relief)
+{
+	/* Parameters not used, but tell the compiler that it is ok */
+	(void) scr;
+	(void) texture;
+	(void) relief;
+
+	return False;
+}
+
+Pixmap wTextureRenderPixmap(WScreen *scr, WTexture *texture, int width, int height, int relief)
+{
+	/* Parameters not used, but tell the compiler that it is ok */
+	(void) scr;
+	(void) texture;
+	(void) width;
+	(void) height;
+	(void) relief;
+
+	return None;
+}
+
+Bool wTextureBlendPixmap(WScreen *scr, Pixmap dest, Pixmap back, Pixmap over,
+			 int width, int height, int opacity)
+{
+	/* Parameters not used, but tell the compiler that it is ok */
+	(void) scr;
+	(void) dest;
+	(void) back;
+	(void) over;
+	(void) width;
+	(void) height;
+	(void) opacity;
+
+	return False;
+}
+
+/* The functions below are only used on the pixmaps of wTextureRenderPixmap() */
+Pixmap wTextureCopyPixmap(WScreen *scr, Pixmap pixmap, int x, int y, int width, int height)
+{
+	(void) scr;
+	(void) pixmap;
+	(void) x;
+	(void) y;
+	(void) width;
+	(void) height;
+
+	return None;
+}
+
+void wTextureBevelPixmap(WScreen *scr, Pixmap pixmap, int width, int height, int relief)
+{
+	(void) scr;
+	(void) pixmap;
+	(void) width;
+	(void) height;
+	(void) relief;
+}
+
+void wTextureShadeLine(WScreen *scr, Pixmap pixmap, int delta, int x1, int y1, int x2, int y2)
+{
+	(void) scr;
+	(void) pixmap;
+	(void) delta;
+	(void) x1;
+	(void) y1;
+	(void) x2;
+	(void) y2;
+}
+
+void wTextureDrawBlackLine(WScreen *scr, Pixmap pixmap, int x1, int y1, int x2, int y2)
+{
+	(void) scr;
+	(void) pixmap;
+	(void) x1;
+	(void) y1;
+	(void) x2;
+	(void) y2;
+}
+#endif /* USE_XRENDER */
+
 WTexture *get_texture_from_defstruct(virtual_screen *vscr, defstructpl *ds)
 {
 	char *key;
@@ -159,7 +159,39 @@ WTexPixmap *wTextureMakePixmap(virtual_screen *vscr, int style, const char *pixm
 void wTextureDestroy(virtual_screen *vscr, WTexture *texture);
 struct RImage *wTextureRenderImage(WTexture *texture, int width, int height, int relief);
 
+/*
+ * The same without accounting the time in the statistics, which are not
+ * thread safe, nor telling why a render failed. Only the decorations
+ * rendered on the worker threads of framewin.c use it.
+ */
+struct RImage *wTextureRenderImageNoStats(WTexture *texture, int width, int height, int relief);
+
 void wDrawBevel(Drawable d, unsigned width, unsigned height, WTexSolid *texture, int relief);
 void wDrawBevel_resizebar(Drawable d, unsigned width, unsigned height, WTexSolid *texture, int corner_width);
 
+/* Convert a decoration rendered with wTextureRenderImage() to a pixmap */
+Bool wTextureConvertImage(WScreen *scr, struct RImage *image, Pixmap *pixmap);
+
+/*
+ * Decorations drawn by the server, see texture.c. wTextureRenderPixmap()
+ * returns None when the texture or the relief can not be drawn that way,
+ * and wTextureRenderImage() must be used instead.
+ */
+void wTextureInitRender(WScreen *scr);
+Bool wTextureServerRenders(WScreen *scr, WTexture *texture, int relief);
+Pixmap wTextureRenderPixmap(WScreen *scr, WTexture *texture, int width, int height, int relief);
+Pixmap wTextureCopyPixmap(WScreen *scr, Pixmap pixmap, int x, int y, int width, int height);
+void wTextureBevelPixmap(WScreen *scr, Pixmap pixmap, int width, int height, int relief);
+
+/* Add delta to the channels of the pixels of a line, or subtract it when negative */
+void wTextureShadeLine(WScreen *scr, Pixmap pixmap, int delta, int x1, int y1, int x2, int y2);
+void wTextureDrawBlackLine(WScreen *scr, Pixmap pixmap, int x1, int y1, int x2, int y2);
+
+/*
+ * Copy back to dest and draw over on it with the opacity, 0 to 255, by
+ * the server. False without XRender, and nothing is drawn then.
+ */
+Bool wTextureBlendPixmap(WScreen *scr, Pixmap dest, Pixmap back, Pixmap over,
+			 int width, int height, int opacity);
+
 #endif
@@ -18,15 +18,16 @@
 
 #include "WindowMaker.h"
 #include "wcore.h"
+#include "pool.h"
 
 WCoreWindow *wcore_create()
 {
-	return wmalloc(sizeof(WCoreWindow));
+	return wPoolAlloc(&wCoreWindowPool);
 }
 
 void wcore_destroy(WCoreWindow *core)
 {
-	wfree(core);
+	wPoolFree(&wCoreWindowPool, core);
 }
 
 void wcore_map_toplevel(WCoreWindow *core, virtual_screen *vscr, int x, int y,
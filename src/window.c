@@ -68,7 +68,16 @@
 #include "wmspec.h"
 
 /***** Local Stuff *****/
-static WWindowState *windowState = NULL;
+
+/*
+ * States saved for windows that are yet to be mapped, hashed by their
+ * instance, class and command, so that every new window does not get
+ * compared to all of the applications restored from the session.
+ */
+#define SAVED_STATE_BUCKETS	64	/* power of 2 */
+
+static WWindowState *windowState[SAVED_STATE_BUCKETS];
+static int windowStateCount;
 static void setFocusMode(WWindow *wwin);
 static int getSavedState(Window window, WSavedState **state);
 static void setupGNUstepHints(WWindow *wwin, GNUstepWMAttributes *gs_hints);
@@ -202,6 +211,8 @@ void wWindowDestroy(WWindow *wwin)
 
 	WMRemoveNotificationObserver(wwin);
 
+	wApplicationRemoveWindow(wwin);
+
 	wwin->flags.destroyed = 1;
 
 	for (i = 0; i < MAX_WINDOW_SHORTCUTS; i++) {
@@ -1513,9 +1524,6 @@ WWindow *wManageWindow(virtual_screen *vscr, Window window)
 
 	wWindowResetMouseGrabs(wwin);
 
-	if (!WFLAGP(wwin, no_bind_keys))
-		wWindowSetKeyGrabs(wwin);
-
 	WMPostNotificationName(WMNManaged, wwin, NULL);
 	wColormapInstallForWindow(vscr, vscr->screen_ptr->cmap_window);
 
@@ -1628,7 +1636,6 @@ WWindow *wManageInternalWindow(virtual_screen *vscr, Window window, Window owner
 
 	wSetFocusTo(vscr, wwin);
 	wWindowResetMouseGrabs(wwin);
-	wWindowSetKeyGrabs(wwin);
 
 	return wwin;
 }
@@ -1894,6 +1901,7 @@ void wWindowFocus(WWindow *wwin, WWindow *owin)
 	wwin->flags.focused = 1;
 
 	wWindowResetMouseGrabs(wwin);
+	updateKeygrabsFocus(wwin->vscr, wwin);
 
 	WMPostNotificationName(WMNChangedFocus, wwin, (void *)True);
 
@@ -2324,6 +2332,7 @@ void wWindowConfigure(WWindow *wwin, int req_x, int req_y, int req_width, int re
 /* req_x, req_y:  new position of the frame */
 void wWindowMove(WWindow *wwin, int req_x, int req_y)
 {
+	WStatsMark mark;
 #ifdef CONFIGURE_WINDOW_WHILE_MOVING
 	int synth_notify = False;
 
@@ -2335,6 +2344,8 @@ void wWindowMove(WWindow *wwin, int req_x, int req_y)
 	 * a completed (opaque) movement in moveres.c */
 #endif
 
+	wStatsMarkStart(&mark);
+
 	if (WFLAGP(wwin, dont_move_off))
 		wScreenBringInside(wwin->vscr, &req_x, &req_y,
 				   wwin->frame->width, wwin->frame->height);
@@ -2355,6 +2366,8 @@ void wWindowMove(WWindow *wwin, int req_x, int req_y)
 	if (synth_notify)
 		wWindowSynthConfigureNotify(wwin);
 #endif
+
+	wStatsSpanEnd(WSPAN_MOVE, &mark);
 }
 
 void wWindowUpdateButtonImages(WWindow *wwin)
@@ -2705,36 +2718,6 @@ static void setFocusMode(WWindow *wwin)
 	wwin->focus_mode = mode;
 }
 
-void wWindowSetKeyGrabs(WWindow * wwin)
-{
-	int i;
-	SHBinding *key;
-
-	for (i = 0; i < WKBD_LAST; i++) {
-		key = &wKeyBindings[i];
-
-		if (key->keycode == 0)
-			continue;
-		if (key->modifier != AnyModifier) {
-			XGrabKey(dpy, key->keycode, key->modifier | LockMask,
-				 wwin->frame->core->window, True, GrabModeAsync, GrabModeAsync);
-
-#ifdef NUMLOCK_HACK
-			/* Also grab all modifier combinations possible that include,
-			 * LockMask, ScrollLockMask and NumLockMask, so that keygrabs
-			 * work even if the NumLock/ScrollLock key is on.
-			 */
-			wHackedGrabKey(dpy, key->keycode, key->modifier,
-				       wwin->frame->core->window, True, GrabModeAsync, GrabModeAsync);
-#endif
-		}
-		XGrabKey(dpy, key->keycode, key->modifier,
-			 wwin->frame->core->window, True, GrabModeAsync, GrabModeAsync);
-	}
-
-	wRootMenuBindShortcuts(wwin->frame->core->window);
-}
-
 void wWindowResetMouseGrabs(WWindow * wwin)
 {
 	/* Mouse grabs can't be done on the client window because of
@@ -2794,10 +2777,28 @@ void wWindowUpdateGNUstepAttr(WWindow * wwin, GNUstepWMAttributes * attr)
 	}
 }
 
+static unsigned int saved_state_hash(const char *instance, const char *class, const char *command)
+{
+	const char *fields[3] = { instance, class, command };
+	unsigned int hash = 2166136261U;
+	const char *p;
+	int i;
+
+	/* FNV-1a over the three fields, a missing one hashing like an empty one */
+	for (i = 0; i < wlengthof(fields); i++) {
+		if (fields[i])
+			for (p = fields[i]; *p; p++)
+				hash = (hash ^ (unsigned char) *p) * 16777619U;
+		hash = (hash ^ '\n') * 16777619U;
+	}
+
+	return hash;
+}
+
 void wWindowAddSavedState(const char *instance, const char *class,
 			  const char *command, pid_t pid, WSavedState * state)
 {
-	WWindowState *wstate;
+	WWindowState *wstate, **chain;
 
 	wstate = malloc(sizeof(WWindowState));
 	if (!wstate)
@@ -2813,8 +2814,12 @@ void wWindowAddSavedState(const char *instance, const char *class,
 		wstate->command = wstrdup(command);
 
 	wstate->state = state;
-	wstate->next = windowState;
-	windowState = wstate;
+	wstate->hash = saved_state_hash(instance, class, command);
+
+	chain = &windowState[wstate->hash & (SAVED_STATE_BUCKETS - 1)];
+	wstate->next = *chain;
+	*chain = wstate;
+	windowStateCount++;
 }
 
 static inline int is_same(const char *x, const char *y)
@@ -2834,9 +2839,10 @@ static inline int is_same(const char *x, const char *y)
 WMagicNumber wWindowGetSavedState(Window win)
 {
 	char *instance, *class, *command = NULL;
-	WWindowState *wstate = windowState;
+	WWindowState *wstate = NULL;
+	unsigned int hash;
 
-	if (!wstate)
+	if (windowStateCount == 0)
 		return NULL;
 
 	command = GetCommandForWindow(win);
@@ -2844,16 +2850,14 @@ WMagicNumber wWindowGetSavedState(Window win)
 		return NULL;
 
 	if (PropGetWMClass(win, &class, &instance)) {
-		while (wstate) {
-			if (is_same(instance, wstate->instance) &&
+		hash = saved_state_hash(instance, class, command);
+		for (wstate = windowState[hash & (SAVED_STATE_BUCKETS - 1)]; wstate; wstate = wstate->next) {
+			if (wstate->hash == hash &&
+			    is_same(instance, wstate->instance) &&
 			    is_same(class, wstate->class) &&
 			    is_same(command, wstate->command))
 				break;
-
-			wstate = wstate->next;
 		}
-	} else {
-		wstate = NULL;
 	}
 
 	if (command)
@@ -2866,51 +2870,42 @@ WMagicNumber wWindowGetSavedState(Window win)
 	return wstate;
 }
 
+static void unlink_saved_state(WWindowState **chain, WWindowState *wstate)
+{
+	*chain = wstate->next;
+	windowStateCount--;
+	release_wwindowstate(wstate);
+}
+
 void wWindowDeleteSavedState(WMagicNumber id)
 {
-	WWindowState *tmp, *wstate = (WWindowState *) id;
+	WWindowState **chain, *wstate = (WWindowState *) id;
 
-	if (!wstate || !windowState)
+	if (!wstate)
 		return;
 
-	tmp = windowState;
-	if (tmp == wstate) {
-		windowState = wstate->next;
-		release_wwindowstate(wstate);
-	} else {
-		while (tmp->next) {
-			if (tmp->next == wstate) {
-				tmp->next = wstate->next;
-				release_wwindowstate(wstate);
-				break;
-			}
-			tmp = tmp->next;
-		}
-	}
+	chain = &windowState[wstate->hash & (SAVED_STATE_BUCKETS - 1)];
+	while (*chain && *chain != wstate)
+		chain = &(*chain)->next;
+
+	if (*chain)
+		unlink_saved_state(chain, wstate);
 }
 
 void wWindowDeleteSavedStatesForPID(pid_t pid)
 {
-	WWindowState *tmp, *wstate;
+	WWindowState **chain;
+	int i;
 
-	if (!windowState)
+	if (windowStateCount == 0)
 		return;
 
-	tmp = windowState;
-	if (tmp->pid == pid) {
-		wstate = windowState;
-		windowState = tmp->next;
-
-		release_wwindowstate(wstate);
-	} else {
-		while (tmp->next) {
-			if (tmp->next->pid == pid) {
-				wstate = tmp->next;
-				tmp->next = wstate->next;
-				release_wwindowstate(wstate);
-				break;
+	for (i = 0; i < SAVED_STATE_BUCKETS; i++) {
+		for (chain = &windowState[i]; *chain; chain = &(*chain)->next) {
+			if ((*chain)->pid == pid) {
+				unlink_saved_state(chain, *chain);
+				return;
 			}
-			tmp = tmp->next;
 		}
 	}
 }
@@ -147,6 +147,8 @@ typedef struct {
     unsigned int SAVE_YOURSELF:1;
     /* WindowMaker specific */
     unsigned int MINIATURIZE_WINDOW:1;
+    /* Extended Window Manager Hints */
+    unsigned int SYNC_REQUEST:1;
 } WProtocols;
 
 
@@ -169,6 +171,10 @@ typedef struct WWindow {
 	struct WWindow *prev;			/* window focus list */
 	struct WWindow *next;
 
+	struct WApplication *app;		/* application the window is listed in */
+	struct WWindow *app_prev;		/* application window list, in */
+	struct WWindow *app_next;		/* the focus list order */
+
 	unsigned int width;			/* current width */
 	unsigned int height;			/* current heiht */
 
@@ -321,7 +327,8 @@ typedef struct WWindowState {
     char *command;
     pid_t pid;
     WSavedState *state;
-    struct WWindowState *next;
+    unsigned int hash;		       /* of instance, class and command */
+    struct WWindowState *next;	       /* in the same hash bucket */
 } WWindowState;
 
 typedef void* WMagicNumber;
@@ -366,7 +373,6 @@ void wWindowChangeWorkspace(WWindow *wwin, int workspace);
 void window_move_next_workspace(WWindow *wwin);
 void window_move_prev_workspace(WWindow *wwin);
 
-void wWindowSetKeyGrabs(WWindow *wwin);
 void wWindowResetMouseGrabs(WWindow *wwin);
 
 WWindow *wManageWindow(virtual_screen *vscr, Window window);
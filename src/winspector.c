@@ -39,6 +39,7 @@
 #include "misc.h"
 #include "switchmenu.h"
 #include "miniwindow.h"
+#include "rootmenu.h"
 
 #include <WINGs/WUtil.h>
 
@@ -741,12 +742,8 @@ static void applySettings(WMWidget *button, void *client_data)
 			WMPostNotificationName(WMNChangedState, wwin_inspected, "omnipresent");
 	}
 
-	if (WFLAGP(wwin_inspected, no_bind_keys) != old_no_bind_keys) {
-		if (WFLAGP(wwin_inspected, no_bind_keys))
-			XUngrabKey(dpy, AnyKey, AnyModifier, wwin_inspected->frame->core->window);
-		else
-			wWindowSetKeyGrabs(wwin_inspected);
-	}
+	if (WFLAGP(wwin_inspected, no_bind_keys) != old_no_bind_keys && wwin_inspected->flags.focused)
+		updateKeygrabsFocus(wwin_inspected->vscr, wwin_inspected);
 
 	if (WFLAGP(wwin_inspected, no_bind_mouse) != old_no_bind_mouse)
 		wWindowResetMouseGrabs(wwin_inspected);
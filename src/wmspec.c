@@ -21,6 +21,7 @@
 
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
+#include <stdint.h>
 #include <string.h>
 
 #include <WINGs/WUtil.h>
@@ -221,7 +222,6 @@ static void updateCurrentWorkspace(virtual_screen *vscr);
 static void updateWorkspaceCount(virtual_screen *vscr);
 static void wNETWMShowingDesktop(virtual_screen *vscr, Bool show);
 static RImage *makeRImageFromARGBData(unsigned long *data);
-static RImage *findBestIcon(unsigned long *data, unsigned long items);
 
 typedef struct NetData {
 	WScreen *scr;
@@ -231,7 +231,8 @@ typedef struct NetData {
 
 static void setSupportedHints(WScreen *scr)
 {
-	Atom atom[wlengthof(atomNames)];
+	/* _NET_WM_SYNC_REQUEST is shared with the WM_PROTOCOLS code */
+	Atom atom[wlengthof(atomNames) + 1];
 	int i = 0;
 
 	/* set supported hints list */
@@ -303,6 +304,11 @@ static void setSupportedHints(WScreen *scr)
 
 	atom[i++] = net_frame_extents;
 
+#ifdef USE_XSYNC
+	if (w_global.xext.sync.supported)
+		atom[i++] = w_global.atom.wm.sync_request;
+#endif
+
 	atom[i++] = net_wm_name;
 	atom[i++] = net_wm_title;
 
@@ -357,16 +363,22 @@ int wNETWMGetCurrentDesktopFromHint(WScreen *scr)
 	return -1;
 }
 
-/* Find the best icon to be used by Window Maker for appicon/miniwindows. */
-static RImage *findBestIcon(unsigned long *data, unsigned long items)
+/*
+ * Below this many items, _NET_WM_ICON is fetched at once. Above, only the
+ * size of each image is fetched first, then the one image that is used.
+ * Applications animating their icon often set several large images in it.
+ */
+#define NET_ICON_FETCH_ALL	16384
+
+/* A _NET_WM_ICON image: width, height, then the ARGB pixels */
+typedef struct {
+	unsigned long *property;	/* what to XFree() */
+	unsigned long *icon;
+} WNetIcon;
+
+static int netIconWantedSize(void)
 {
 	int wanted;
-	int dx, dy, d;
-	int sx, sy, size;
-	int best_d, largest = 0;
-	unsigned long i, *icon;
-	RImage *src_image, *ret_image;
-	double f;
 
 	if (wPreferences.enforce_icon_margin) {
 		/* better use only 75% of icon_size. For 64x64 this means 48x48
@@ -382,18 +394,80 @@ static RImage *findBestIcon(unsigned long *data, unsigned long items)
 		wanted = wPreferences.icon_size;
 	}
 
-	/* try to find an icon which is close to the wanted size, but not larger */
-	icon = NULL;
+	return wanted;
+}
+
+static unsigned long *getNetIconItems(Window window, long offset, long length, unsigned long *items, unsigned long *rest)
+{
+	Atom type;
+	int format;
+	unsigned long *property;
+
+	if (XGetWindowProperty(dpy, window, net_wm_icon, offset, length,
+			       False, XA_CARDINAL, &type, &format, items, rest,
+			       (unsigned char **)&property) != Success || !property)
+		return NULL;
+
+	if (type != XA_CARDINAL || format != 32 || *items < 2) {
+		XFree(property);
+		return NULL;
+	}
+
+	return property;
+}
+
+/*
+ * Find the best icon to be used by Window Maker for appicon/miniwindows: one
+ * close to the wanted size but not larger, or else the largest one, for it
+ * usually looks better to scale down a large image by a large scale than a
+ * small image by a small scale.
+ */
+static Bool fetchBestIcon(Window window, int wanted, WNetIcon *net_icon)
+{
+	unsigned long *data, items, rest, total, offset;
+	unsigned long best = 0, largest = 0;
+	int dx, dy, d, sx, sy;
+	int best_d, largest_size = 0;
+	Bool found = False;
+
+	net_icon->property = NULL;
+	net_icon->icon = NULL;
+
+	data = getNetIconItems(window, 0L, 2L, &items, &rest);
+	if (!data)
+		return False;
+
+	/* rest is counted in 32-bit units on the server side */
+	total = items + rest / 4;
+	if (total <= NET_ICON_FETCH_ALL && rest > 0) {
+		XFree(data);
+		data = getNetIconItems(window, 0L, total, &items, &rest);
+		if (!data)
+			return False;
+		total = items;
+		net_icon->property = data;
+	}
+
 	best_d = wanted * wanted * 2;
-	for (i = 0L; i < items - 1;) {
+	for (offset = 0L; offset + 2 <= total;) {
 		/* get the current icon's size */
-		sx = (int) data[i];
-		sy = (int) data[i + 1];
+		if (net_icon->property) {
+			sx = (int) data[offset];
+			sy = (int) data[offset + 1];
+		} else {
+			if (offset > 0) {
+				data = getNetIconItems(window, offset, 2L, &items, &rest);
+				if (!data)
+					break;
+			}
+			sx = (int) data[0];
+			sy = (int) data[1];
+			XFree(data);
+		}
+
 		if (sx < 1 || sy < 1 || sx > 4096 || sy > 4096)
 			break;
-
-		size = sx * sy + 2;
-		if ((unsigned long) size > items - i)
+		if ((unsigned long) sx * sy + 2 > total - offset)
 			break;
 
 		/* check the size difference if it's not too large */
@@ -402,40 +476,85 @@ static RImage *findBestIcon(unsigned long *data, unsigned long items)
 			dy = wanted - sy;
 			d = (dx * dx) + (dy * dy);
 			if (d < best_d) {
-				icon = &data[i];
+				best = offset;
 				best_d = d;
+				found = True;
 			}
 		}
 
-		i += size;
+		if (sx * sy > largest_size) {
+			largest = offset;
+			largest_size = sx * sy;
+		}
+
+		offset += (unsigned long) sx * sy + 2;
 	}
 
-	/* if an icon has been found, no transformation is needed */
-	if (icon)
-		return makeRImageFromARGBData(icon);
+	/* give up if there's no icon to work with */
+	if (!found && largest_size == 0) {
+		if (net_icon->property)
+			XFree(net_icon->property);
+		net_icon->property = NULL;
+		return False;
+	}
 
-	/* We need to scale down an icon. Find the largest one, for it usually
-	 * looks better to scale down a large image by a large scale than a
-	 * small image by a small scale. */
-	for (i = 0L; i < items - 1;) {
-		size = (int) data[i] * (int) data[i + 1];
-		if (size == 0)
-			break;
+	if (!found)
+		best = largest;
 
-		if (size > largest) {
-			icon = &data[i];
-			largest = size;
-		}
+	if (net_icon->property) {
+		net_icon->icon = &net_icon->property[best];
+		return True;
+	}
+
+	/* fetch just the chosen image, the header was validated above */
+	data = getNetIconItems(window, best, 2L, &items, &rest);
+	if (!data)
+		return False;
+	sx = (int) data[0];
+	sy = (int) data[1];
+	XFree(data);
 
-		i += size + 2;
+	data = getNetIconItems(window, best, (long) sx * sy + 2, &items, &rest);
+	if (!data)
+		return False;
+	if (items != (unsigned long) sx * sy + 2) {
+		XFree(data);
+		return False;
 	}
 
-	/* give up if there's no icon to work with */
-	if (!icon)
-		return NULL;
+	net_icon->property = data;
+	net_icon->icon = data;
+
+	return True;
+}
+
+/*
+ * Tells if the application sets the same image again. The size it was
+ * chosen for is part of the hash, as the same data gives another image
+ * once the icon size changes.
+ */
+static unsigned long hashNetIcon(unsigned long *icon, int wanted)
+{
+	unsigned long i, count = icon[0] * icon[1] + 2;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	hash = (hash ^ (uint32_t) wanted) * 0x100000001b3ULL;
+	for (i = 0; i < count; i++)
+		hash = (hash ^ (uint32_t) icon[i]) * 0x100000001b3ULL;
+
+	return (unsigned long) hash;
+}
+
+static RImage *makeIconImage(unsigned long *icon, int wanted)
+{
+	RImage *src_image, *ret_image;
+	double f;
 
-	/* create a scaled down version of the icon */
 	src_image = makeRImageFromARGBData(icon);
+	if (!src_image || (src_image->width <= wanted && src_image->height <= wanted))
+		return src_image;
+
+	/* create a scaled down version of the icon */
 	if (src_image->width > src_image->height) {
 		f = (double) wanted / (double) src_image->width;
 		ret_image = RScaleImage(src_image, wanted, (int) (f * (double) (src_image->height)));
@@ -450,26 +569,31 @@ static RImage *findBestIcon(unsigned long *data, unsigned long items)
 
 static RImage *makeRImageFromARGBData(unsigned long *data)
 {
-	int size, width, height, i;
+	unsigned long size, i;
 	RImage *image;
-	unsigned char *imgdata;
-	unsigned long pixel;
-
-	width = data[0];
-	height = data[1];
-	size = width * height;
+	uint32_t *imgdata, pixel;
 
+	size = data[0] * data[1];
 	if (size == 0)
 		return NULL;
 
-	image = RCreateImage(width, height, True);
+	image = RCreateImage(data[0], data[1], True);
+	if (!image)
+		return NULL;
 
-	for (imgdata = image->data, i = 2; i < size + 2; i++, imgdata += 4) {
+	/*
+	 * One word per pixel, which the compiler can vectorize: swap R and B
+	 * of the ARGB value for the RGBA bytes of RImage
+	 */
+	imgdata = (uint32_t *) image->data;
+	data += 2;
+	for (i = 0; i < size; i++) {
 		pixel = data[i];
-		imgdata[3] = (pixel >> 24) & 0xff;	/* A */
-		imgdata[0] = (pixel >> 16) & 0xff;	/* R */
-		imgdata[1] = (pixel >> 8) & 0xff;	/* G */
-		imgdata[2] = (pixel >> 0) & 0xff;	/* B */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		imgdata[i] = (pixel << 8) | (pixel >> 24);
+#else
+		imgdata[i] = (pixel & 0xff00ff00) | ((pixel >> 16) & 0xff) | ((pixel & 0xff) << 16);
+#endif
 	}
 
 	return image;
@@ -478,25 +602,15 @@ static RImage *makeRImageFromARGBData(unsigned long *data)
 RImage *get_window_image_from_x11(Window window)
 {
 	RImage *image;
-	Atom type;
-	int format;
-	unsigned long items, rest;
-	unsigned long *property;
+	WNetIcon net_icon;
+	int wanted = netIconWantedSize();
 
 	/* Get the icon from X11 Window */
-	if (XGetWindowProperty(dpy, window, net_wm_icon, 0L, LONG_MAX,
-			       False, XA_CARDINAL, &type, &format, &items, &rest,
-			       (unsigned char **)&property) != Success || !property)
-		return NULL;
-
-	if (type != XA_CARDINAL || format != 32 || items < 2) {
-		XFree(property);
+	if (!fetchBestIcon(window, wanted, &net_icon))
 		return NULL;
-	}
 
-	/* Find the best icon */
-	image = findBestIcon(property, items);
-	XFree(property);
+	image = makeIconImage(net_icon.icon, wanted);
+	XFree(net_icon.property);
 	if (!image)
 		return NULL;
 
@@ -508,12 +622,36 @@ RImage *get_window_image_from_x11(Window window)
 
 static void updateIconImage(WWindow *wwin)
 {
+	WNetIcon net_icon;
+	unsigned long hash = 0;
+	int wanted = netIconWantedSize();
+
+	if (fetchBestIcon(wwin->client_win, wanted, &net_icon)) {
+		hash = hashNetIcon(net_icon.icon, wanted);
+
+		/* Nothing to do if the application set the same image again */
+		if (wwin->miniwindow->net_icon_image && hash == wwin->miniwindow->net_icon_hash) {
+			XFree(net_icon.property);
+			return;
+		}
+	} else if (!wwin->miniwindow->net_icon_image) {
+		return;
+	}
+
 	/* Remove the icon image from X11 */
 	if (wwin->miniwindow->net_icon_image)
 		RReleaseImage(wwin->miniwindow->net_icon_image);
+	wwin->miniwindow->net_icon_image = NULL;
+	wwin->miniwindow->net_icon_hash = hash;
 
 	/* Save the icon in the X11 icon */
-	wwin->miniwindow->net_icon_image = get_window_image_from_x11(wwin->client_win);
+	if (net_icon.property) {
+		wwin->miniwindow->net_icon_image = makeIconImage(net_icon.icon, wanted);
+		XFree(net_icon.property);
+		if (wwin->miniwindow->net_icon_image)
+			wwin->miniwindow->net_icon_image =
+				wIconValidateIconSize(wwin->miniwindow->net_icon_image, wPreferences.icon_size);
+	}
 
 	/* Refresh the Window Icon */
 	miniwindow_iconupdate(wwin);
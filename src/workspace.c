@@ -44,6 +44,7 @@
 #include "wsmap.h"
 #include "dialog.h"
 #include "miniwindow.h"
+#include "stats.h"
 
 #define MC_DESTROY_LAST 1
 #define MC_LAST_USED    2
@@ -276,13 +277,168 @@ Bool wWorkspaceDelete(virtual_screen *vscr, int workspace)
 	return True;
 }
 
+/*
+ * The workspace names, drawn with their outline, for the last
+ * WORKSPACE_NAME_GLYPHS names shown. Flipping through the workspaces
+ * shows the same few names over and over, and drawing one takes 26
+ * strings and a copy of the result back from the server.
+ */
+#define WORKSPACE_NAME_GLYPHS	16
+
+typedef struct WorkspaceNameGlyph {
+	struct WorkspaceNameGlyph *next;
+	char *name;
+	WMFont *font;
+	int width, height;		/* of the name, the pixmaps are 4 pixels larger */
+	Pixmap text;
+	Pixmap mask;
+	RImage *image;			/* of text, only made for fading without XRender */
+} WorkspaceNameGlyph;
+
 typedef struct WorkspaceNameData {
 	int count;
-	RImage *back;
-	RImage *text;
+	WorkspaceNameGlyph *glyph;
+	int width, height;
+
+	/* the screen under the name, and the name blended on it */
+	Pixmap back_pixmap;		/* with XRender */
+	Pixmap frame_pixmap;
+	RImage *back;			/* without it */
+	RImage *frame;
+
 	time_t timeout;
 } WorkspaceNameData;
 
+static void release_name_glyph(WorkspaceNameGlyph *glyph)
+{
+	XFreePixmap(dpy, glyph->text);
+	XFreePixmap(dpy, glyph->mask);
+	if (glyph->image)
+		RReleaseImage(glyph->image);
+	WMReleaseFont(glyph->font);
+	wfree(glyph->name);
+	wfree(glyph);
+}
+
+static WorkspaceNameGlyph *get_name_glyph(WScreen *scr, WMFont *font, const char *name)
+{
+	WorkspaceNameGlyph *glyph, **prev, **last = NULL;
+	int len = strlen(name);
+	int x, y, count = 0;
+
+	for (prev = &scr->workspace_name_glyphs; (glyph = *prev); prev = &glyph->next) {
+		if (glyph->font == font && strcmp(glyph->name, name) == 0) {
+			/* the most recent first */
+			*prev = glyph->next;
+			glyph->next = scr->workspace_name_glyphs;
+			scr->workspace_name_glyphs = glyph;
+
+			return glyph;
+		}
+		last = prev;
+		count++;
+	}
+
+	/*
+	 * Forget the least recent one. The one being shown, if any, was moved
+	 * to the head when shown, and is not the last.
+	 */
+	if (count >= WORKSPACE_NAME_GLYPHS) {
+		release_name_glyph(*last);
+		*last = NULL;
+	}
+
+	glyph = wmalloc(sizeof(WorkspaceNameGlyph));
+	glyph->name = wstrdup(name);
+	glyph->font = WMRetainFont(font);
+	glyph->width = WMWidthOfString(font, name, len);
+	glyph->height = WMFontHeight(font);
+
+	glyph->text = XCreatePixmap(dpy, scr->w_win, glyph->width + 4, glyph->height + 4, scr->w_depth);
+	glyph->mask = XCreatePixmap(dpy, scr->w_win, glyph->width + 4, glyph->height + 4, 1);
+
+	XFillRectangle(dpy, glyph->text, WMColorGC(scr->black), 0, 0, glyph->width + 4, glyph->height + 4);
+
+	for (x = 0; x <= 4; x++)
+		for (y = 0; y <= 4; y++)
+			WMDrawString(scr->wmscreen, glyph->text, scr->white, font, x, y, name, len);
+
+	XSetForeground(dpy, scr->mono_gc, 1);
+	XSetBackground(dpy, scr->mono_gc, 0);
+	XCopyPlane(dpy, glyph->text, glyph->mask, scr->mono_gc, 0, 0,
+		   glyph->width + 4, glyph->height + 4, 0, 0, 1 << (scr->w_depth - 1));
+	XSetBackground(dpy, scr->mono_gc, 1);
+	XFillRectangle(dpy, glyph->text, WMColorGC(scr->black), 0, 0, glyph->width + 4, glyph->height + 4);
+	WMDrawString(scr->wmscreen, glyph->text, scr->white, font, 2, 2, name, len);
+
+	glyph->next = scr->workspace_name_glyphs;
+	scr->workspace_name_glyphs = glyph;
+
+	return glyph;
+}
+
+/* Fading the name with XRender, the screen under it is copied by the server */
+static Bool server_fades_name(WScreen *scr)
+{
+#ifdef USE_XRENDER
+	return scr->render_format && scr->w_depth == scr->depth;
+#else
+	/* Parameter not used, but tell the compiler that it is ok */
+	(void) scr;
+
+	return False;
+#endif
+}
+
+static void release_name_back(WorkspaceNameData *data)
+{
+	if (data->back_pixmap)
+		XFreePixmap(dpy, data->back_pixmap);
+	if (data->frame_pixmap)
+		XFreePixmap(dpy, data->frame_pixmap);
+	if (data->back)
+		RReleaseImage(data->back);
+	if (data->frame)
+		RReleaseImage(data->frame);
+
+	data->back_pixmap = data->frame_pixmap = None;
+	data->back = data->frame = NULL;
+}
+
+static void release_name_data(WorkspaceNameData *data)
+{
+	release_name_back(data);
+	wfree(data);
+}
+
+static void fade_name(WScreen *scr, WorkspaceNameData *data, int opacity)
+{
+	Pixmap pix;
+
+	if (data->frame_pixmap) {
+		wTextureBlendPixmap(scr, data->frame_pixmap, data->back_pixmap, data->glyph->text,
+				    data->width, data->height, opacity);
+		XSetWindowBackgroundPixmap(dpy, scr->workspace_name, data->frame_pixmap);
+		XCopyArea(dpy, data->frame_pixmap, scr->workspace_name, scr->copy_gc,
+			  0, 0, data->width, data->height, 0, 0);
+		XFlush(dpy);
+		return;
+	}
+
+	/* the frame is reused for every step, instead of cloning the back */
+	memcpy(data->frame->data, data->back->data,
+	       (size_t) data->width * data->height * (data->back->format == RRGBAFormat ? 4 : 3));
+	RCombineImagesWithOpaqueness(data->frame, data->glyph->image, opacity);
+
+	if (!RConvertImage(scr->rcontext, data->frame, &pix))
+		return;
+
+	XSetWindowBackgroundPixmap(dpy, scr->workspace_name, pix);
+	XClearWindow(dpy, scr->workspace_name);
+	XFreePixmap(dpy, pix);
+	XFlush(dpy);
+}
+
 static void hideWorkspaceName(void *data)
 {
 	WScreen *scr = (WScreen *) data;
@@ -292,45 +448,70 @@ static void hideWorkspaceName(void *data)
 		XUnmapWindow(dpy, scr->workspace_name);
 
 		if (scr->workspace_name_data) {
-			RReleaseImage(scr->workspace_name_data->back);
-			RReleaseImage(scr->workspace_name_data->text);
-			wfree(scr->workspace_name_data);
-
+			release_name_data(scr->workspace_name_data);
 			scr->workspace_name_data = NULL;
 		}
 		scr->workspace_name_timer = NULL;
 	} else {
-		RImage *img = RCloneImage(scr->workspace_name_data->back);
-		Pixmap pix;
-
 		scr->workspace_name_timer = WMAddTimerHandler(WORKSPACE_NAME_FADE_DELAY, hideWorkspaceName, scr);
 
-		RCombineImagesWithOpaqueness(img, scr->workspace_name_data->text,
-					     scr->workspace_name_data->count * 255 / 10);
+		fade_name(scr, scr->workspace_name_data, scr->workspace_name_data->count * 255 / 10);
 
-		RConvertImage(scr->rcontext, img, &pix);
+		scr->workspace_name_data->count--;
+	}
+}
 
-		RReleaseImage(img);
+/* Keep what is under the name, to fade it out */
+static Bool grab_name_back(WScreen *scr, WorkspaceNameData *data, int px, int py)
+{
+	RXImage *ximg;
+	XGCValues gcv;
+	GC gc;
 
-		XSetWindowBackgroundPixmap(dpy, scr->workspace_name, pix);
-		XClearWindow(dpy, scr->workspace_name);
-		XFreePixmap(dpy, pix);
-		XFlush(dpy);
+	if (server_fades_name(scr)) {
+		if (!data->back_pixmap) {
+			data->back_pixmap = XCreatePixmap(dpy, scr->w_win, data->width, data->height, scr->w_depth);
+			data->frame_pixmap = XCreatePixmap(dpy, scr->w_win, data->width, data->height, scr->w_depth);
+		}
 
-		scr->workspace_name_data->count--;
+		gcv.subwindow_mode = IncludeInferiors;
+		gcv.graphics_exposures = False;
+		gc = XCreateGC(dpy, scr->root_win, GCSubwindowMode | GCGraphicsExposures, &gcv);
+		XCopyArea(dpy, scr->root_win, data->back_pixmap, gc, px, py, data->width, data->height, 0, 0);
+		XFreeGC(dpy, gc);
+
+		return True;
 	}
+
+	if (!data->glyph->image) {
+		data->glyph->image = RCreateImageFromDrawable(scr->rcontext, data->glyph->text, None);
+		if (!data->glyph->image)
+			return False;
+	}
+
+	ximg = RGetXImage(scr->rcontext, scr->root_win, px, py, data->width, data->height);
+	if (!ximg)
+		return False;
+
+	release_name_back(data);
+	data->back = RCreateImageFromXImage(scr->rcontext, ximg->image, NULL);
+	RDestroyXImage(scr->rcontext, ximg);
+
+	if (!data->back)
+		return False;
+
+	data->frame = RCloneImage(data->back);
+
+	return data->frame != NULL;
 }
 
 static void showWorkspaceName(virtual_screen *vscr, int workspace)
 {
+	WScreen *scr = vscr->screen_ptr;
 	WorkspaceNameData *data;
-	RXImage *ximg;
-	Pixmap text, mask;
+	WorkspaceNameGlyph *glyph;
 	int w, h;
 	int px, py;
-	char *name = vscr->workspace.array[workspace]->name;
-	int len = strlen(name);
-	int x, y;
 #ifdef USE_XINERAMA
 	int head;
 	WMRect rect;
@@ -340,35 +521,38 @@ static void showWorkspaceName(virtual_screen *vscr, int workspace)
 	if (wPreferences.workspace_name_display_position == WD_NONE || vscr->workspace.count < 2)
 		return;
 
-	if (vscr->screen_ptr->workspace_name_timer) {
-		WMDeleteTimerHandler(vscr->screen_ptr->workspace_name_timer);
-		XUnmapWindow(dpy, vscr->screen_ptr->workspace_name);
-		XFlush(dpy);
+	if (scr->workspace_name_timer) {
+		WMDeleteTimerHandler(scr->workspace_name_timer);
+		XUnmapWindow(dpy, scr->workspace_name);
 	}
 
-	vscr->screen_ptr->workspace_name_timer = WMAddTimerHandler(WORKSPACE_NAME_DELAY, hideWorkspaceName, vscr->screen_ptr);
+	scr->workspace_name_timer = WMAddTimerHandler(WORKSPACE_NAME_DELAY, hideWorkspaceName, scr);
 
-	if (vscr->screen_ptr->workspace_name_data) {
-		RReleaseImage(vscr->screen_ptr->workspace_name_data->back);
-		RReleaseImage(vscr->screen_ptr->workspace_name_data->text);
-		wfree(vscr->screen_ptr->workspace_name_data);
-	}
+	glyph = get_name_glyph(scr, vscr->workspace.font_for_name, vscr->workspace.array[workspace]->name);
+	w = glyph->width;
+	h = glyph->height;
 
-	data = wmalloc(sizeof(WorkspaceNameData));
-	data->back = NULL;
+	/* a name still fading out keeps its buffers when the new one is the same size */
+	data = scr->workspace_name_data;
+	if (data && (data->width != w + 4 || data->height != h + 4))
+		release_name_back(data);
+	else if (!data)
+		data = wmalloc(sizeof(WorkspaceNameData));
 
-	w = WMWidthOfString(vscr->workspace.font_for_name, name, len);
-	h = WMFontHeight(vscr->workspace.font_for_name);
+	scr->workspace_name_data = NULL;
+	data->glyph = glyph;
+	data->width = w + 4;
+	data->height = h + 4;
 
 #ifdef USE_XINERAMA
 	head = wGetHeadForPointerLocation(vscr);
-	rect = wGetRectForHead(vscr->screen_ptr, head);
-	if (vscr->screen_ptr->xine_info.count) {
-		xx = rect.pos.x + (vscr->screen_ptr->xine_info.screens[head].size.width - (w + 4)) / 2;
-		yy = rect.pos.y + (vscr->screen_ptr->xine_info.screens[head].size.height - (h + 4)) / 2;
+	rect = wGetRectForHead(scr, head);
+	if (scr->xine_info.count) {
+		xx = rect.pos.x + (scr->xine_info.screens[head].size.width - (w + 4)) / 2;
+		yy = rect.pos.y + (scr->xine_info.screens[head].size.height - (h + 4)) / 2;
 	} else {
-		xx = (vscr->screen_ptr->scr_width - (w + 4)) / 2;
-		yy = (vscr->screen_ptr->scr_height - (h + 4)) / 2;
+		xx = (scr->scr_width - (w + 4)) / 2;
+		yy = (scr->scr_height - (h + 4)) / 2;
 	}
 #endif
 
@@ -377,7 +561,7 @@ static void showWorkspaceName(virtual_screen *vscr, int workspace)
 #ifdef USE_XINERAMA
 		px = xx;
 #else
-		px = (vscr->screen_ptr->scr_width - (w + 4)) / 2;
+		px = (scr->scr_width - (w + 4)) / 2;
 #endif
 		py = WORKSPACE_NAME_DISPLAY_PADDING;
 		break;
@@ -385,25 +569,25 @@ static void showWorkspaceName(virtual_screen *vscr, int workspace)
 #ifdef USE_XINERAMA
 		px = xx;
 #else
-		px = (vscr->screen_ptr->scr_width - (w + 4)) / 2;
+		px = (scr->scr_width - (w + 4)) / 2;
 #endif
-		py = vscr->screen_ptr->scr_height - (h + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
+		py = scr->scr_height - (h + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
 		break;
 	case WD_TOPLEFT:
 		px = WORKSPACE_NAME_DISPLAY_PADDING;
 		py = WORKSPACE_NAME_DISPLAY_PADDING;
 		break;
 	case WD_TOPRIGHT:
-		px = vscr->screen_ptr->scr_width - (w + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
+		px = scr->scr_width - (w + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
 		py = WORKSPACE_NAME_DISPLAY_PADDING;
 		break;
 	case WD_BOTTOMLEFT:
 		px = WORKSPACE_NAME_DISPLAY_PADDING;
-		py = vscr->screen_ptr->scr_height - (h + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
+		py = scr->scr_height - (h + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
 		break;
 	case WD_BOTTOMRIGHT:
-		px = vscr->screen_ptr->scr_width - (w + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
-		py = vscr->screen_ptr->scr_height - (h + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
+		px = scr->scr_width - (w + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
+		py = scr->scr_height - (h + 4 + WORKSPACE_NAME_DISPLAY_PADDING);
 		break;
 	case WD_CENTER:
 	default:
@@ -411,88 +595,50 @@ static void showWorkspaceName(virtual_screen *vscr, int workspace)
 		px = xx;
 		py = yy;
 #else
-		px = (vscr->screen_ptr->scr_width - (w + 4)) / 2;
-		py = (vscr->screen_ptr->scr_height - (h + 4)) / 2;
+		px = (scr->scr_width - (w + 4)) / 2;
+		py = (scr->scr_height - (h + 4)) / 2;
 #endif
 		break;
 	}
 
-	XResizeWindow(dpy, vscr->screen_ptr->workspace_name, w + 4, h + 4);
-	XMoveWindow(dpy, vscr->screen_ptr->workspace_name, px, py);
-
-	text = XCreatePixmap(dpy, vscr->screen_ptr->w_win, w + 4, h + 4, vscr->screen_ptr->w_depth);
-	mask = XCreatePixmap(dpy, vscr->screen_ptr->w_win, w + 4, h + 4, 1);
-
-	XFillRectangle(dpy, text, WMColorGC(vscr->screen_ptr->black), 0, 0, w + 4, h + 4);
-
-	for (x = 0; x <= 4; x++)
-		for (y = 0; y <= 4; y++)
-			WMDrawString(vscr->screen_ptr->wmscreen, text, vscr->screen_ptr->white, vscr->workspace.font_for_name, x, y, name, len);
-
-	XSetForeground(dpy, vscr->screen_ptr->mono_gc, 1);
-	XSetBackground(dpy, vscr->screen_ptr->mono_gc, 0);
-	XCopyPlane(dpy, text, mask, vscr->screen_ptr->mono_gc, 0, 0, w + 4, h + 4, 0, 0, 1 << (vscr->screen_ptr->w_depth - 1));
-	XSetBackground(dpy, vscr->screen_ptr->mono_gc, 1);
-	XFillRectangle(dpy, text, WMColorGC(vscr->screen_ptr->black), 0, 0, w + 4, h + 4);
-	WMDrawString(vscr->screen_ptr->wmscreen, text, vscr->screen_ptr->white, vscr->workspace.font_for_name, 2, 2, name, len);
+	XResizeWindow(dpy, scr->workspace_name, w + 4, h + 4);
+	XMoveWindow(dpy, scr->workspace_name, px, py);
 
 #ifdef USE_XSHAPE
 	if (w_global.xext.shape.supported)
-		XShapeCombineMask(dpy, vscr->screen_ptr->workspace_name, ShapeBounding, 0, 0, mask, ShapeSet);
+		XShapeCombineMask(dpy, scr->workspace_name, ShapeBounding, 0, 0, glyph->mask, ShapeSet);
 #endif
-	XSetWindowBackgroundPixmap(dpy, vscr->screen_ptr->workspace_name, text);
-	XClearWindow(dpy, vscr->screen_ptr->workspace_name);
+	XSetWindowBackgroundPixmap(dpy, scr->workspace_name, glyph->text);
+	XClearWindow(dpy, scr->workspace_name);
 
-	data->text = RCreateImageFromDrawable(vscr->screen_ptr->rcontext, text, None);
-
-	XFreePixmap(dpy, text);
-	XFreePixmap(dpy, mask);
-
-	if (!data->text) {
-		XMapRaised(dpy, vscr->screen_ptr->workspace_name);
+	/* the window is not mapped yet, and does not show in the back */
+	if (!grab_name_back(scr, data, px, py)) {
+		XMapRaised(dpy, scr->workspace_name);
 		XFlush(dpy);
 
 		goto erro;
 	}
 
-	ximg = RGetXImage(vscr->screen_ptr->rcontext, vscr->screen_ptr->root_win, px, py, data->text->width, data->text->height);
-	if (!ximg)
-		goto erro;
-
-	XMapRaised(dpy, vscr->screen_ptr->workspace_name);
+	XMapRaised(dpy, scr->workspace_name);
 	XFlush(dpy);
 
-	data->back = RCreateImageFromXImage(vscr->screen_ptr->rcontext, ximg->image, NULL);
-	RDestroyXImage(vscr->screen_ptr->rcontext, ximg);
-
-	if (!data->back)
-		goto erro;
-
 	data->count = 10;
 
 	/* set a timeout for the effect */
 	data->timeout = time(NULL) + 2 + (WORKSPACE_NAME_DELAY + WORKSPACE_NAME_FADE_DELAY * data->count) / 1000;
 
-	vscr->screen_ptr->workspace_name_data = data;
+	scr->workspace_name_data = data;
 
 	return;
 
  erro:
-	if (vscr->screen_ptr->workspace_name_timer)
-		WMDeleteTimerHandler(vscr->screen_ptr->workspace_name_timer);
+	if (scr->workspace_name_timer)
+		WMDeleteTimerHandler(scr->workspace_name_timer);
 
-	if (data->text)
-		RReleaseImage(data->text);
+	release_name_data(data);
 
-	if (data->back)
-		RReleaseImage(data->back);
-
-	wfree(data);
-
-	vscr->screen_ptr->workspace_name_data = NULL;
-
-	vscr->screen_ptr->workspace_name_timer = WMAddTimerHandler(WORKSPACE_NAME_DELAY +
-						      10 * WORKSPACE_NAME_FADE_DELAY, hideWorkspaceName, vscr->screen_ptr);
+	scr->workspace_name_timer = WMAddTimerHandler(WORKSPACE_NAME_DELAY +
+						      10 * WORKSPACE_NAME_FADE_DELAY, hideWorkspaceName, scr);
 }
 
 void wWorkspaceChange(virtual_screen *vscr, int workspace)
@@ -532,18 +678,71 @@ void wWorkspaceRelativeChange(virtual_screen *vscr, int amount)
 	}
 }
 
+#ifdef DEBUG_WORKSPACE
+/* time spent in each phase of a workspace switch */
+static struct {
+	struct timespec last;
+	char text[256];
+	int length;
+} switch_trace;
+
+static void switch_trace_start(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &switch_trace.last);
+	switch_trace.text[0] = '\0';
+	switch_trace.length = 0;
+}
+
+static void switch_trace_lap(const char *phase)
+{
+	struct timespec now;
+	double ms;
+	int n;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (now.tv_sec - switch_trace.last.tv_sec) * 1000.0 +
+		(now.tv_nsec - switch_trace.last.tv_nsec) / 1000000.0;
+	switch_trace.last = now;
+
+	n = snprintf(switch_trace.text + switch_trace.length, sizeof(switch_trace.text) - switch_trace.length,
+		     " %s %.2f", phase, ms);
+	if (n > 0 && switch_trace.length + n < sizeof(switch_trace.text))
+		switch_trace.length += n;
+}
+
+#define SWITCH_TRACE_START()	switch_trace_start()
+#define SWITCH_TRACE(phase)	switch_trace_lap(phase)
+#define SWITCH_TRACE_END(workspace, mapped, unmapped) \
+	wmessage("workspace %d: mapped %d, unmapped %d, ms:%s", (workspace) + 1, mapped, unmapped, switch_trace.text)
+#else
+#define SWITCH_TRACE_START()
+#define SWITCH_TRACE(phase)
+#define SWITCH_TRACE_END(workspace, mapped, unmapped)
+#endif
+
 void wWorkspaceForceChange(virtual_screen *vscr, int workspace)
 {
 	WWindow *tmp, *foc = NULL, *foc2 = NULL;
-	int count, s1, s2;
+	WCoreWindow *core;
+	WMBagIterator iter;
+	WWindow **toMap, **toUnmap, **toMove;
+	int mapCount = 0, unmapCount = 0, moveCount = 0;
+	Bool icons_changed = False;
+	int count, s1, s2, i;
+	WStatsMark mark;
 
 	if (workspace >= MAX_WORKSPACES || workspace < 0)
 		return;
 
+	wStatsMarkStart(&mark);
+	SWITCH_TRACE_START();
+
 	if (wPreferences.enable_workspace_pager &&
 	    !vscr->workspace.process_map_event)
 		wWorkspaceMapUpdate(vscr);
 
+	SWITCH_TRACE("pager");
+
 	SendHelperMessage(vscr, 'C', workspace + 1, NULL);
 
 	if (workspace > vscr->workspace.count - 1) {
@@ -567,82 +766,111 @@ void wWorkspaceForceChange(virtual_screen *vscr, int workspace)
 	wWorkspaceMenuUpdate(vscr, vscr->workspace.menu);
 	wWorkspaceMenuUpdate_map(vscr);
 
+	SWITCH_TRACE("clip+menu");
+
 	tmp = vscr->window.focused;
 	if (tmp != NULL) {
-		WWindow **toUnmap;
-		int toUnmapSize, toUnmapCount;
-
 		if ((IS_OMNIPRESENT(tmp) && (tmp->flags.mapped || tmp->flags.shaded) &&
 		     !WFLAGP(tmp, no_focusable)) || tmp->flags.changing_workspace)
 			foc = tmp;
 
-		toUnmapSize = 16;
-		toUnmapCount = 0;
-		toUnmap = wmalloc(toUnmapSize * sizeof(WWindow *));
-
-		/* foc2 = tmp; will fix annoyance with gnome panel
+		/*
+		 * Choose the window to focus first, in focus order, from the
+		 * state the windows have before the switch.
+		 * foc2 = tmp; will fix annoyance with gnome panel
 		 * but will create annoyance for every other application
 		 */
-		while (tmp) {
+		for (; tmp; tmp = tmp->prev) {
 			if (tmp->frame->workspace != workspace && !tmp->flags.selected) {
-				/* unmap windows not on this workspace */
-				if ((tmp->flags.mapped || tmp->flags.shaded) &&
-				    !IS_OMNIPRESENT(tmp) && !tmp->flags.changing_workspace) {
-					if (toUnmapCount == toUnmapSize) {
-						toUnmapSize *= 2;
-						toUnmap = wrealloc(toUnmap, toUnmapSize * sizeof(WWindow *));
-					}
-
-					toUnmap[toUnmapCount++] = tmp;
-				}
-				/* also unmap miniwindows not on this workspace */
-				if (!wPreferences.sticky_icons && tmp->flags.miniaturized &&
-				    tmp->miniwindow->icon && !IS_OMNIPRESENT(tmp)) {
-					miniwindow_unmap(tmp);
-				}
+				if (IS_OMNIPRESENT(tmp) && !foc2 && (tmp->flags.mapped || tmp->flags.shaded))
+					foc2 = tmp;
+			} else if (tmp->flags.selected) {
+				if (!tmp->flags.miniaturized && !foc)
+					foc = tmp;
+			} else if (!tmp->flags.hidden && !(tmp->flags.mapped || tmp->flags.miniaturized)) {
+				if (!foc && !WFLAGP(tmp, no_focusable))
+					foc = tmp;
+			}
+		}
 
-				/* update current workspace of omnipresent windows */
-				if (IS_OMNIPRESENT(tmp)) {
-					WApplication *wapp = wApplicationOf(tmp->main_window);
+		/*
+		 * Sort the windows into the ones to map, to unmap and to move
+		 * here, walking the stacking list from the top so that the
+		 * sets come out in stacking order.
+		 */
+		toMap = wmalloc(3 * vscr->window_count * sizeof(WWindow *));
+		toUnmap = toMap + vscr->window_count;
+		toMove = toUnmap + vscr->window_count;
+
+		WM_ETARETI_BAG(vscr->screen_ptr->stacking_list, core, iter) {
+			for (; core; core = core->stacking->under) {
+				if (core->descriptor.parent_type != WCLASS_WINDOW)
+					continue;
+
+				tmp = core->descriptor.parent;
+
+				if (tmp->frame->workspace != workspace && !tmp->flags.selected) {
+					/* unmap windows not on this workspace */
+					if ((tmp->flags.mapped || tmp->flags.shaded) &&
+					    !IS_OMNIPRESENT(tmp) && !tmp->flags.changing_workspace)
+						toUnmap[unmapCount++] = tmp;
+
+					/* also unmap miniwindows not on this workspace */
+					if (!wPreferences.sticky_icons && tmp->flags.miniaturized &&
+					    tmp->miniwindow->icon && !IS_OMNIPRESENT(tmp)) {
+						miniwindow_unmap(tmp);
+						icons_changed = True;
+					}
 
-					tmp->frame->workspace = workspace;
+					/* update current workspace of omnipresent windows */
+					if (IS_OMNIPRESENT(tmp)) {
+						WApplication *wapp = wApplicationOf(tmp->main_window);
 
-					if (wapp)
-						wapp->last_workspace = workspace;
+						tmp->frame->workspace = workspace;
 
-					if (!foc2 && (tmp->flags.mapped || tmp->flags.shaded))
-						foc2 = tmp;
-				}
-			} else {
-				/* change selected windows' workspace */
-				if (tmp->flags.selected) {
-					wWindowChangeWorkspace(tmp, workspace);
-					if (!tmp->flags.miniaturized && !foc)
-						foc = tmp;
-
-				} else {
-					if (!tmp->flags.hidden) {
-						if (!(tmp->flags.mapped || tmp->flags.miniaturized)) {
-							/* remap windows that are on this workspace */
-							wWindowMap(tmp);
-							if (!foc && !WFLAGP(tmp, no_focusable))
-								foc = tmp;
-						}
-						/* Also map miniwindow if not omnipresent */
-						if (!wPreferences.sticky_icons &&
-						    tmp->flags.miniaturized && !IS_OMNIPRESENT(tmp) && tmp->miniwindow->icon) {
-							miniwindow_map(tmp);
-						}
+						if (wapp)
+							wapp->last_workspace = workspace;
+					}
+				} else if (tmp->flags.selected) {
+					/* change selected windows' workspace */
+					toMove[moveCount++] = tmp;
+				} else if (!tmp->flags.hidden) {
+					/* remap windows that are on this workspace */
+					if (!(tmp->flags.mapped || tmp->flags.miniaturized))
+						toMap[mapCount++] = tmp;
+
+					/* Also map miniwindow if not omnipresent */
+					if (!wPreferences.sticky_icons &&
+					    tmp->flags.miniaturized && !IS_OMNIPRESENT(tmp) && tmp->miniwindow->icon) {
+						miniwindow_map(tmp);
+						icons_changed = True;
 					}
 				}
 			}
-			tmp = tmp->prev;
 		}
 
-		while (toUnmapCount > 0)
-			wWindowUnmap(toUnmap[--toUnmapCount]);
+		SWITCH_TRACE("sort");
+
+		/*
+		 * Map the new windows from the top down, so that each one only
+		 * gets exposed where the ones above leave it visible, then unmap
+		 * the old ones from the bottom up, so that none of them gets
+		 * exposed just before going away.
+		 */
+		for (i = 0; i < mapCount; i++)
+			wWindowMap(toMap[i]);
+
+		for (i = 0; i < moveCount; i++) {
+			wWindowChangeWorkspace(toMove[i], workspace);
+			icons_changed = True;
+		}
+
+		for (i = unmapCount - 1; i >= 0; i--)
+			wWindowUnmap(toUnmap[i]);
 
-		wfree(toUnmap);
+		wfree(toMap);
+
+		SWITCH_TRACE("map");
 
 		/* Gobble up events unleashed by our mapping & unmapping.
 		 * These may trigger various grab-initiated focus &
@@ -654,6 +882,8 @@ void wWorkspaceForceChange(virtual_screen *vscr, int workspace)
 		ProcessPendingEvents();
 		vscr->screen_ptr->flags.ignore_focus_events = 0;
 
+		SWITCH_TRACE("events");
+
 		if (!foc)
 			foc = foc2;
 
@@ -702,16 +932,20 @@ void wWorkspaceForceChange(virtual_screen *vscr, int workspace)
 			else
 				wSetFocusTo(vscr, tmp);
 		}
+
+		SWITCH_TRACE("focus");
 	}
 
-	/* We need to always arrange icons when changing workspace, even if
-	 * no autoarrange icons, because else the icons in different workspaces
-	 * can be superposed.
-	 * This can be avoided if appicons are also workspace specific.
+	/* The icons need to be arranged again when some miniwindows came or
+	 * went with the workspace, else the icons in different workspaces can
+	 * be superposed. There is nothing to do when they did not change, as
+	 * the application icons do not depend on the workspace.
 	 */
-	if (!wPreferences.sticky_icons)
+	if (icons_changed && !wPreferences.sticky_icons)
 		wArrangeIcons(vscr, False);
 
+	SWITCH_TRACE("icons");
+
 	if (vscr->dock.dock) {
 		wIconPaint(vscr->dock.dock->icon_array[0]->icon);
 		wAppIconPaint(vscr->dock.dock->icon_array[0]);
@@ -726,11 +960,17 @@ void wWorkspaceForceChange(virtual_screen *vscr, int workspace)
 		wClipIconPaint(vscr->clip.icon);
 	}
 
-	wScreenUpdateUsableArea(vscr);
+	/* the usable areas do not depend on the workspace, they are updated
+	 * when the struts or the dock change */
 	wNETWMUpdateDesktop(vscr);
 	showWorkspaceName(vscr, workspace);
 
+	SWITCH_TRACE("decorations");
+
 	WMPostNotificationName(WMNWorkspaceChanged, vscr, (void *)(uintptr_t) workspace);
+
+	SWITCH_TRACE_END(workspace, mapCount, unmapCount);
+	wStatsSpanEnd(WSPAN_WORKSPACE_SWITCH, &mark);
 }
 
 static void switchWSCommand(WMenu *menu, WMenuEntry *entry)
@@ -11,6 +11,7 @@
 #include "awconfig.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "xinerama.h"
 
@@ -30,9 +31,16 @@
 #endif
 
 static Bool wAppIconTouchesHead(WAppIcon *aicon, int head);
+static void destroy_layout(WXineramaInfo *info);
+static void build_layout(WScreen *scr);
+static int find_relative_head(WScreen *scr, int current_head, int direction);
 
 void wInitXinerama(WScreen *scr)
 {
+	destroy_layout(&scr->xine_info);
+	if (scr->xine_info.screens)
+		wfree(scr->xine_info.screens);
+
 	scr->xine_info.primary_head = 0;
 	scr->xine_info.screens = NULL;
 	scr->xine_info.count = 0;
@@ -76,6 +84,165 @@ void wInitXinerama(WScreen *scr)
 	}
 # endif				/* !SOLARIS_XINERAMA */
 #endif				/* USE_XINERAMA */
+
+	build_layout(scr);
+}
+
+/*
+ * Head layout
+ *
+ * The edges of all the heads cut the screen into a grid of cells, each of
+ * them covered entirely by a head or by none. Finding the head under a
+ * point is then two binary searches on the edges and a lookup in the grid,
+ * which keeps the queries done on every pointer motion cheap whatever the
+ * number of monitors. The neighbour of each head in every direction is
+ * also computed once here, since the layout only changes with the heads.
+ */
+static int compare_ints(const void *a, const void *b)
+{
+	int ia = *(const int *)a;
+	int ib = *(const int *)b;
+
+	return (ia > ib) - (ia < ib);
+}
+
+/* sort the edges and remove the duplicates, return how many are left */
+static int sort_edges(int *edges, int count)
+{
+	int i, n;
+
+	qsort(edges, count, sizeof(int), compare_ints);
+
+	for (i = 1, n = 1; i < count; i++)
+		if (edges[i] != edges[n - 1])
+			edges[n++] = edges[i];
+
+	return n;
+}
+
+/* index of the edge equal to value, which must be present */
+static int find_edge(const int *edges, int count, int value)
+{
+	const int *found;
+
+	found = bsearch(&value, edges, count, sizeof(int), compare_ints);
+
+	return found ? (int)(found - edges) : -1;
+}
+
+/* index of the cell containing value between two edges, -1 if outside */
+static int find_cell(const int *edges, int count, int value)
+{
+	int lo, hi;
+
+	if (count < 2 || value < edges[0] || value >= edges[count - 1])
+		return -1;
+
+	lo = 0;
+	hi = count - 1;
+	while (hi - lo > 1) {
+		int mid = (lo + hi) / 2;
+
+		if (edges[mid] <= value)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void destroy_layout(WXineramaInfo *info)
+{
+	if (info->layout.x_edges)
+		wfree(info->layout.x_edges);
+	if (info->layout.y_edges)
+		wfree(info->layout.y_edges);
+	if (info->layout.cells)
+		wfree(info->layout.cells);
+	if (info->layout.neighbours)
+		wfree(info->layout.neighbours);
+
+	memset(&info->layout, 0, sizeof(info->layout));
+}
+
+static void build_layout(WScreen *scr)
+{
+	WXineramaInfo *info = &scr->xine_info;
+	int columns, rows;
+	int i, x, y;
+
+	if (info->count <= 0)
+		return;
+
+	info->layout.x_edges = wmalloc(sizeof(int) * info->count * 2);
+	info->layout.y_edges = wmalloc(sizeof(int) * info->count * 2);
+
+	for (i = 0; i < info->count; i++) {
+		info->layout.x_edges[2 * i] = info->screens[i].pos.x;
+		info->layout.x_edges[2 * i + 1] = info->screens[i].pos.x + info->screens[i].size.width;
+		info->layout.y_edges[2 * i] = info->screens[i].pos.y;
+		info->layout.y_edges[2 * i + 1] = info->screens[i].pos.y + info->screens[i].size.height;
+	}
+	info->layout.x_count = sort_edges(info->layout.x_edges, info->count * 2);
+	info->layout.y_count = sort_edges(info->layout.y_edges, info->count * 2);
+
+	columns = info->layout.x_count - 1;
+	rows = info->layout.y_count - 1;
+	info->layout.cells = wmalloc(sizeof(int) * (columns > 0 ? columns : 1) * (rows > 0 ? rows : 1));
+	for (i = 0; i < columns * rows; i++)
+		info->layout.cells[i] = -1;
+
+	/* the first head covering a cell owns it, like the linear scan did */
+	for (i = 0; i < info->count; i++) {
+		WMRect *rect = &info->screens[i];
+		int x1 = find_edge(info->layout.x_edges, info->layout.x_count, rect->pos.x);
+		int x2 = find_edge(info->layout.x_edges, info->layout.x_count, rect->pos.x + rect->size.width);
+		int y1 = find_edge(info->layout.y_edges, info->layout.y_count, rect->pos.y);
+		int y2 = find_edge(info->layout.y_edges, info->layout.y_count, rect->pos.y + rect->size.height);
+
+		for (y = y1; y < y2; y++) {
+			for (x = x1; x < x2; x++) {
+				if (info->layout.cells[y * columns + x] < 0)
+					info->layout.cells[y * columns + x] = i;
+				else
+					info->layout.overlapping = True;
+			}
+		}
+	}
+
+	info->layout.neighbours = wmalloc(sizeof(int) * info->count * 4);
+	for (i = 0; i < info->count; i++) {
+		info->layout.neighbours[4 * i + DIRECTION_LEFT] = find_relative_head(scr, i, DIRECTION_LEFT);
+		info->layout.neighbours[4 * i + DIRECTION_RIGHT] = find_relative_head(scr, i, DIRECTION_RIGHT);
+		info->layout.neighbours[4 * i + DIRECTION_UP] = find_relative_head(scr, i, DIRECTION_UP);
+		info->layout.neighbours[4 * i + DIRECTION_DOWN] = find_relative_head(scr, i, DIRECTION_DOWN);
+	}
+}
+
+/* head under the given point, -1 if it is in dead space */
+static int find_head_at(WXineramaInfo *info, int x, int y)
+{
+	int cx, cy;
+
+	if (!info->layout.cells)
+		return -1;
+
+	cx = find_cell(info->layout.x_edges, info->layout.x_count, x);
+	cy = find_cell(info->layout.y_edges, info->layout.y_count, y);
+	if (cx < 0 || cy < 0)
+		return -1;
+
+	return info->layout.cells[cy * (info->layout.x_count - 1) + cx];
+}
+
+static Bool rect_inside_head(WXineramaInfo *info, int head, int x, int y, int w, int h)
+{
+	WMRect *rect = &info->screens[head];
+
+	return (x >= rect->pos.x && y >= rect->pos.y &&
+		x + w <= rect->pos.x + (int) rect->size.width &&
+		y + h <= rect->pos.y + (int) rect->size.height);
 }
 
 int wGetRectPlacementInfo(virtual_screen *vscr, WMRect rect, int *flags)
@@ -110,6 +277,14 @@ int wGetRectPlacementInfo(virtual_screen *vscr, WMRect rect, int *flags)
 		return scr->xine_info.primary_head;
 	}
 
+	/* a rectangle inside a head that shares no pixel with another one */
+	if (!scr->xine_info.layout.overlapping && rw > 0 && rh > 0) {
+		best = find_head_at(&scr->xine_info, rx, ry);
+		if (best >= 0 && rect_inside_head(&scr->xine_info, best, rx, ry, rw, rh))
+			return best;
+		best = -1;
+	}
+
 	for (i = 0; i < wXineramaHeads(scr); i++) {
 		unsigned long a;
 
@@ -153,6 +328,16 @@ int wGetHeadForRect(virtual_screen *vscr, WMRect rect)
 	if (!scr->xine_info.count)
 		return scr->xine_info.primary_head;
 
+	/*
+	 * A rectangle entirely inside the head under its corner cannot be
+	 * covered more by another one, and that head is the first to cover it
+	 */
+	if (rw > 0 && rh > 0) {
+		best = find_head_at(&scr->xine_info, rx, ry);
+		if (best >= 0 && rect_inside_head(&scr->xine_info, best, rx, ry, rw, rh))
+			return best;
+	}
+
 	best = -1;
 	area = 0;
 
@@ -232,15 +417,11 @@ int wGetHeadForWindow(WWindow *wwin)
 int wGetHeadForPoint(virtual_screen *vscr, WMPoint point)
 {
 	WScreen *scr = vscr->screen_ptr;
-	int i;
+	int head;
 
-	for (i = 0; i < scr->xine_info.count; i++) {
-		WMRect *rect = &scr->xine_info.screens[i];
-
-		if ((unsigned)(point.x - rect->pos.x) < rect->size.width &&
-		    (unsigned)(point.y - rect->pos.y) < rect->size.height)
-			return i;
-	}
+	head = find_head_at(&scr->xine_info, point.x, point.y);
+	if (head >= 0)
+		return head;
 
 	return scr->xine_info.primary_head;
 }
@@ -346,12 +527,23 @@ WMPoint wGetPointToCenterRectInHead(virtual_screen *vscr, int head, int width, i
  * head. If there is no screen available on pointed direction, -1 will be
  * returned.*/
 int wGetHeadRelativeToCurrentHead(virtual_screen *vscr, int current_head, int direction)
+{
+	WScreen *scr = vscr->screen_ptr;
+
+	if (scr->xine_info.layout.neighbours &&
+	    current_head >= 0 && current_head < scr->xine_info.count &&
+	    direction >= DIRECTION_LEFT && direction <= DIRECTION_DOWN)
+		return scr->xine_info.layout.neighbours[4 * current_head + direction];
+
+	return find_relative_head(scr, current_head, direction);
+}
+
+static int find_relative_head(WScreen *scr, int current_head, int direction)
 {
 	short int found = 0;
 	int i;
 	int distance = 0;
 	int smallest_distance = 0;
-	WScreen *scr = vscr->screen_ptr;
 	int nearest_head = scr->xine_info.primary_head;
 	WMRect crect = wGetRectForHead(scr, current_head);
 
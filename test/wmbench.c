@@ -0,0 +1,492 @@
+/*
+ * awmaker - Abstracting Window Maker
+ *
+ * Fork of GNU Window Maker (GPL-2).
+ * Copyright (C) Alfredo K. Kojima, Dan Pascu, the Window Maker Team,
+ * and individual contributors; see LICENSE for full attribution.
+ * Fork modifications: Copyright (C) Rodolfo Garcia Penas (kix) <kix@kix.es>.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* window manager benchmark: plays a set of client storms against the window
+ *	manager running on $DISPLAY and reports how long the window manager
+ *	took to react, as latency percentiles per scenario.
+ *
+ * The scenarios, in the order they are run:
+ *	map		map the windows all at once, until each one is mapped
+ *	retitle		change the titles, in batches of 100
+ *	icon		change _NET_WM_ICON, in batches of 10
+ *	configure	resize the windows, 50 requests in flight
+ *	workspace	switch back and forth between the first two workspaces
+ *	unmap		unmap the windows all at once, until each one is released
+ *
+ * For the batches, the time is taken until the window manager answers a
+ * resize request sent after the batch; it handles the events in order, so
+ * it is done with the batch by then.
+ *
+ * The request count is the number of X requests the benchmark sent, the
+ * requests issued by the window manager itself are not visible from here.
+ *
+ * The window manager is asked to reset its statistics before the run and
+ * to write them out after it (the ResetStats and DumpStats commands), so
+ * its own view of the time spent per event type ends up in its Stats file.
+ *
+ * Run it through "make bench", which starts Xvfb and awmaker for it. The
+ * map and configure storms draw a titlebar and a resizebar per window, and
+ * "make bench-render" runs them with the decorations drawn by the server and
+ * then sent as images, so the bytes per decoration of both can be compared
+ * in the decorations section of the Stats file.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+
+#define TIMEOUT_MS	10000
+
+static Display *dpy;
+static Window root;
+static XContext context;
+
+static Atom net_wm_name, net_wm_icon, net_current_desktop, utf8_string;
+
+static struct client {
+	Window win;
+	double requested;	/* when the last request went out */
+	double answered;	/* when the window manager answered it, 0 until then */
+	int width;		/* expected width for a resize */
+} *clients;
+static int client_count = 500;
+
+static double desktop_changed;
+
+static struct {
+	const char *name;
+	double *samples;
+	int count;
+	double total;
+	unsigned long requests;
+	int timeouts;
+} result;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void handle_event(XEvent *ev)
+{
+	struct client *c;
+	XPointer data;
+
+	if (ev->type == PropertyNotify && ev->xproperty.window == root) {
+		if (ev->xproperty.atom == net_current_desktop)
+			desktop_changed = now_ms();
+		return;
+	}
+
+	if (XFindContext(dpy, ev->xany.window, context, &data) != 0)
+		return;
+	c = (struct client *) data;
+
+	switch (ev->type) {
+	case MapNotify:
+		c->answered = now_ms();
+		break;
+	case ReparentNotify:
+		/* the window manager gives the window back when it stops managing it */
+		if (ev->xreparent.parent == root)
+			c->answered = now_ms();
+		break;
+	case ConfigureNotify:
+		if (ev->xconfigure.width == c->width)
+			c->answered = now_ms();
+		break;
+	}
+}
+
+/* handle events until all clients from first to first + count have been answered */
+static int wait_clients(int first, int count)
+{
+	double deadline = now_ms() + TIMEOUT_MS;
+	struct pollfd pfd;
+	XEvent ev;
+	int i, left;
+
+	pfd.fd = ConnectionNumber(dpy);
+	pfd.events = POLLIN;
+
+	for (;;) {
+		XFlush(dpy);
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			handle_event(&ev);
+		}
+
+		left = 0;
+		for (i = first; i < first + count; i++)
+			if (clients[i].answered == 0)
+				left++;
+		if (left == 0)
+			return 0;
+
+		if (now_ms() > deadline)
+			return left;
+
+		poll(&pfd, 1, 10);
+	}
+}
+
+static void record(double ms)
+{
+	result.samples[result.count++] = ms;
+}
+
+static void record_clients(int first, int count)
+{
+	int i;
+
+	for (i = first; i < first + count; i++)
+		if (clients[i].answered > 0)
+			record(clients[i].answered - clients[i].requested);
+}
+
+static void request_resize(struct client *c)
+{
+	c->width = (c->width == 200) ? 201 : 200;
+	c->answered = 0;
+	c->requested = now_ms();
+	XResizeWindow(dpy, c->win, c->width, 100);
+}
+
+/* time until the window manager is done with everything sent so far */
+static double drain(void)
+{
+	request_resize(&clients[0]);
+	if (wait_clients(0, 1) != 0) {
+		result.timeouts++;
+		return 0;
+	}
+
+	return clients[0].answered - clients[0].requested;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static double percentile(int p)
+{
+	int i;
+
+	if (result.count == 0)
+		return 0;
+
+	i = (result.count - 1) * p / 100;
+	return result.samples[i];
+}
+
+static void begin(const char *name, int samples)
+{
+	result.name = name;
+	result.samples = malloc((samples + 1) * sizeof(double));
+	result.count = 0;
+	result.timeouts = 0;
+	result.requests = XNextRequest(dpy);
+	result.total = now_ms();
+}
+
+static void end(const char *unit)
+{
+	result.total = now_ms() - result.total;
+	result.requests = XNextRequest(dpy) - result.requests;
+
+	qsort(result.samples, result.count, sizeof(double), compare_double);
+
+	printf("%-10s %6d %-8s p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f  total %9.1f ms  %7lu requests",
+	       result.name, result.count, unit, percentile(50), percentile(90), percentile(99),
+	       result.count ? result.samples[result.count - 1] : 0.0, result.total, result.requests);
+	if (result.timeouts)
+		printf("  %d timeouts", result.timeouts);
+	printf("\n");
+	fflush(stdout);
+
+	free(result.samples);
+}
+
+static void create_clients(void)
+{
+	XSetWindowAttributes attr;
+	XClassHint class_hint;
+	char name[32];
+	int i;
+
+	attr.event_mask = StructureNotifyMask;
+	attr.background_pixel = WhitePixel(dpy, DefaultScreen(dpy));
+
+	class_hint.res_name = "wmbench";
+	class_hint.res_class = "WMBench";
+
+	clients = calloc(client_count, sizeof(*clients));
+	for (i = 0; i < client_count; i++) {
+		clients[i].width = 200;
+		clients[i].win = XCreateWindow(dpy, root, (i * 7) % 800, (i * 5) % 600, 200, 100, 0,
+					       CopyFromParent, InputOutput, CopyFromParent,
+					       CWEventMask | CWBackPixel, &attr);
+		snprintf(name, sizeof(name), "wmbench %d", i);
+		XStoreName(dpy, clients[i].win, name);
+		XSetClassHint(dpy, clients[i].win, &class_hint);
+		XSaveContext(dpy, clients[i].win, context, (XPointer) &clients[i]);
+	}
+	XSync(dpy, False);
+}
+
+static void bench_map(void)
+{
+	int i;
+
+	begin("map", client_count);
+	for (i = 0; i < client_count; i++) {
+		clients[i].answered = 0;
+		clients[i].requested = now_ms();
+		XMapWindow(dpy, clients[i].win);
+	}
+	result.timeouts = wait_clients(0, client_count);
+	record_clients(0, client_count);
+	end("windows");
+}
+
+static void bench_retitle(int batches)
+{
+	char name[64];
+	int b, i, n = 0;
+
+	begin("retitle", batches);
+	for (b = 0; b < batches; b++) {
+		for (i = 0; i < 100; i++, n++) {
+			struct client *c = &clients[n % client_count];
+
+			snprintf(name, sizeof(name), "wmbench %d: the title changed %d times", n % client_count, n);
+			XStoreName(dpy, c->win, name);
+			XChangeProperty(dpy, c->win, net_wm_name, utf8_string, 8, PropModeReplace,
+					(unsigned char *) name, strlen(name));
+		}
+		record(drain());
+	}
+	end("x100");
+}
+
+static void bench_icon(int batches)
+{
+	const int sizes[] = { 64, 32, 16 };
+	unsigned long *icon;
+	int length = 0, b, i, j, k, n = 0;
+
+	for (i = 0; i < 3; i++)
+		length += 2 + sizes[i] * sizes[i];
+	icon = malloc(length * sizeof(unsigned long));
+
+	begin("icon", batches);
+	for (b = 0; b < batches; b++) {
+		for (i = 0; i < 10; i++, n++) {
+			for (j = 0, k = 0; j < 3; j++) {
+				int p;
+
+				icon[k++] = sizes[j];
+				icon[k++] = sizes[j];
+				for (p = 0; p < sizes[j] * sizes[j]; p++)
+					icon[k++] = 0xff000000 | ((n * 37 + p) & 0xffffff);
+			}
+			XChangeProperty(dpy, clients[n % client_count].win, net_wm_icon, XA_CARDINAL, 32,
+					PropModeReplace, (unsigned char *) icon, length);
+		}
+		record(drain());
+	}
+	end("x10");
+
+	free(icon);
+}
+
+static void bench_configure(int requests)
+{
+	const int inflight = client_count < 50 ? client_count : 50;
+	int done, i;
+
+	begin("configure", requests + inflight);
+	for (done = 0; done < requests; done += inflight) {
+		for (i = 0; i < inflight; i++)
+			request_resize(&clients[i]);
+		result.timeouts += wait_clients(0, inflight);
+		record_clients(0, inflight);
+	}
+	end("requests");
+}
+
+static void bench_workspace(int switches)
+{
+	XEvent ev;
+	double requested, deadline;
+	int i;
+
+	XSelectInput(dpy, root, PropertyChangeMask);
+
+	begin("workspace", switches);
+	for (i = 0; i < switches; i++) {
+		memset(&ev, 0, sizeof(ev));
+		ev.xclient.type = ClientMessage;
+		ev.xclient.window = root;
+		ev.xclient.message_type = net_current_desktop;
+		ev.xclient.format = 32;
+		ev.xclient.data.l[0] = (i + 1) % 2;
+		ev.xclient.data.l[1] = CurrentTime;
+
+		desktop_changed = 0;
+		requested = now_ms();
+		XSendEvent(dpy, root, False, SubstructureRedirectMask | SubstructureNotifyMask, &ev);
+		XFlush(dpy);
+
+		deadline = requested + TIMEOUT_MS;
+		while (desktop_changed == 0 && now_ms() < deadline) {
+			XEvent e;
+
+			if (!XPending(dpy)) {
+				struct pollfd pfd = { ConnectionNumber(dpy), POLLIN, 0 };
+
+				poll(&pfd, 1, 10);
+				continue;
+			}
+			XNextEvent(dpy, &e);
+			handle_event(&e);
+		}
+
+		if (desktop_changed == 0)
+			result.timeouts++;
+		else
+			record(desktop_changed - requested);
+	}
+	end("switches");
+
+	XSelectInput(dpy, root, NoEventMask);
+}
+
+static void bench_unmap(void)
+{
+	int i;
+
+	begin("unmap", client_count);
+	for (i = 0; i < client_count; i++) {
+		clients[i].answered = 0;
+		clients[i].requested = now_ms();
+		XUnmapWindow(dpy, clients[i].win);
+	}
+	result.timeouts = wait_clients(0, client_count);
+	record_clients(0, client_count);
+	end("windows");
+}
+
+static void send_command(const char *command)
+{
+	XEvent ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.xclient.type = ClientMessage;
+	ev.xclient.message_type = XInternAtom(dpy, "_WINDOWMAKER_COMMAND", False);
+	ev.xclient.window = root;
+	ev.xclient.format = 8;
+	strncpy(ev.xclient.data.b, command, sizeof(ev.xclient.data.b));
+
+	XSendEvent(dpy, root, False, SubstructureRedirectMask, &ev);
+	XSync(dpy, False);
+}
+
+static void print_help(const char *progname)
+{
+	printf("Usage: %s [options]\n", progname);
+	puts("Measures how fast the window manager running on $DISPLAY handles client storms.");
+	puts("");
+	puts("  -n <count>   number of client windows (default 500)");
+	puts("  -r <count>   retitle batches of 100 (default 50)");
+	puts("  -i <count>   icon batches of 10 (default 20)");
+	puts("  -c <count>   resize requests (default 1000)");
+	puts("  -w <count>   workspace switches (default 100)");
+	puts("  -h           display this help and exit");
+}
+
+int main(int argc, char **argv)
+{
+	int retitles = 50, icons = 20, configures = 1000, switches = 100;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:i:c:w:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			client_count = atoi(optarg);
+			break;
+		case 'r':
+			retitles = atoi(optarg);
+			break;
+		case 'i':
+			icons = atoi(optarg);
+			break;
+		case 'c':
+			configures = atoi(optarg);
+			break;
+		case 'w':
+			switches = atoi(optarg);
+			break;
+		case 'h':
+			print_help(argv[0]);
+			return 0;
+		default:
+			print_help(argv[0]);
+			return 1;
+		}
+	}
+
+	if (client_count < 1) {
+		fprintf(stderr, "%s: need at least one client window\n", argv[0]);
+		return 1;
+	}
+
+	dpy = XOpenDisplay(NULL);
+	if (!dpy) {
+		fprintf(stderr, "%s: could not open display\n", argv[0]);
+		return 1;
+	}
+
+	root = DefaultRootWindow(dpy);
+	context = XUniqueContext();
+	net_wm_name = XInternAtom(dpy, "_NET_WM_NAME", False);
+	net_wm_icon = XInternAtom(dpy, "_NET_WM_ICON", False);
+	net_current_desktop = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
+	utf8_string = XInternAtom(dpy, "UTF8_STRING", False);
+
+	create_clients();
+	send_command("ResetStats");
+
+	bench_map();
+	bench_retitle(retitles);
+	bench_icon(icons);
+	bench_configure(configures);
+	bench_workspace(switches);
+	bench_unmap();
+
+	send_command("DumpStats");
+	XCloseDisplay(dpy);
+
+	return 0;
+}
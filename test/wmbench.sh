@@ -0,0 +1,88 @@
+#!/bin/sh
+# awmaker - Abstracting Window Maker
+#
+# Fork of GNU Window Maker (GPL-2).
+# Copyright (C) Rodolfo Garcia Penas (kix) <kix@kix.es>
+# and individual contributors; see LICENSE for full attribution.
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Run the wmbench client storms against a freshly built awmaker, on a private
+# Xvfb server so that neither the user's session nor their defaults get in the
+# way.
+#
+# Usage: wmbench.sh <awmaker binary> <wmbench binary> [wmbench options]
+
+set -e
+
+WM="$1"
+BENCH="$2"
+shift 2
+
+if ! command -v Xvfb > /dev/null 2>&1 ; then
+  echo "Error: Xvfb is needed to run the benchmark" >&2
+  exit 1
+fi
+
+# Find a free display
+display=99
+while [ -e "/tmp/.X11-unix/X$display" ] || [ -e "/tmp/.X$display-lock" ]; do
+  display=$((display + 1))
+done
+
+# Start from the default configuration, in a throw-away home
+home="$(mktemp -d)"
+xvfb_pid=""
+wm_pid=""
+
+cleanup() {
+  [ -n "$wm_pid" ] && kill "$wm_pid" 2> /dev/null
+  [ -n "$xvfb_pid" ] && kill "$xvfb_pid" 2> /dev/null
+  rm -rf "$home"
+}
+trap cleanup EXIT INT TERM
+
+Xvfb ":$display" -screen 0 1920x1080x24 -nolisten tcp > /dev/null 2>&1 &
+xvfb_pid=$!
+
+export DISPLAY=":$display"
+export HOME="$home"
+export XDG_CONFIG_HOME="$home/.config"
+export XDG_STATE_HOME="$home/.local/state"
+mkdir -p "$XDG_STATE_HOME/WindowMaker"
+
+# Wait for the server to accept connections
+tries=0
+until [ -e "/tmp/.X11-unix/X$display" ]; do
+  tries=$((tries + 1))
+  if [ $tries -gt 50 ]; then
+    echo "Error: Xvfb did not start on display :$display" >&2
+    exit 1
+  fi
+  sleep 0.1
+done
+
+"$WM" --no-dock --no-clip --no-autolaunch > "$home/awmaker.log" 2>&1 &
+wm_pid=$!
+
+# Give the window manager the time to take over the screen
+sleep 2
+if ! kill -0 "$wm_pid" 2> /dev/null ; then
+  echo "Error: awmaker did not start, its output was:" >&2
+  cat "$home/awmaker.log" >&2
+  exit 1
+fi
+
+"$BENCH" "$@"
+
+# The window manager's own statistics, written on the DumpStats command
+stats="$XDG_STATE_HOME/WindowMaker/Stats"
+tries=0
+while [ ! -s "$stats" ] && [ $tries -lt 20 ]; do
+  tries=$((tries + 1))
+  sleep 0.1
+done
+if [ -s "$stats" ]; then
+  echo
+  cat "$stats"
+fi
@@ -18,12 +18,19 @@
 #include <config.h>
 
 #include <X11/Xproto.h>
+#include <X11/Xutil.h>
 
 #include <WINGs/WINGs.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#ifdef USE_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
+
 /*
  * TODO:
  * - lens that shows where it's magnifying
@@ -33,17 +40,29 @@
 
 int refreshrate = 200;
 
+/*
+ * An XImage that is shared with the X server through MIT-SHM when
+ * possible, or a plain client-side XImage otherwise.
+ */
+typedef struct {
+	XImage *image;
+	Bool shared;
+#ifdef USE_XSHM
+	XShmSegmentInfo shminfo;
+#endif
+} MagImage;
+
 typedef struct {
 	Drawable d;
-	XRectangle *rects;
-	int rectP;
-	unsigned long lastpixel;
-	unsigned long *buffer;
+	char *previous;		/* captured pixels of the last frame */
 	int width, height;
 	int rwidth, rheight;	/* size of window in real pixels */
 	int magfactor;
 	int refreshrate;
 
+	MagImage capture;	/* width x height pixels grabbed from vdpy */
+	MagImage canvas;	/* rwidth x rheight magnified pixels for dpy */
+
 	WMWindow *win;
 	WMLabel *label;
 	WMPixmap *pixmap;
@@ -60,6 +79,8 @@ typedef struct {
 	Bool frozen;
 	Bool firstDraw;
 	Bool markPointerHotspot;
+	Bool markDrawn;
+	Bool putPending;
 
 	WMHandlerID tid;
 } BufferData;
@@ -68,13 +89,144 @@ static BufferData *newWindow(int magfactor);
 
 int windowCount = 0;
 
-int rectBufferSize = 32;
 Display *dpy, *vdpy;
 WMScreen *scr;
+GC gc;
 unsigned int black;
 WMColor *cursorColor1;
 WMColor *cursorColor2;
 
+#ifdef USE_XSHM
+static Bool shmAttachFailed;
+
+static int shmErrorHandler(Display * d, XErrorEvent * event)
+{
+	(void) d;
+	(void) event;
+
+	shmAttachFailed = True;
+
+	return 0;
+}
+
+static Bool createSharedImage(Display * d, Visual * visual, int depth, int width, int height, MagImage * img)
+{
+	int (*oldHandler)(Display *, XErrorEvent *);
+
+	if (!XShmQueryExtension(d))
+		return False;
+
+	img->image = XShmCreateImage(d, visual, depth, ZPixmap, NULL, &img->shminfo, width, height);
+	if (!img->image)
+		return False;
+
+	img->shminfo.shmid = shmget(IPC_PRIVATE, img->image->bytes_per_line * height, IPC_CREAT | 0600);
+	if (img->shminfo.shmid < 0) {
+		XDestroyImage(img->image);
+		img->image = NULL;
+		return False;
+	}
+
+	img->shminfo.shmaddr = shmat(img->shminfo.shmid, NULL, 0);
+	if (img->shminfo.shmaddr == (void *) -1) {
+		shmctl(img->shminfo.shmid, IPC_RMID, NULL);
+		XDestroyImage(img->image);
+		img->image = NULL;
+		return False;
+	}
+	img->image->data = img->shminfo.shmaddr;
+	img->shminfo.readOnly = False;
+
+	/* attaching fails with BadAccess when the server is not local */
+	shmAttachFailed = False;
+	oldHandler = XSetErrorHandler(shmErrorHandler);
+	XShmAttach(d, &img->shminfo);
+	XSync(d, False);
+	XSetErrorHandler(oldHandler);
+
+	/* the segment goes away once both sides have detached */
+	shmctl(img->shminfo.shmid, IPC_RMID, NULL);
+
+	if (shmAttachFailed) {
+		shmdt(img->shminfo.shmaddr);
+		img->image->data = NULL;
+		XDestroyImage(img->image);
+		img->image = NULL;
+		return False;
+	}
+
+	return True;
+}
+#endif
+
+static void createImage(Display * d, int width, int height, MagImage * img)
+{
+	int screen = DefaultScreen(d);
+	Visual *visual = DefaultVisual(d, screen);
+	int depth = DefaultDepth(d, screen);
+
+	if (width < 1)
+		width = 1;
+	if (height < 1)
+		height = 1;
+
+	img->shared = False;
+#ifdef USE_XSHM
+	if (createSharedImage(d, visual, depth, width, height, img)) {
+		img->shared = True;
+		memset(img->image->data, 0, img->image->bytes_per_line * height);
+		return;
+	}
+#endif
+
+	img->image = XCreateImage(d, visual, depth, ZPixmap, 0, NULL, width, height, BitmapPad(d), 0);
+	if (!img->image) {
+		puts("could not create image");
+		exit(1);
+	}
+	/* XDestroyImage releases the data with free() */
+	img->image->data = calloc(img->image->bytes_per_line, height);
+	if (!img->image->data) {
+		puts("could not allocate image");
+		exit(1);
+	}
+}
+
+static void destroyImage(Display * d, MagImage * img)
+{
+	if (!img->image)
+		return;
+
+#ifdef USE_XSHM
+	if (img->shared) {
+		XShmDetach(d, &img->shminfo);
+		XSync(d, False);
+		shmdt(img->shminfo.shmaddr);
+		img->image->data = NULL;
+	}
+#else
+	(void) d;
+#endif
+	XDestroyImage(img->image);
+	img->image = NULL;
+}
+
+static void createImages(BufferData * data)
+{
+	createImage(vdpy, data->width, data->height, &data->capture);
+	createImage(dpy, data->rwidth, data->rheight, &data->canvas);
+
+	data->previous = wmalloc(data->capture.image->bytes_per_line * data->capture.image->height);
+	data->putPending = False;
+}
+
+static void destroyImages(BufferData * data)
+{
+	destroyImage(vdpy, &data->capture);
+	destroyImage(dpy, &data->canvas);
+	wfree(data->previous);
+	data->previous = NULL;
+}
 
 static BufferData *makeBufferData(WMWindow * win, WMLabel * label, int width, int height, int magfactor)
 {
@@ -91,9 +243,6 @@ static BufferData *makeBufferData(WMWindow * win, WMLabel * label, int width, in
 
 	data->magfactor = magfactor;
 
-	data->rects = wmalloc(sizeof(XRectangle) * rectBufferSize);
-	data->rectP = 0;
-
 	data->win = win;
 	data->label = label;
 
@@ -106,10 +255,11 @@ static BufferData *makeBufferData(WMWindow * win, WMLabel * label, int width, in
 
 	width /= magfactor;
 	height /= magfactor;
-	data->buffer = wmalloc(sizeof(unsigned long) * width * height);
 	data->width = width;
 	data->height = height;
 
+	createImages(data);
+
 	return data;
 }
 
@@ -118,14 +268,16 @@ static void resizeBufferData(BufferData * data, int width, int height, int magfa
 	int w = width / magfactor;
 	int h = height / magfactor;
 
+	destroyImages(data);
+
 	data->rwidth = width;
 	data->rheight = height;
 	data->firstDraw = True;
 	data->magfactor = magfactor;
-	data->buffer = wrealloc(data->buffer, sizeof(unsigned long) * w * h);
 	data->width = w;
 	data->height = h;
-	memset(data->buffer, 0, w * h * sizeof(unsigned long));
+
+	createImages(data);
 
 	WMResizeWidget(data->label, width, height);
 
@@ -136,59 +288,16 @@ static void resizeBufferData(BufferData * data, int width, int height, int magfa
 	data->d = WMGetPixmapXID(data->pixmap);
 }
 
-static int drawpoint(BufferData * data, unsigned long pixel, int x, int y)
-{
-	static GC gc = NULL;
-	Bool flush = (x < 0);
-
-	if (!flush) {
-		if (data->buffer[x + data->width * y] == pixel && !data->firstDraw)
-			return 0;
-
-		data->buffer[x + data->width * y] = pixel;
-	}
-	if (gc == NULL) {
-		gc = XCreateGC(dpy, DefaultRootWindow(dpy), 0, NULL);
-	}
-
-	if (!flush && data->lastpixel == pixel && data->rectP < rectBufferSize) {
-		data->rects[data->rectP].x = x * data->magfactor;
-		data->rects[data->rectP].y = y * data->magfactor;
-		data->rects[data->rectP].width = data->magfactor;
-		data->rects[data->rectP].height = data->magfactor;
-		data->rectP++;
-
-		return 0;
-	}
-	XSetForeground(dpy, gc, data->lastpixel);
-	XFillRectangles(dpy, data->d, gc, data->rects, data->rectP);
-	data->rectP = 0;
-	data->rects[data->rectP].x = x * data->magfactor;
-	data->rects[data->rectP].y = y * data->magfactor;
-	data->rects[data->rectP].width = data->magfactor;
-	data->rects[data->rectP].height = data->magfactor;
-	data->rectP++;
-
-	data->lastpixel = pixel;
-
-	return 1;
-}
-
-static inline unsigned long getpix(XImage * image, int x, int y, int xoffs, int yoffs)
-{
-	if (x < xoffs || y < yoffs || x >= xoffs + image->width || y >= yoffs + image->height) {
-		return black;
-	}
-	return XGetPixel(image, x - xoffs, y - yoffs);
-}
-
-static void updateImage(BufferData * data, int rx, int ry)
+/*
+ * Grab the screen area centered on (rx, ry) into the capture image.
+ * Parts of the area that fall outside the viewed screen are black.
+ */
+static void captureArea(BufferData * data, int rx, int ry)
 {
+	XImage *image = data->capture.image;
+	Screen *vscreen = DefaultScreenOfDisplay(vdpy);
 	int gx, gy, gw, gh;
-	int x, y;
 	int xoffs, yoffs;
-	int changedPixels = 0;
-	XImage *image;
 
 	gw = data->width;
 	gh = data->height;
@@ -202,35 +311,143 @@ static void updateImage(BufferData * data, int rx, int ry)
 		gw += gx;
 		gx = 0;
 	}
-	if (gx + gw >= WidthOfScreen(DefaultScreenOfDisplay(vdpy))) {
-		gw = WidthOfScreen(DefaultScreenOfDisplay(vdpy)) - gx;
+	if (gx + gw >= WidthOfScreen(vscreen)) {
+		gw = WidthOfScreen(vscreen) - gx;
 	}
 	if (gy < 0) {
 		yoffs = abs(gy);
 		gh += gy;
 		gy = 0;
 	}
-	if (gy + gh >= HeightOfScreen(DefaultScreenOfDisplay(vdpy))) {
-		gh = HeightOfScreen(DefaultScreenOfDisplay(vdpy)) - gy;
+	if (gy + gh >= HeightOfScreen(vscreen)) {
+		gh = HeightOfScreen(vscreen) - gy;
 	}
 
-	image = XGetImage(vdpy, DefaultRootWindow(vdpy), gx, gy, gw, gh, AllPlanes, ZPixmap);
+#ifdef USE_XSHM
+	if (data->capture.shared && gw == image->width && gh == image->height) {
+		XShmGetImage(vdpy, DefaultRootWindow(vdpy), image, gx, gy, AllPlanes);
+		return;
+	}
+#endif
 
-	for (y = 0; y < data->height; y++) {
-		for (x = 0; x < data->width; x++) {
-			unsigned long pixel;
+	if (gw != image->width || gh != image->height) {
+		memset(image->data, 0, image->bytes_per_line * image->height);
+		if (black != 0)
+			XAddPixel(image, black);
+	}
+	if (gw > 0 && gh > 0)
+		XGetSubImage(vdpy, DefaultRootWindow(vdpy), gx, gy, gw, gh, AllPlanes, ZPixmap, image, xoffs, yoffs);
+}
+
+/*
+ * Magnify one captured row into magfactor rows of the canvas.
+ */
+static void magnifyRow(BufferData * data, int y)
+{
+	XImage *src = data->capture.image;
+	XImage *dst = data->canvas.image;
+	int m = data->magfactor;
+	int dy = y * m;
+	int x, k;
+
+	if (src->bits_per_pixel == 32 && dst->bits_per_pixel == 32 && src->byte_order == dst->byte_order) {
+		const CARD32 *s = (const CARD32 *)(src->data + y * src->bytes_per_line);
+		CARD32 *d = (CARD32 *)(dst->data + dy * dst->bytes_per_line);
+
+		if (m == 1) {
+			memcpy(d, s, data->width * sizeof(CARD32));
+		} else if (m == 2) {
+			for (x = 0; x < data->width; x++) {
+				d[2 * x] = s[x];
+				d[2 * x + 1] = s[x];
+			}
+		} else {
+			for (x = 0; x < data->width; x++) {
+				CARD32 pixel = s[x];
 
-			pixel = getpix(image, x, y, xoffs, yoffs);
+				for (k = 0; k < m; k++)
+					*d++ = pixel;
+			}
+		}
+	} else {
+		for (x = 0; x < data->width; x++) {
+			unsigned long pixel = XGetPixel(src, x, y);
 
-			if (drawpoint(data, pixel, x, y))
-				changedPixels++;
+			for (k = 0; k < m; k++)
+				XPutPixel(dst, x * m + k, dy, pixel);
 		}
 	}
-	/* flush the point cache */
-	drawpoint(data, 0, -1, -1);
 
-	XDestroyImage(image);
+	/* replicate the first magnified line on the remaining ones */
+	for (k = 1; k < m; k++)
+		memcpy(dst->data + (dy + k) * dst->bytes_per_line,
+		       dst->data + dy * dst->bytes_per_line, dst->bytes_per_line);
+}
+
+static void putRows(BufferData * data, int first, int last)
+{
+	XImage *image = data->canvas.image;
+	int y = first * data->magfactor;
+	int h = (last - first) * data->magfactor;
+
+#ifdef USE_XSHM
+	if (data->canvas.shared) {
+		XShmPutImage(dpy, data->d, gc, image, 0, y, 0, y, data->rwidth, h, False);
+		data->putPending = True;
+		return;
+	}
+#endif
+	XPutImage(dpy, data->d, gc, image, 0, y, 0, y, data->rwidth, h);
+}
+
+static void updateImage(BufferData * data, int rx, int ry)
+{
+	XImage *capture = data->capture.image;
+	int bpl = capture->bytes_per_line;
+	int markFirst, markLast;
+	int changedRows = 0;
+	int first = -1;
+	int y;
+
+	/*
+	 * The server may still be reading the canvas from the previous
+	 * frame; when vdpy is the same connection the capture round trip
+	 * already guarantees it is done.
+	 */
+	if (data->putPending && vdpy != dpy)
+		XSync(dpy, False);
+	data->putPending = False;
+
+	captureArea(data, rx, ry);
+
+	/* rows covered by the hotspot mark of the previous frame */
+	markFirst = data->height / 2 - 3;
+	markLast = data->height / 2 + 4;
+
+	for (y = 0; y < data->height; y++) {
+		char *row = capture->data + y * bpl;
+		Bool dirty = data->firstDraw;
+
+		if (!dirty)
+			dirty = (memcmp(row, data->previous + y * bpl, bpl) != 0);
+		if (!dirty && data->markDrawn)
+			dirty = (y >= markFirst && y < markLast);
+
+		if (dirty) {
+			memcpy(data->previous + y * bpl, row, bpl);
+			magnifyRow(data, y);
+			changedRows++;
+			if (first < 0)
+				first = y;
+		} else if (first >= 0) {
+			putRows(data, first, y);
+			first = -1;
+		}
+	}
+	if (first >= 0)
+		putRows(data, first, data->height);
 
+	data->markDrawn = False;
 	if (data->markPointerHotspot && !data->frozen) {
 		XRectangle rects[4];
 
@@ -257,9 +474,10 @@ static void updateImage(BufferData * data, int rx, int ry)
 		rects[3].width = data->magfactor;
 
 		XFillRectangles(dpy, data->d, WMColorGC(cursorColor2), rects + 2, 2);
+		data->markDrawn = True;
 	}
 
-	if (changedPixels > 0) {
+	if (changedRows > 0 || data->markDrawn) {
 		WMRedisplayWidget(data->label);
 	}
 
@@ -307,8 +525,7 @@ static void closeWindow(WMWidget * w, void *d)
 	} else {
 		WMDeleteTimerHandler(data->tid);
 		WMDestroyWidget(w);
-		wfree(data->buffer);
-		wfree(data->rects);
+		destroyImages(data);
 		WMReleasePixmap(data->pixmap);
 		wfree(data);
 	}
@@ -477,11 +694,7 @@ int main(int argc, char **argv)
 		vdpy = dpy;
 	}
 
-	/* calculate how many rectangles we can send in a trip to the server */
-	rectBufferSize = XMaxRequestSize(dpy) - 128;
-	rectBufferSize /= sizeof(XRectangle);
-	if (rectBufferSize < 1)
-		rectBufferSize = 1;
+	gc = XCreateGC(dpy, DefaultRootWindow(dpy), 0, NULL);
 
 	black = BlackPixel(dpy, DefaultScreen(dpy));
 
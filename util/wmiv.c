@@ -70,6 +70,19 @@ Bool back_from_fullscreen = False;
 Bool diaporama_flag = False;
 int diaporama_delay = 5;
 pthread_t tid = 0;
+
+/* number of images decoded ahead of and behind the current one */
+#define PREFETCH_DISTANCE 3
+#define PREFETCH_WORKERS 2
+/* memory the prefetched images may use before decoding further */
+#define PREFETCH_MAX_BYTES (256UL * 1024 * 1024)
+
+enum {
+	CACHE_EMPTY = 0,
+	CACHE_LOADING,
+	CACHE_READY,
+	CACHE_FAILED
+};
 #endif
 XTextProperty title_property;
 XTextProperty icon_property;
@@ -86,6 +99,12 @@ struct link {
 	const void *data;
 	link_t *prev;
 	link_t *next;
+#ifdef HAVE_PTHREAD
+	/* decoded, merged and scaled image, guarded by prefetch_lock */
+	RImage *cached;
+	int cache_state;
+	unsigned cache_generation;
+#endif
 };
 
 typedef struct linked_list {
@@ -97,6 +116,17 @@ typedef struct linked_list {
 linked_list_t list;
 link_t *current_link;
 
+#ifdef HAVE_PTHREAD
+pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t prefetch_cond = PTHREAD_COND_INITIALIZER;
+pthread_t prefetch_tids[PREFETCH_WORKERS];
+int prefetch_nworkers = 0;
+link_t *prefetch_center = NULL;
+unsigned prefetch_generation = 0;
+size_t prefetch_bytes = 0;
+Bool prefetch_quit = False;
+#endif
+
 
 /*
 	load_oriented_image: used to load an image and optionally
@@ -200,19 +230,13 @@ int change_title(XTextProperty *prop, char *filename)
 }
 
 /*
-	rescale_image: used to rescale the current image based on the screen size
-	return EXIT_SUCCESS on success
+	fit_size: shrink the given size to fit the screen, keeping the aspect ratio
 */
-int rescale_image(void)
+void fit_size(long *width, long *height)
 {
-	long final_width = img->width;
-	long final_height = img->height;
+	long final_width = *width;
+	long final_height = *height;
 
-	/* check if there is already a zoom factor applied */
-	if (fabsf(zoom_factor) <= 0.0f) {
-		final_width = img->width + (int)(img->width * zoom_factor);
-		final_height = img->height + (int)(img->height * zoom_factor);
-	}
 	if ((max_width < final_width) || (max_height < final_height)) {
 		long val = 0;
 		if (final_width > final_height) {
@@ -235,6 +259,25 @@ int rescale_image(void)
 			}
 		}
 	}
+	*width = final_width;
+	*height = final_height;
+}
+
+/*
+	rescale_image: used to rescale the current image based on the screen size
+	return EXIT_SUCCESS on success
+*/
+int rescale_image(void)
+{
+	long final_width = img->width;
+	long final_height = img->height;
+
+	/* check if there is already a zoom factor applied */
+	if (fabsf(zoom_factor) <= 0.0f) {
+		final_width = img->width + (int)(img->width * zoom_factor);
+		final_height = img->height + (int)(img->height * zoom_factor);
+	}
+	fit_size(&final_width, &final_height);
 	if ((final_width != img->width) || (final_height != img->height)) {
 		RImage *old_img = img;
 		img = RScaleImage(img, final_width, final_height);
@@ -474,6 +517,245 @@ int zoom_out(void)
 	return zoom_in_out(0);
 }
 
+/*
+	prepare_image: load an image, merge it with the background and shrink it
+	to the screen size, as change_image displays it
+	return the image on success, NULL on failure
+*/
+RImage *prepare_image(const char *file)
+{
+	RImage *image;
+	long width, height;
+
+	image = load_oriented_image(ctx, file, 0);
+	if (!image)
+		return NULL;
+
+	merge_with_background(image);
+
+	width = image->width;
+	height = image->height;
+	fit_size(&width, &height);
+	if ((width != image->width) || (height != image->height)) {
+		RImage *tmp = RScaleImage(image, width, height);
+		if (tmp) {
+			RReleaseImage(image);
+			image = tmp;
+		}
+	}
+	return image;
+}
+
+#ifdef HAVE_PTHREAD
+/*
+	image_bytes: memory used by the pixels of an image
+*/
+size_t image_bytes(RImage *i)
+{
+	return (size_t)i->width * i->height * (i->format == RRGBAFormat ? 4 : 3);
+}
+
+/*
+	prefetch_step: move one image in the given way, wrapping like change_image
+	return the new link
+*/
+link_t *prefetch_step(link_t *link, int way)
+{
+	link = (way == NEXT) ? link->next : link->prev;
+	if (!link)
+		link = (way == NEXT) ? list.first : list.last;
+	return link;
+}
+
+/*
+	prefetch_update_window: tag the links around prefetch_center with a new
+	generation and release the cached images of the other links
+	prefetch_lock must be held
+*/
+void prefetch_update_window(void)
+{
+	link_t *link;
+	int i;
+
+	prefetch_generation++;
+	prefetch_center->cache_generation = prefetch_generation;
+	for (i = 0, link = prefetch_center; i < PREFETCH_DISTANCE; i++) {
+		link = prefetch_step(link, NEXT);
+		link->cache_generation = prefetch_generation;
+	}
+	for (i = 0, link = prefetch_center; i < PREFETCH_DISTANCE; i++) {
+		link = prefetch_step(link, PREV);
+		link->cache_generation = prefetch_generation;
+	}
+
+	for (link = list.first; link; link = link->next) {
+		if (link->cache_generation == prefetch_generation)
+			continue;
+		if (link->cache_state == CACHE_READY) {
+			prefetch_bytes -= image_bytes(link->cached);
+			RReleaseImage(link->cached);
+			link->cached = NULL;
+		}
+		if (link->cache_state != CACHE_LOADING)
+			link->cache_state = CACHE_EMPTY;
+	}
+}
+
+/*
+	prefetch_pick: find the nearest link of the window not decoded yet
+	prefetch_lock must be held
+	return the link, NULL if there is nothing to do
+*/
+link_t *prefetch_pick(void)
+{
+	link_t *next, *prev;
+	int i;
+
+	if (!prefetch_center || prefetch_bytes >= PREFETCH_MAX_BYTES)
+		return NULL;
+
+	if (prefetch_center->cache_state == CACHE_EMPTY)
+		return prefetch_center;
+
+	next = prev = prefetch_center;
+	for (i = 0; i < PREFETCH_DISTANCE; i++) {
+		next = prefetch_step(next, NEXT);
+		if (next->cache_state == CACHE_EMPTY)
+			return next;
+		prev = prefetch_step(prev, PREV);
+		if (prev->cache_state == CACHE_EMPTY)
+			return prev;
+	}
+	return NULL;
+}
+
+/*
+	prefetch_store: record the result of decoding a link
+	prefetch_lock must be held
+*/
+void prefetch_store(link_t *link, RImage *image)
+{
+	if (!image) {
+		link->cache_state = CACHE_FAILED;
+	} else if (link->cache_generation != prefetch_generation) {
+		/* the user moved away while it was decoded */
+		RReleaseImage(image);
+		link->cache_state = CACHE_EMPTY;
+	} else {
+		link->cached = image;
+		link->cache_state = CACHE_READY;
+		prefetch_bytes += image_bytes(image);
+	}
+	pthread_cond_broadcast(&prefetch_cond);
+}
+
+/*
+	prefetch_worker: decode the images around the current one ahead of time
+	arg: not used
+	return void
+*/
+void *prefetch_worker(void *arg)
+{
+	pthread_mutex_lock(&prefetch_lock);
+	while (!prefetch_quit) {
+		link_t *link = prefetch_pick();
+		RImage *image;
+
+		if (!link) {
+			pthread_cond_wait(&prefetch_cond, &prefetch_lock);
+			continue;
+		}
+		link->cache_state = CACHE_LOADING;
+		pthread_mutex_unlock(&prefetch_lock);
+
+		if (WMIV_DEBUG)
+			fprintf(stderr, "prefetching> %s\n", (char *)link->data);
+		image = prepare_image(link->data);
+
+		pthread_mutex_lock(&prefetch_lock);
+		prefetch_store(link, image);
+	}
+	pthread_mutex_unlock(&prefetch_lock);
+	return arg;
+}
+
+/*
+	prefetch_get: make the given link the current one and get its image,
+	decoding it now if no worker did it yet
+	return a copy of the image on success, NULL on failure
+*/
+RImage *prefetch_get(link_t *link)
+{
+	RImage *image = NULL;
+
+	pthread_mutex_lock(&prefetch_lock);
+	prefetch_center = link;
+	prefetch_update_window();
+	pthread_cond_broadcast(&prefetch_cond);
+
+	while (link->cache_state == CACHE_LOADING)
+		pthread_cond_wait(&prefetch_cond, &prefetch_lock);
+
+	if (link->cache_state == CACHE_EMPTY) {
+		link->cache_state = CACHE_LOADING;
+		pthread_mutex_unlock(&prefetch_lock);
+		image = prepare_image(link->data);
+		pthread_mutex_lock(&prefetch_lock);
+		prefetch_store(link, image);
+		image = NULL;
+	}
+
+	if (link->cache_state == CACHE_READY)
+		image = RCloneImage(link->cached);
+	pthread_mutex_unlock(&prefetch_lock);
+
+	return image;
+}
+
+/*
+	prefetch_start: launch the decoding workers around the given link
+	arg: the current link, its already prepared image or NULL
+*/
+void prefetch_start(link_t *link, RImage *image)
+{
+	int i;
+
+	if (!link)
+		return;
+
+	pthread_mutex_lock(&prefetch_lock);
+	prefetch_center = link;
+	prefetch_update_window();
+	if (image)
+		image = RCloneImage(image);
+	if (image)
+		prefetch_store(link, image);
+	pthread_mutex_unlock(&prefetch_lock);
+
+	for (i = 0; i < PREFETCH_WORKERS; i++) {
+		if (pthread_create(&prefetch_tids[prefetch_nworkers], NULL, &prefetch_worker, NULL) == 0)
+			prefetch_nworkers++;
+	}
+}
+
+/*
+	prefetch_stop: stop the decoding workers
+*/
+void prefetch_stop(void)
+{
+	int i;
+
+	pthread_mutex_lock(&prefetch_lock);
+	prefetch_quit = True;
+	pthread_cond_broadcast(&prefetch_cond);
+	pthread_mutex_unlock(&prefetch_lock);
+
+	for (i = 0; i < prefetch_nworkers; i++)
+		pthread_join(prefetch_tids[i], NULL);
+	prefetch_nworkers = 0;
+}
+#endif
+
 /*
 	change_image: load previous or next image
 	arg: way which could be PREV or NEXT constant
@@ -505,14 +787,21 @@ int change_image(int way)
 		}
 		if (WMIV_DEBUG)
 			fprintf(stderr, "current file is> %s\n", (char *)current_link->data);
-		img = load_oriented_image(ctx, current_link->data, 0);
+#ifdef HAVE_PTHREAD
+		img = prefetch_get(current_link);
+#else
+		img = prepare_image(current_link->data);
+#endif
 
 		if (!img) {
+#ifdef HAVE_PTHREAD
+			/* RErrorCode is shared with the prefetch workers, the reason is not known */
+			fprintf(stderr, "Error: %s could not be loaded\n", (char *)current_link->data);
+#else
 			fprintf(stderr, "Error: %s %s\n", (char *)current_link->data,
 				RMessageForError(RErrorCode));
+#endif
 			img = draw_failed_image();
-		} else {
-			merge_with_background(img);
 		}
 		rescale_image();
 		if (!fullscreen_flag) {
@@ -619,6 +908,10 @@ void linked_list_free(linked_list_t *list)
 		next = link->next;
 		if (link->data)
 			free((char *)link->data);
+#ifdef HAVE_PTHREAD
+		if (link->cached)
+			RReleaseImage(link->cached);
+#endif
 		free(link);
 	}
 }
@@ -675,6 +968,9 @@ int main(int argc, char **argv)
 	char *reading_filename = "";
 	int screen, file_i;
 	int quit = 0;
+#ifdef HAVE_PTHREAD
+	Bool first_loaded;
+#endif
 	XClassHint *class_hints;
 	XSizeHints *size_hints;
 	XWMHints *win_hints;
@@ -738,6 +1034,16 @@ int main(int argc, char **argv)
 
 	linked_list_init(&list);
 
+#ifdef HAVE_PTHREAD
+	/*
+	 * Images are decoded by worker threads: the X connection is shared
+	 * with them (XPM colors, diaporama events) and the wraster image
+	 * cache is not thread safe.
+	 */
+	XInitThreads();
+	setenv("RIMAGE_CACHE", "0", 1);
+#endif
+
 	dpy = XOpenDisplay(NULL);
 	if (!dpy) {
 		fprintf(stderr, "Error: can't open display");
@@ -768,6 +1074,9 @@ int main(int argc, char **argv)
 	}
 
 	img = load_oriented_image(ctx, reading_filename, 0);
+#ifdef HAVE_PTHREAD
+	first_loaded = (img != NULL);
+#endif
 
 	if (!img) {
 		fprintf(stderr, "Error: %s %s\n", reading_filename, RMessageForError(RErrorCode));
@@ -827,6 +1136,10 @@ int main(int argc, char **argv)
 	XFlush(dpy);
 	XCopyArea(dpy, pix, win, ctx->copy_gc, 0, 0, img->width, img->height, 0, 0);
 
+#ifdef HAVE_PTHREAD
+	prefetch_start(current_link, first_loaded ? img : NULL);
+#endif
+
 	while (!quit) {
 		XNextEvent(dpy, &e);
 		if (e.type == ClientMessage) {
@@ -993,6 +1306,9 @@ int main(int argc, char **argv)
 		}
 	}
 
+#ifdef HAVE_PTHREAD
+	prefetch_stop();
+#endif
 	if (img)
 		RReleaseImage(img);
 	if (pix)
@@ -38,6 +38,7 @@ static WMArray *plMenuNodes;
 static const char *terminal;
 static fct_parse_menufile *parse;
 static fct_validate_filename *validateFilename;
+static fct_parse_entries *parseEntries;
 
 static const char *prog_name;
 
@@ -52,6 +53,7 @@ static void print_help(void)
 	puts("");
 	puts("  -h, --help\t\tdisplay this help and exit");
 	puts("  -parser=<name>\tspecify the format of the input, see below");
+	puts("  --stats\t\tprint the time spent scanning directories on stderr");
 	puts("  --version\t\toutput version information and exit");
 	puts("");
 	puts("fspec: the file to be converted or the directory containing all the menu files");
@@ -79,12 +81,15 @@ int main(int argc, char **argv)
 	struct stat st;
 	int i;
 	int *previousDepth;
+	Bool show_stats = False;
+	Bool cache_opened = False;
 
 	prog_name = argv[0];
 	plMenuNodes = WMCreateArray(8); /* grows on demand */
 	menu = (WMTreeNode *)NULL;
 	parse = NULL;
 	validateFilename = NULL;
+	parseEntries = NULL;
 
 	/* assemblePLMenuFunc passes this around */
 	previousDepth = (int *)wmalloc(sizeof(int));
@@ -116,9 +121,12 @@ int main(int argc, char **argv)
 
 			if (strcmp(name, "xdg") == 0) {
 				parse = &parse_xdg;
+				validateFilename = NULL;
+				parseEntries = &parse_xdg_entries;
 			} else if (strcmp(name, "wmconfig") == 0) {
 				parse = &parse_wmconfig;
 				validateFilename = &wmconfig_validate_file;
+				parseEntries = NULL;
 			} else {
 				fprintf(stderr, "%s: Unknown parser \"%s\"\n", prog_name, name);
 				return 2;
@@ -126,6 +134,11 @@ int main(int argc, char **argv)
 			continue;
 		}
 
+		if (strcmp(argv[i], "--stats") == 0) {
+			show_stats = True;
+			continue;
+		}
+
 		if (strcmp(argv[i], "--version") == 0) {
 			printf("%s (Window Maker %s)\n", prog_name, VERSION);
 			return 0;
@@ -154,6 +167,13 @@ int main(int argc, char **argv)
 			return 1;
 		} else if (S_ISREG(st.st_mode)) {
 			parse(argv[i], addWMMenuEntryCallback);
+		} else if (S_ISDIR(st.st_mode) && parseEntries) {
+			/* only the xdg parser returns its entries */
+			if (!cache_opened) {
+				scan_cache_open("xdg");
+				cache_opened = True;
+			}
+			scan_directory(argv[i], parseEntries, addWMMenuEntryCallback);
 		} else if (S_ISDIR(st.st_mode)) {
 			nftw(argv[i], dirParseFunc, 16, FTW_PHYS);
 		} else {
@@ -162,6 +182,11 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (cache_opened)
+		scan_cache_close();
+	if (show_stats)
+		scan_print_stats();
+
 	if (!menu) {
 		fprintf(stderr, "%s: parsers failed to create a valid menu\n", prog_name);
 		return 1;
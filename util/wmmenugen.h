@@ -50,9 +50,23 @@ void  parse_locale(const char *what, char **env_lang, char **env_ctry, char **en
 char *find_terminal_emulator(void);
 Bool fileInPath(const char *file);
 
+/* Type for the parsers that return the entries of a file instead of adding
+ * them to the menu; the array holds WMMenuEntry and is freed by the caller
+ */
+typedef WMArray *fct_parse_entries(const char *file);
+
+/* wmmenugen_scan.c
+ */
+void scan_cache_open(const char *name);
+void scan_cache_close(void);
+void scan_directory(const char *dir, fct_parse_entries *parse_entries, cb_add_menu_entry *addWMMenuEntryCallback);
+void scan_print_stats(void);
+
 /* implemented parsers
  */
 void parse_xdg(const char *file, cb_add_menu_entry *addWMMenuEntryCallback);
+WMArray *parse_xdg_entries(const char *file);
+void free_menu_entry(void *data);
 void parse_wmconfig(const char *file, cb_add_menu_entry *addWMMenuEntryCallback);
 Bool wmconfig_validate_file(const char *filename, const struct stat *st, int tflags, struct FTW *ftw);
 
@@ -57,7 +57,8 @@ typedef struct {
 	char	*Category;	/* Categories (first item only) */	/* string */
 } XDGMenuEntry;
 
-static void  getKey(char **target, const char *line);
+static int   getKey(const char **key, const char *line);
+static Bool  isKey(const char *key, int klen, const char *name);
 static void  getStringValue(char **target, const char *line);
 static void  getLocalizedStringValue(char **target, const char *line, int *match_level);
 static int   getBooleanValue(const char *line);
@@ -70,10 +71,63 @@ static void  init_wm_storage(WMMenuEntry *wm);
 
 
 void parse_xdg(const char *file, cb_add_menu_entry *addWMMenuEntryCallback)
+{
+	WMArray *entries;
+	WMArrayIterator iter;
+	WMMenuEntry *wm;
+
+	entries = parse_xdg_entries(file);
+	if (!entries)
+		return;
+
+	WM_ITERATE_ARRAY(entries, wm, iter)
+		(*addWMMenuEntryCallback)(wm);
+
+	WMFreeArray(entries);
+}
+
+/* copy a deduced menu entry, so that it does not share storage with the
+ * parser's working copies
+ */
+static void addEntry(WMArray *entries, WMMenuEntry *wm)
+{
+	WMMenuEntry *entry;
+
+	entry = wmalloc(sizeof(WMMenuEntry));
+	entry->Name = wstrdup(wm->Name);
+	entry->CmdLine = wstrdup(wm->CmdLine);
+	entry->SubMenu = wm->SubMenu ? wstrdup(wm->SubMenu) : NULL;
+	entry->Flags = wm->Flags & ~F_FREE_CMD_LINE;
+
+	WMAddToArray(entries, entry);
+}
+
+/* free an entry returned by parse_xdg_entries(); destructor of the array
+ */
+void free_menu_entry(void *data)
+{
+	WMMenuEntry *entry = data;
+
+	wfree(entry->Name);
+	wfree(entry->CmdLine);
+	if (entry->SubMenu)
+		wfree(entry->SubMenu);
+	wfree(entry);
+}
+
+/* parse a .desktop file into the list of menu entries it describes. does
+ * not touch any global state, so it may be called from several threads.
+ * returns NULL if the file cannot be read, the array must be freed with
+ * WMFreeArray() otherwise.
+ */
+WMArray *parse_xdg_entries(const char *file)
 {
 	FILE *fp;
 	char buf[1024];
-	char *p, *tmp, *key;
+	char *p, *tmp;
+	const char *key;
+	int klen;
+	WMArray *entries;
 	WMMenuEntry *wm;
 	XDGMenuEntry *xdg;
 	int InGroup;
@@ -83,9 +137,11 @@ void parse_xdg(const char *file, cb_add_menu_entry *addWMMenuEntryCallback)
 #if DEBUG
 		fprintf(stderr, "Error opening file %s: %s\n", file, strerror(errno));
 #endif
-		return;
+		return NULL;
 	}
 
+	entries = WMCreateArrayWithDestructor(1, free_menu_entry);
+
 	xdg = (XDGMenuEntry *)wmalloc(sizeof(XDGMenuEntry));
 	wm = (WMMenuEntry *)wmalloc(sizeof(WMMenuEntry));
 	InGroup = 0;
@@ -113,7 +169,7 @@ void parse_xdg(const char *file, cb_add_menu_entry *addWMMenuEntryCallback)
 			 * end of its definition, try processing it
 			 */
 			if (InGroup && xdg_to_wm(xdg, wm)) {
-				(*addWMMenuEntryCallback)(wm);
+				addEntry(entries, wm);
 			}
 			init_xdg_storage(xdg);
 			init_wm_storage(wm);
@@ -133,45 +189,42 @@ void parse_xdg(const char *file, cb_add_menu_entry *addWMMenuEntryCallback)
 			continue;
 		}
 
-		getKey(&key, p);
-		if (key == NULL) { /* not `key' = `value' */
+		klen = getKey(&key, p);
+		if (klen == 0) { /* not `key' = `value' */
 			memset(buf, 0, sizeof(buf));
 			continue;
 		}
 
-		if (strcmp(key, "Type") == 0) {
+		if (isKey(key, klen, "Type")) {
 			getStringValue(&tmp, p);
 			if (strcmp(tmp, "Application") != 0)
 				InGroup = 0;	/* if not application, skip current group */
 			wfree(tmp);
 			tmp = NULL;
-		} else if (strcmp(key, "Name") == 0) {
+		} else if (isKey(key, klen, "Name")) {
 			getLocalizedStringValue(&xdg->Name, p, &xdg->MatchLevel);
-		} else if (strcmp(key, "NoDisplay") == 0) {
+		} else if (isKey(key, klen, "NoDisplay")) {
 			if (getBooleanValue(p))	/* if nodisplay, skip current group */
 				InGroup = 0;
-		} else if (strcmp(key, "Hidden") == 0) {
+		} else if (isKey(key, klen, "Hidden")) {
 			if (getBooleanValue(p))
 				InGroup = 0;	/* if hidden, skip current group */
-		} else if (strcmp(key, "TryExec") == 0) {
+		} else if (isKey(key, klen, "TryExec")) {
 			getStringValue(&xdg->TryExec, p);
-		} else if (strcmp(key, "Exec") == 0) {
+		} else if (isKey(key, klen, "Exec")) {
 			getStringValue(&xdg->Exec, p);
-		} else if (strcmp(key, "Path") == 0) {
+		} else if (isKey(key, klen, "Path")) {
 			getStringValue(&xdg->Path, p);
-		} else if (strcmp(key, "Terminal") == 0) {
+		} else if (isKey(key, klen, "Terminal")) {
 			if (getBooleanValue(p))
 				xdg->Flags |= F_TERMINAL;
-		} else if (strcmp(key, "Categories") == 0) {
+		} else if (isKey(key, klen, "Categories")) {
 			getStringValue(&xdg->Category, p);
 			getMenuHierarchyFor(&xdg->Category);
 		}
 
 		if (xdg->Category == NULL)
 			xdg->Category = wstrdup(_("Other"));
-
-		wfree(key);
-		key = NULL;
 	}
 
 	fclose(fp);
@@ -180,8 +233,14 @@ void parse_xdg(const char *file, cb_add_menu_entry *addWMMenuEntryCallback)
 	 * unless there was no group at all or it was marked as hidden
 	 */
 	if (InGroup && xdg_to_wm(xdg, wm))
-		(*addWMMenuEntryCallback)(wm);
+		addEntry(entries, wm);
 
+	init_wm_storage(wm);
+	init_xdg_storage(xdg);
+	wfree(wm);
+	wfree(xdg);
+
+	return entries;
 }
 
 
@@ -323,18 +382,18 @@ static void init_wm_storage(WMMenuEntry *wm)
 	wm->Flags = 0;
 }
 
-/* get a key from line. allocates target, which must be wfreed later */
-static void getKey(char **target, const char *line)
+/* locate the key in line. sets key to its start and returns its length,
+ * 0 if the line is not `key' = `value'
+ */
+static int getKey(const char **key, const char *line)
 {
 	const char *p;
 	int kstart, kend;
 
 	p = line;
 
-	if (strchr(p, '=') == NULL) {		/* not `key' = `value' */
-		*target = NULL;
-		return;
-	}
+	if (strchr(p, '=') == NULL)		/* not `key' = `value' */
+		return 0;
 
 	kstart = 0;
 
@@ -347,7 +406,14 @@ static void getKey(char **target, const char *line)
 	while (*(p + kend) && !isspace(*(p + kend)) && *(p + kend) != '=' && *(p + kend) != '[')
 		kend++;
 
-	*target = wstrndup(p + kstart, kend - kstart);
+	*key = p + kstart;
+	return kend - kstart;
+}
+
+/* whether the key found by getKey() is `name' */
+static Bool isKey(const char *key, int klen, const char *name)
+{
+	return strncmp(key, name, klen) == 0 && name[klen] == '\0';
 }
 
 /* get a string value from line. allocates target, which must be wfreed later. */
@@ -425,8 +491,18 @@ static void getLocalizedStringValue(char **target, const char *line, int *match_
 	while (isspace(*(p + kstart)))
 		kstart++;
 
-	if (sqbstart > 0 && sqbend > sqbstart)
+	if (sqbstart > 0 && sqbend > sqbstart) {
+		int llen;
+
+		/* most translations are for another language, which can never
+		 * match; reject them before splitting up the locale
+		 */
+		llen = strcspn(p + sqbstart, "_.@]");
+		if (!env_lang || strncmp(env_lang, p + sqbstart, llen) != 0 || env_lang[llen] != '\0')
+			return;
+
 		locale = wstrndup(p + sqbstart, sqbend - sqbstart);
+	}
 
 	/* if there is no value yet and this is the default key, return */
 	if (!*target && !locale) {
@@ -648,7 +724,7 @@ static Bool compare_matchlevel(int *current_level, const char *found_locale)
  */
 static void  getMenuHierarchyFor(char **xdgmenuspec)
 {
-	char *category, *p;
+	char *category, *p, *last;
 	char buf[1024];
 
 	if (!*xdgmenuspec || !**xdgmenuspec)
@@ -658,7 +734,7 @@ static void  getMenuHierarchyFor(char **xdgmenuspec)
 	wfree(*xdgmenuspec);
 	memset(buf, 0, sizeof(buf));
 
-	p = strtok(category, ";");
+	p = strtok_r(category, ";", &last);
 	while (p) {		/* get a known category */
 		if (strcmp(p, "AudioVideo") == 0) {
 			snprintf(buf, sizeof(buf), "%s", _("Audio & Video"));
@@ -713,7 +789,7 @@ static void  getMenuHierarchyFor(char **xdgmenuspec)
 			snprintf(buf, sizeof(buf), "%s", _("Shell"));
 			break;
 		}
-		p = strtok(NULL, ";");
+		p = strtok_r(NULL, ";", &last);
 	}
 
 	wfree(category);
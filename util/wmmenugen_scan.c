@@ -0,0 +1,499 @@
+/*
+ * awmaker - Abstracting Window Maker
+ *
+ * Fork of GNU Window Maker (GPL-2).
+ * Copyright (C) Alfredo K. Kojima, Dan Pascu, the Window Maker Team,
+ * and individual contributors; see LICENSE for full attribution.
+ * Fork modifications: Copyright (C) Rodolfo Garcia Penas (kix) <kix@kix.es>.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Directory scanning for the parsers that can return their entries
+ * (currently only xdg).
+ *
+ * The entries found in each file are remembered in a cache keyed by the
+ * path of the file, and are reused as long as the modification time and
+ * the size of the file did not change, so regenerating a menu from a
+ * directory of thousands of desktop files only parses the ones that were
+ * installed or updated since the previous run. The files that need to be
+ * parsed are spread over a few threads when they are available.
+ *
+ * The cache is a property list stored in the user's data directory:
+ *
+ * {
+ *   Locale = "lang_COUNTRY.enc@modifier";
+ *   Files = {
+ *     "/path/to/file.desktop" = {
+ *       Stamp = "mtime:size";
+ *       Entries = ((Name, CmdLine, SubMenu, Flags), ...);
+ *     };
+ *   };
+ * }
+ *
+ * The whole cache is discarded when the locale differs, because the names
+ * and the categories it holds are translated.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wmmenugen.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#define CACHE_DIR		"/" PACKAGE_TARNAME
+#define MAX_SCAN_THREADS	8
+
+typedef struct {
+	char *path;
+	char *stamp;
+	WMArray *entries;	/* NULL until found in the cache or parsed */
+} ScanFile;
+
+static struct {
+	char *path;		/* file of the cache */
+	char *locale;
+	WMPropList *files;	/* content read from disk */
+	WMPropList *update;	/* content to write back */
+	Bool modified;
+} cache;
+
+static struct {
+	int files;
+	int cached;
+	int parsed;
+	int threads;
+	double walk_ms;
+	double parse_ms;
+	double total_ms;
+} stats;
+
+static WMArray *scanFiles;
+static fct_parse_entries *scanParse;
+
+static WMPropList *pl_locale, *pl_files, *pl_stamp, *pl_entries;
+
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static char *make_locale_name(void)
+{
+	char buf[256];
+
+	snprintf(buf, sizeof(buf), "%s_%s.%s@%s",
+	         env_lang ? env_lang : "", env_ctry ? env_ctry : "",
+	         env_enc ? env_enc : "", env_mod ? env_mod : "");
+
+	return wstrdup(buf);
+}
+
+/* open the cache of parser `name', starting empty if it does not exist,
+ * cannot be read or was built for another locale
+ */
+void scan_cache_open(const char *name)
+{
+	WMPropList *pl, *value;
+	char *dir;
+
+	pl_locale = WMCreatePLString("Locale");
+	pl_files = WMCreatePLString("Files");
+	pl_stamp = WMCreatePLString("Stamp");
+	pl_entries = WMCreatePLString("Entries");
+
+	dir = wstrconcat(wuserdatapath(), CACHE_DIR);
+	cache.path = wstrconcat(dir, "/wmmenugen-");
+	cache.path = wstrappend(cache.path, name);
+	cache.path = wstrappend(cache.path, ".cache");
+	wfree(dir);
+
+	cache.locale = make_locale_name();
+	cache.files = NULL;
+	cache.update = WMCreatePLDictionary(NULL, NULL);
+	cache.modified = False;
+
+	pl = WMReadPropListFromFile(cache.path);
+	if (!pl)
+		return;
+
+	if (WMIsPLDictionary(pl)) {
+		value = WMGetFromPLDictionary(pl, pl_locale);
+		if (value && WMIsPLString(value) && strcmp(WMGetFromPLString(value), cache.locale) == 0) {
+			value = WMGetFromPLDictionary(pl, pl_files);
+			if (value && WMIsPLDictionary(value))
+				cache.files = WMRetainPropList(value);
+		}
+	}
+	WMReleasePropList(pl);
+}
+
+static void make_stamp(const struct stat *st, char *stamp, size_t size)
+{
+	snprintf(stamp, size, "%ld:%ld", (long)st->st_mtime, (long)st->st_size);
+}
+
+/* the stamp of the file in the dictionary of the cache, NULL if it is not there
+ */
+static const char *cached_stamp(WMPropList *files, WMPropList *key)
+{
+	WMPropList *item, *value;
+
+	item = WMGetFromPLDictionary(files, key);
+	if (!item || !WMIsPLDictionary(item))
+		return NULL;
+
+	value = WMGetFromPLDictionary(item, pl_stamp);
+	if (!value || !WMIsPLString(value))
+		return NULL;
+
+	return WMGetFromPLString(value);
+}
+
+/* merge what this run scanned into the cache read from disk, keeping the
+ * files of the directories other menus scan, and write it back if
+ * something changed
+ */
+void scan_cache_close(void)
+{
+	WMPropList *pl, *value, *files, *keys, *key;
+	const char *old, *new;
+	struct stat st;
+	char stamp[64];
+	char *dir;
+	int i;
+
+	if (cache.files)
+		files = WMDeepCopyPropList(cache.files);
+	else
+		files = WMCreatePLDictionary(NULL, NULL);
+
+	/* drop the files not scanned this time that were removed or changed */
+	keys = WMGetPLDictionaryKeys(files);
+	for (i = 0; i < WMGetPropListItemCount(keys); i++) {
+		key = WMGetFromPLArray(keys, i);
+		if (!WMIsPLString(key) || WMGetFromPLDictionary(cache.update, key))
+			continue;
+
+		old = cached_stamp(files, key);
+		if (old && stat(WMGetFromPLString(key), &st) == 0) {
+			make_stamp(&st, stamp, sizeof(stamp));
+			if (strcmp(old, stamp) == 0)
+				continue;
+		}
+
+		WMRemoveFromPLDictionary(files, key);
+		cache.modified = True;
+	}
+	WMReleasePropList(keys);
+
+	keys = WMGetPLDictionaryKeys(cache.update);
+	for (i = 0; i < WMGetPropListItemCount(keys); i++) {
+		key = WMGetFromPLArray(keys, i);
+		old = cached_stamp(files, key);
+		new = cached_stamp(cache.update, key);
+		if (!old || !new || strcmp(old, new) != 0)
+			cache.modified = True;
+
+		WMPutInPLDictionary(files, key, WMGetFromPLDictionary(cache.update, key));
+	}
+	WMReleasePropList(keys);
+
+	if (cache.modified) {
+		dir = wstrconcat(wuserdatapath(), CACHE_DIR);
+		if (wmkdirhier(dir)) {
+			value = WMCreatePLString(cache.locale);
+			pl = WMCreatePLDictionary(pl_locale, value, pl_files, files, NULL);
+			if (!WMWritePropListToFile(pl, cache.path))
+				wwarning(_("could not write the menu cache %s"), cache.path);
+			WMReleasePropList(value);
+			WMReleasePropList(pl);
+		}
+		wfree(dir);
+	}
+	WMReleasePropList(files);
+	WMReleasePropList(cache.update);
+
+	if (cache.files)
+		WMReleasePropList(cache.files);
+	wfree(cache.path);
+	wfree(cache.locale);
+}
+
+static WMArray *entries_from_cache(WMPropList *list)
+{
+	WMArray *entries;
+	WMMenuEntry *entry;
+	WMPropList *item;
+	int i;
+
+	entries = WMCreateArrayWithDestructor(1, free_menu_entry);
+
+	for (i = 0; i < WMGetPropListItemCount(list); i++) {
+		item = WMGetFromPLArray(list, i);
+		if (!WMIsPLArray(item) || WMGetPropListItemCount(item) != 4 ||
+		    !WMIsPLString(WMGetFromPLArray(item, 0)) || !WMIsPLString(WMGetFromPLArray(item, 1)) ||
+		    !WMIsPLString(WMGetFromPLArray(item, 2)) || !WMIsPLString(WMGetFromPLArray(item, 3))) {
+			/* a damaged cache, the directory is parsed again */
+			WMFreeArray(entries);
+			return NULL;
+		}
+
+		entry = wmalloc(sizeof(WMMenuEntry));
+		entry->Name = wstrdup(WMGetFromPLString(WMGetFromPLArray(item, 0)));
+		entry->CmdLine = wstrdup(WMGetFromPLString(WMGetFromPLArray(item, 1)));
+		entry->SubMenu = WMGetFromPLString(WMGetFromPLArray(item, 2));
+		entry->SubMenu = *entry->SubMenu ? wstrdup(entry->SubMenu) : NULL;
+		entry->Flags = atoi(WMGetFromPLString(WMGetFromPLArray(item, 3)));
+		WMAddToArray(entries, entry);
+	}
+
+	return entries;
+}
+
+static WMPropList *entries_to_cache(WMArray *entries)
+{
+	WMPropList *list, *item;
+	WMMenuEntry *entry;
+	WMArrayIterator iter;
+	char flags[16];
+
+	list = WMCreatePLArray(NULL);
+
+	WM_ITERATE_ARRAY(entries, entry, iter) {
+		snprintf(flags, sizeof(flags), "%d", entry->Flags);
+		item = WMCreatePLArray(WMCreatePLString(entry->Name),
+		                       WMCreatePLString(entry->CmdLine),
+		                       WMCreatePLString(entry->SubMenu ? entry->SubMenu : ""),
+		                       WMCreatePLString(flags),
+		                       NULL);
+		WMAddToPLArray(list, item);
+		WMReleasePropList(item);
+	}
+
+	return list;
+}
+
+/* look the file up in the cache, filling its entries on a hit
+ */
+static void lookup_cache(ScanFile *file)
+{
+	WMPropList *key, *item, *value;
+
+	if (!cache.files)
+		return;
+
+	key = WMCreatePLString(file->path);
+	item = WMGetFromPLDictionary(cache.files, key);
+	WMReleasePropList(key);
+
+	if (!item || !WMIsPLDictionary(item))
+		return;
+
+	value = WMGetFromPLDictionary(item, pl_stamp);
+	if (!value || !WMIsPLString(value) || strcmp(WMGetFromPLString(value), file->stamp) != 0)
+		return;
+
+	value = WMGetFromPLDictionary(item, pl_entries);
+	if (value && WMIsPLArray(value))
+		file->entries = entries_from_cache(value);
+}
+
+static int collect_file(const char *filename, const struct stat *st, int tflags, struct FTW *ftw)
+{
+	ScanFile *file;
+	char stamp[64];
+
+	(void)ftw;
+
+	if (tflags != FTW_F)
+		return 0;
+
+	make_stamp(st, stamp, sizeof(stamp));
+
+	file = wmalloc(sizeof(ScanFile));
+	file->path = wstrdup(filename);
+	file->stamp = wstrdup(stamp);
+	file->entries = NULL;
+	WMAddToArray(scanFiles, file);
+
+	return 0;
+}
+
+static void free_scan_file(void *data)
+{
+	ScanFile *file = data;
+
+	wfree(file->path);
+	wfree(file->stamp);
+	if (file->entries)
+		WMFreeArray(file->entries);
+	wfree(file);
+}
+
+/* parse a file; files that cannot be read are remembered with no entries
+ */
+static WMArray *parse_file(const char *path)
+{
+	WMArray *entries;
+
+	entries = scanParse(path);
+	if (!entries)
+		entries = WMCreateArrayWithDestructor(1, free_menu_entry);
+
+	return entries;
+}
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t scanLock = PTHREAD_MUTEX_INITIALIZER;
+static int scanNext;
+
+static void *parse_worker(void *arg)
+{
+	ScanFile *file;
+	int i;
+
+	(void)arg;
+
+	for (;;) {
+		/* take the next file that is not in the cache */
+		pthread_mutex_lock(&scanLock);
+		do {
+			i = scanNext++;
+			file = (i < WMGetArrayItemCount(scanFiles)) ? WMGetFromArray(scanFiles, i) : NULL;
+		} while (file && file->entries);
+		pthread_mutex_unlock(&scanLock);
+
+		if (!file)
+			break;
+
+		file->entries = parse_file(file->path);
+	}
+
+	return NULL;
+}
+
+static void parse_pending(int pending)
+{
+	pthread_t tids[MAX_SCAN_THREADS];
+	long ncpu;
+	int i, count;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	count = (ncpu < 1) ? 1 : (ncpu > MAX_SCAN_THREADS) ? MAX_SCAN_THREADS : ncpu;
+	if (count > pending)
+		count = pending;
+
+	scanNext = 0;
+	stats.threads = 0;
+	for (i = 0; i < count; i++) {
+		if (pthread_create(&tids[stats.threads], NULL, parse_worker, NULL) == 0)
+			stats.threads++;
+	}
+
+	/* the calling thread finishes the job if no thread could be created */
+	if (stats.threads == 0)
+		parse_worker(NULL);
+
+	for (i = 0; i < stats.threads; i++)
+		pthread_join(tids[i], NULL);
+}
+#else
+static void parse_pending(int pending)
+{
+	ScanFile *file;
+	WMArrayIterator iter;
+
+	(void)pending;
+
+	stats.threads = 1;
+	WM_ITERATE_ARRAY(scanFiles, file, iter) {
+		if (!file->entries)
+			file->entries = parse_file(file->path);
+	}
+}
+#endif
+
+/* add the entries of all the files in the hierarchy of `dir' to the menu,
+ * parsing only the files that changed since they were cached
+ */
+void scan_directory(const char *dir, fct_parse_entries *parse_entries, cb_add_menu_entry *addWMMenuEntryCallback)
+{
+	WMArrayIterator iter;
+	ScanFile *file;
+	WMMenuEntry *entry;
+	WMArrayIterator eiter;
+	WMPropList *key, *list, *item;
+	double start, walked;
+	int pending;
+
+	start = now_ms();
+
+	scanFiles = WMCreateArrayWithDestructor(64, free_scan_file);
+	scanParse = parse_entries;
+	nftw(dir, collect_file, 16, FTW_PHYS);
+
+	pending = 0;
+	WM_ITERATE_ARRAY(scanFiles, file, iter) {
+		lookup_cache(file);
+		if (file->entries)
+			stats.cached++;
+		else
+			pending++;
+	}
+
+	walked = now_ms();
+	stats.walk_ms += walked - start;
+
+	if (pending > 0)
+		parse_pending(pending);
+
+	stats.parse_ms += now_ms() - walked;
+	stats.files += WMGetArrayItemCount(scanFiles);
+	stats.parsed += pending;
+
+	WM_ITERATE_ARRAY(scanFiles, file, iter) {
+		WM_ITERATE_ARRAY(file->entries, entry, eiter)
+			(*addWMMenuEntryCallback)(entry);
+
+		key = WMCreatePLString(file->stamp);
+		list = entries_to_cache(file->entries);
+		item = WMCreatePLDictionary(pl_stamp, key, pl_entries, list, NULL);
+		WMReleasePropList(key);
+		WMReleasePropList(list);
+
+		key = WMCreatePLString(file->path);
+		WMPutInPLDictionary(cache.update, key, item);
+		WMReleasePropList(key);
+		WMReleasePropList(item);
+	}
+	if (pending > 0)
+		cache.modified = True;
+
+	WMFreeArray(scanFiles);
+	scanFiles = NULL;
+
+	stats.total_ms += now_ms() - start;
+}
+
+void scan_print_stats(void)
+{
+	fprintf(stderr, "%d files, %d from cache, %d parsed with %d thread(s)\n",
+	        stats.files, stats.cached, stats.parsed, stats.threads);
+	fprintf(stderr, "walk %.2f ms, parse %.2f ms, total %.2f ms\n",
+	        stats.walk_ms, stats.parse_ms, stats.total_ms);
+}